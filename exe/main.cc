@@ -4,6 +4,7 @@
 #ifndef _WIN32
 #include <pxp-agent/util/posix/pid_file.hpp>
 #include <pxp-agent/util/posix/daemonize.hpp>
+#include <pxp-agent/util/posix/process.hpp>
 #endif
 
 #include <leatherman/file_util/file.hpp>
@@ -60,6 +61,18 @@ int startAgent(std::vector<std::string> arguments) {
         return 0;
     }
 
+#ifndef _WIN32
+    // NB: the fork server must be started before the agent threads
+    try {
+        Util::startForkServer();
+    } catch (const Util::process_error& e) {
+        LOG_WARNING("Failed to start the fork server; action processes will "
+                    "be spawned by the agent: %1%", e.what());
+    }
+#endif
+
+    Configuration::Instance().startLogWriter();
+
     bool success { false };
     const auto& agent_configuration =
         Configuration::Instance().getAgentConfiguration();
@@ -0,0 +1,51 @@
+// Move the results of the completed non-blocking jobs stored in a
+// spool directory (one directory per transaction) to the job journal,
+// as used by pxp-agent when spool-format is 'journal'; pxp-agent does
+// that as well when it starts, so the tool is meant for migrating
+// large spool directories ahead of time.
+// It fails if pxp-agent is using the journal.
+
+#include <pxp-agent/job_journal.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.migrate_spool"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/nowide/args.hpp>
+#include <boost/nowide/iostream.hpp>
+
+#include <string>
+
+namespace lth_log = leatherman::logging;
+
+int main(int argc, char** argv) {
+    boost::nowide::args arg_utf8(argc, argv);
+
+    if (argc != 2) {
+        boost::nowide::cerr << "Usage: " << argv[0] << " <spool-dir>" << std::endl;
+        return 2;
+    }
+
+    std::string spool_dir { argv[1] };
+
+    if (!boost::filesystem::is_directory(spool_dir)) {
+        boost::nowide::cerr << "Not a spool directory: " << spool_dir << std::endl;
+        return 1;
+    }
+
+    lth_log::setup_logging(boost::nowide::cerr);
+    lth_log::set_level(lth_log::log_level::info);
+
+    try {
+        PXPAgent::JobJournal journal { spool_dir, true };
+        auto num_migrated = journal.migrate();
+        boost::nowide::cout << "Moved the results of " << num_migrated
+                            << " jobs to the journal" << std::endl;
+    } catch (const PXPAgent::JobJournal::Error& e) {
+        boost::nowide::cerr << "Failed to migrate the spool directory: "
+                            << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -3,6 +3,7 @@
 
 #include <leatherman/json_container/json_container.hpp>
 
+#include <cstdlib>  // EXIT_FAILURE
 #include <string>
 
 namespace PXPAgent {
@@ -18,7 +19,9 @@ struct ActionOutcome {
     std::string std_out;
     lth_jc::JsonContainer results;
 
-    ActionOutcome() {
+    ActionOutcome()
+            : type { Type::Internal },
+              exitcode { EXIT_FAILURE } {
     }
 
     ActionOutcome(int exitcode_,
@@ -8,15 +8,17 @@
 #include <stdexcept>
 #include <string>
 #include <map>
+#include <vector>
 
 namespace PXPAgent {
 
 namespace lth_jc = leatherman::json_container;
 
-enum class RequestType { Blocking, NonBlocking };
+enum class RequestType { Blocking, NonBlocking, Batch };
 static std::map<RequestType, std::string> requestTypeNames {
     { RequestType::Blocking, "blocking" },
-    { RequestType::NonBlocking, "non blocking" } };
+    { RequestType::NonBlocking, "non blocking" },
+    { RequestType::Batch, "batch" } };
 
 class ActionRequest {
   public:
@@ -25,8 +27,14 @@ class ActionRequest {
     };
 
     /// Throws an ActionRequest::Error in case it fails to retrieve
-    /// the data chunk from the specified ParsedChunks or in case of
-    /// binary data (currently not supported).
+    /// the data chunk from the specified ParsedChunks.
+    /// In case of binary data, the request entries are retrieved from
+    /// its header line, which is validated as the data of the JSON
+    /// request of the same type, and the rest of the data is made
+    /// available by binaryData(); an ActionRequest::Error is thrown
+    /// in case of missing or invalid header and for batch requests.
+    /// NB: batch requests have no module and action entries; their
+    /// actions are retrieved by batchEntries().
     ActionRequest(RequestType type_,
                   const PCPClient::ParsedChunks& parsed_chunks_);
     ActionRequest(RequestType type_,
@@ -41,12 +49,27 @@ class ActionRequest {
     const bool& notifyOutcome() const;
     const PCPClient::ParsedChunks& parsedChunks() const;
 
+    // The binary payload of the request, without the header line;
+    // it's empty for JSON requests
+    const std::string& binaryData() const;
+
     // The following accessors perform lazy initialization
     // The params entry is not required; in case it's not included
     // in the request, an empty JsonContainer object is returned
     const lth_jc::JsonContainer& params() const;
     const std::string& paramsTxt() const;
 
+    // For batch requests, return a blocking request for each entry of
+    // the actions array; the entries share the envelope, the debug
+    // chunks, and the transaction ID of the batch request
+    std::vector<ActionRequest> batchEntries() const;
+
+    // The results directory is set only for non-blocking requests,
+    // once the relevant job has been initialized; it's empty
+    // otherwise
+    const std::string& resultsDir() const;
+    void setResultsDir(const std::string& results_dir);
+
   private:
     RequestType type_;
     std::string id_;
@@ -56,6 +79,7 @@ class ActionRequest {
     std::string action_;
     bool notify_outcome_;
     PCPClient::ParsedChunks parsed_chunks_;
+    std::string results_dir_;
 
     // Lazy initialized
     mutable lth_jc::JsonContainer params_;
@@ -63,6 +87,7 @@ class ActionRequest {
 
     void init();
     void validateFormat();
+    void parseBinaryData();
 };
 
 }  // namespace PXPAgent
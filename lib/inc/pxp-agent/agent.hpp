@@ -60,6 +60,12 @@ class Agent {
     // will send a PXP non-blocking response containing the action
     // outcome when finished.
     void nonBlockingRequestCallback(const PCPClient::ParsedChunks& parsed_chunks);
+
+    // Callback for PCPClient::Connector handling incoming PXP batch
+    // requests; it will execute the requested actions, optionally in
+    // parallel, and reply with a single PXP batch response containing
+    // the outcome of each action.
+    void batchRequestCallback(const PCPClient::ParsedChunks& parsed_chunks);
 };
 
 }  // namespace PXPAgent
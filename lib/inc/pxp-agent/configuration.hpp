@@ -1,6 +1,8 @@
 #ifndef SRC_CONFIGURATION_H_
 #define SRC_CONFIGURATION_H_
 
+#include <pxp-agent/util/logging.hpp>
+
 #include <horsewhisperer/horsewhisperer.h>
 
 #include <boost/nowide/fstream.hpp>
@@ -92,6 +94,30 @@ class Configuration {
         std::string spool_dir;
         std::string modules_config_dir;
         std::string client_type;
+        // Results larger than this are sent as chunked responses;
+        // zero disables chunking [bytes]
+        size_t response_chunk_size;
+        // Spool output files larger than this are compressed; zero
+        // disables compression [bytes]
+        size_t spool_compression_threshold;
+        // Maximum rate of requests per sender and overall; zero
+        // disables the limit [requests/min]
+        int rate_limit;
+        int global_rate_limit;
+        // Number of requests that can be accepted at once, beyond
+        // the rate limits
+        int rate_limit_burst;
+        // Requests with larger data (binary data plus params) are
+        // rejected; zero disables the limit [bytes]
+        size_t max_request_size;
+        // Whether the spool files are synced to disk when written
+        bool spool_sync;
+        // How the results of completed non-blocking jobs are stored
+        // in the spool directory: "directory" or "journal"
+        std::string spool_format;
+        // Directory the file_transfer module writes files to; empty
+        // disables file transfers
+        std::string file_transfer_dir;
     };
 
     /// Set the configuration entries to their default values.
@@ -184,6 +210,13 @@ class Configuration {
     /// All possible exceptions will be filtered.
     void reopenLogfile() const;
 
+    /// Start writing the log messages to the logfile from a
+    /// dedicated thread, so that logging doesn't wait for the file
+    /// I/O; must be called after forking the daemon and the fork
+    /// server, as threads are not inherited by child processes.
+    /// Does nothing when logging to the console.
+    void startLogWriter();
+
   private:
     // Whether Configuration singleton was successfully instantiated
     bool initialized_;
@@ -206,6 +239,12 @@ class Configuration {
     // Stream abstraction object for the logfile
     mutable boost::nowide::ofstream logfile_fstream_;
 
+    // Queues the log messages for the logfile, written by its
+    // thread once started
+    std::unique_ptr<Util::AsyncLogStream> log_stream_;
+
+    void reopenLogfileStream() const;
+
     Configuration();
     void defineDefaultValues();
     void setDefaultValues();
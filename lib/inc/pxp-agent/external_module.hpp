@@ -4,7 +4,15 @@
 #include <pxp-agent/module.hpp>
 #include <pxp-agent/thread_container.hpp>
 
+#ifndef _WIN32
+#include <pxp-agent/util/posix/process.hpp>
+#endif
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <chrono>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -39,25 +47,144 @@ class ExternalModule : public Module {
     /// not registered or in case of an invalid configuration data.
     void validateConfiguration();
 
-  private:
+  protected:
+    /// Register the specified metadata, already retrieved from the
+    /// module, after validating it; used by modules that are not
+    /// executables (e.g. plugins).
+    /// Throw a Module::LoadingError as the other constructors.
+    ExternalModule(const std::string& path,
+                   const lth_jc::JsonContainer& config,
+                   const lth_jc::JsonContainer& metadata);
+
     /// The path of the module file
     const std::string path_;
 
     /// Module configuration data
     lth_jc::JsonContainer config_;
 
+    /// Stores the binary data of a request in a file, only readable
+    /// by the agent user, that is removed once the action is done
+    class BinaryDataFile {
+      public:
+        /// Throw a Module::ProcessingError if the file can't be written
+        explicit BinaryDataFile(const ActionRequest& request);
+        ~BinaryDataFile();
+
+        const std::string& path() const { return path_; }
+
+      private:
+        std::string path_;
+    };
+
+    /// Return the action input, in JSON format, containing the
+    /// request parameters and the module configuration; in case the
+    /// request carries binary data, it's stored in binary_data_file
+    /// and its path is included in the input. For non-blocking
+    /// requests, the input includes the path of the progress file.
+    std::string getActionInput(const ActionRequest& request,
+                               std::unique_ptr<BinaryDataFile>& binary_data_file);
+
+    /// In case of a non-blocking request, write the action output and
+    /// error to the results directory, as done by the action processes
+    void storeOutput(const ActionRequest& request,
+                     const std::string& output,
+                     const std::string& error);
+
+    /// Truncate the error text to the maximum stderr size, appending
+    /// a truncation marker; return true if it was truncated.
+    bool truncateError(std::string& error);
+
+    /// Log the action output and ensure it's valid JSON; the error
+    /// text is truncated in case it's oversized.
+    /// Throw a Module::ResourceLimitError in case the action process
+    /// exceeded the specified limit (if not empty) and a
+    /// Module::ProcessingError in case of oversized output or invalid
+    /// JSON.
+    ActionOutcome processOutput(const std::string& action_name,
+                                int exitcode,
+                                std::string& output,
+                                std::string& error,
+                                const std::string& limit_exceeded = "");
+
+  private:
+
     /// Metadata validator
     static const PCPClient::Validator metadata_validator_;
 
+#ifndef _WIN32
+    /// Resource limits of the action processes
+    Util::ProcessLimits limits_;
+
+    /// Environment of the action processes, built once from the
+    /// 'environment' and 'inherit_environment' configuration entries;
+    /// null if the processes get the agent environment
+    std::unique_ptr<Util::Environment> environment_;
+
+    /// Whether the actions are forked by a preloader process, as set
+    /// by the 'preload' configuration entry, and the preloader, if
+    /// running; a preloader that fails to start is retried after the
+    /// specified time
+    bool preload_ { false };
+    std::shared_ptr<Util::Preloader> preloader_;
+    std::chrono::steady_clock::time_point preloader_retry_time_;
+    PCPClient::Util::mutex preloader_mutex_;
+#endif
+
+    /// Maximum sizes of the stdout and stderr of the action
+    /// processes, in bytes; zero means no limit
+    size_t max_stdout_size_;
+    size_t max_stderr_size_;
+
+    /// Parse the 'limits' entry of the module configuration.
+    /// Throw a Module::LoadingError in case of invalid limits.
+    void registerLimits();
+
+    /// Build the environment of the action processes.
+    /// Throw a Module::LoadingError in case of invalid entries.
+    void registerEnvironment();
+
+    /// Parse the 'preload' entry; the preloader is started on first
+    /// use, by getPreloader().
+    /// Throw a Module::LoadingError in case of an invalid entry.
+    void registerPreloader();
+
+    /// Return the running preloader, restarting it if needed; return
+    /// null if preloading is disabled or the preloader can't start.
+    std::shared_ptr<Util::Preloader> getPreloader();
+
+    /// Stop using the specified preloader, after it failed
+    void discardPreloader(const std::shared_ptr<Util::Preloader>& preloader,
+                          const std::string& reason);
+
     const lth_jc::JsonContainer getMetadata();
 
+    /// Throw a Module::LoadingError in case of invalid metadata
+    void validateMetadata(const lth_jc::JsonContainer& metadata);
+
+    /// Register the configuration schema, the actions, and the limits
+    void registerMetadata(const lth_jc::JsonContainer& metadata);
+
     void registerConfiguration(const lth_jc::JsonContainer& config);
 
     void registerActions(const lth_jc::JsonContainer& metadata);
 
     void registerAction(const lth_jc::JsonContainer& action);
 
-    ActionOutcome callAction(const ActionRequest& reqeust);
+    /// Determine the executable and its arguments for the specified
+    /// action, depending on the configured interpreter and platform
+    void getCommand(const std::string& action_name,
+                    std::string& file,
+                    std::vector<std::string>& arguments);
+
+    ActionOutcome callAction(const ActionRequest& request);
+
+#ifndef _WIN32
+    ActionOutcome callNonBlockingAction(const ActionRequest& request,
+                                        const std::string& file,
+                                        const std::vector<std::string>& arguments,
+                                        const std::string& input_txt,
+                                        const std::shared_ptr<Util::Preloader>& preloader);
+#endif
 };
 
 }  // namespace PXPAgent
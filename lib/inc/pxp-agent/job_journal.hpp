@@ -0,0 +1,182 @@
+#ifndef SRC_AGENT_JOB_JOURNAL_HPP_
+#define SRC_AGENT_JOB_JOURNAL_HPP_
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace PXPAgent {
+
+/// Stores the records of completed non-blocking jobs (status, stdout,
+/// and stderr) in segmented append-only files, indexed by transaction
+/// id, instead of keeping a results directory per job; it's used when
+/// spool-format is 'journal'.
+///
+/// The journal is located in spool-dir/journal. Records are appended
+/// to the current segment file, named <number>.log, until it exceeds
+/// the maximum segment size. A record is a header line
+///     <status_size> <stdout_size> <stderr_size> <crc32> <transaction_id>
+/// followed by the status, stdout, and stderr data. For each record,
+/// the index file stores a line
+///     <segment> <offset> <size> <transaction_id>
+/// A newer record of a transaction supersedes the older ones.
+class JobJournal {
+  public:
+    struct Error : public std::runtime_error {
+        explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+    };
+
+    struct Record {
+        std::string status;
+        std::string out;
+        std::string err;
+    };
+
+    /// Name of the journal directory, in the spool directory
+    static const std::string DIRECTORY_NAME;
+
+    /// Size above which a new segment is started [bytes]
+    static const size_t DEFAULT_SEGMENT_SIZE;
+
+    /// Open the journal of the specified spool directory, creating it
+    /// if necessary, and load the index. Records that were appended
+    /// but not indexed before a crash are indexed and an incomplete
+    /// record at the end of the last segment is discarded.
+    /// In case sync is flagged, records are synced to disk when
+    /// appended (POSIX only).
+    /// Throw a JobJournal::Error in case the journal can't be opened
+    /// or it's used by another process.
+    JobJournal(const std::string& spool_dir,
+               bool sync = false,
+               size_t segment_size = DEFAULT_SEGMENT_SIZE);
+
+    ~JobJournal();
+
+    /// Append the record of the job and index it; in case sync is
+    /// flagged, return once the record is synced to disk; the syncs
+    /// of concurrent jobs are group committed. Concurrent appends
+    /// copy their data at the same time, and reads don't wait for
+    /// them.
+    /// Throw a JobJournal::Error in case of failure.
+    void append(const std::string& transaction_id, const Record& record);
+
+    /// Like append(), but read stdout and stderr from the specified
+    /// files, which are copied to the journal in blocks instead of
+    /// being loaded in memory; a missing file means an empty output.
+    void appendFiles(const std::string& transaction_id,
+                     const std::string& status,
+                     const std::string& out_path,
+                     const std::string& err_path);
+
+    /// Return true and set the record argument in case the journal
+    /// stores the record of the job; return false otherwise.
+    /// Throw a JobJournal::Error in case the record can't be read or
+    /// is corrupted.
+    bool read(const std::string& transaction_id, Record& record);
+
+    /// Like read(), but set record.out to at most length bytes of the
+    /// stdout, starting at offset (up to its end in case length is
+    /// negative), and out_size to the size of the whole stdout. Only
+    /// the requested range of stdout is read; as the checksum covers
+    /// the whole record, it's not verified.
+    bool readRange(const std::string& transaction_id,
+                   uint64_t offset,
+                   int64_t length,
+                   Record& record,
+                   uint64_t& out_size);
+
+    /// Move the results of the completed jobs stored in the spool
+    /// directory (one directory per transaction) to the journal; the
+    /// directories of running jobs are left in place. Return the
+    /// number of moved jobs; failures are logged.
+    size_t migrate();
+
+  private:
+    struct Location {
+        uint32_t segment;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    /// Data of a record field to be appended: in memory or, in case
+    /// data is null, the first size bytes of the file at path
+    struct Field {
+        const std::string* data;
+        std::string path;
+        uint64_t size;
+    };
+
+    const std::string spool_dir_;
+    const std::string journal_dir_;
+    const std::string index_path_;
+    const bool sync_;
+    const size_t segment_size_;
+
+    std::unordered_map<std::string, Location> index_;
+
+    /// Current segment and end of the space reserved in it; the data
+    /// of a record is copied after its space is reserved, without
+    /// holding the mutex, and it's indexed once copied
+    uint32_t segment_number_;
+    uint64_t segment_end_;
+    std::ofstream index_stream_;
+
+    /// Lock file descriptor, preventing concurrent writers (POSIX)
+    int lock_fd_;
+
+    /// Sequence numbers of the appended and synced records, used to
+    /// group commit the syncs
+    uint64_t appended_sequence_;
+    uint64_t synced_sequence_;
+    bool syncing_;
+
+    /// Segments of the appended records that are not synced yet
+    std::set<uint32_t> unsynced_segments_;
+
+    PCPClient::Util::mutex mutex_;
+    PCPClient::Util::condition_variable cond_var_;
+
+    /// Return false in case the transaction is not indexed
+    bool findRecord(const std::string& transaction_id, Location& location);
+
+    /// Append the record made of the status, stdout, and stderr fields
+    void appendFields(const std::string& transaction_id,
+                      const std::vector<Field>& fields);
+
+    std::string segmentPath(uint32_t segment) const;
+
+    /// Throw a JobJournal::Error in case the journal is locked by
+    /// another process (POSIX only)
+    void lock();
+    void unlock();
+
+    /// Load the index and index the records that follow the last
+    /// indexed one
+    void load();
+
+    /// Index the records of the segment that start at offset or
+    /// later; return false in case an invalid record was found,
+    /// setting offset to its position
+    bool scanSegment(uint32_t segment, uint64_t& offset);
+
+    /// Rewrite the index file, atomically, from the loaded index
+    void rewriteIndex();
+
+    /// Create the segment, if necessary, and make it the current one
+    void openSegment(uint32_t segment);
+
+    /// Wait until the record with the specified sequence number is
+    /// synced, syncing it if no other thread is doing it
+    void syncRecord(PCPClient::Util::unique_lock<PCPClient::Util::mutex>& the_lock,
+                    uint64_t sequence);
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_JOB_JOURNAL_HPP_
@@ -0,0 +1,53 @@
+#ifndef SRC_LUA_MODULE_H_
+#define SRC_LUA_MODULE_H_
+
+#include <pxp-agent/external_module.hpp>
+
+#include <string>
+
+namespace PXPAgent {
+
+/// Module implemented by a Lua script, executed in-process by a
+/// sandboxed interpreter.
+///
+/// The script must define the global 'metadata' table, with the same
+/// content as the metadata of external modules, and the global
+/// 'actions' table, that maps each action name to a function; the
+/// function is called with the request params and the module
+/// configuration (as Lua tables) and must return the action results.
+///
+/// Each execution runs in a new Lua state that provides only the
+/// base, string, table, and math libraries, without any function to
+/// load code or to access the system, plus 'pxp.read_file(path)';
+/// the memory and the CPU time of the execution are capped by the
+/// 'memory_mb' and 'cpu_seconds' entries of the module 'limits'.
+class LuaModule : public ExternalModule {
+  public:
+    /// Suffix of the script files
+    static const std::string SCRIPT_SUFFIX;
+
+    /// Run the script to retrieve and register its metadata.
+    /// Throw a Module::LoadingError in case the script can't be read
+    /// or executed, or in case of invalid metadata.
+    explicit LuaModule(const std::string& path,
+                       const lth_jc::JsonContainer& config =
+                           lth_jc::JsonContainer { "{}" });
+
+  private:
+    /// Script source
+    std::string script_;
+
+    /// Maximum memory and CPU time of an action execution
+    size_t memory_limit_;
+    double cpu_limit_s_;
+
+    LuaModule(const std::string& path,
+              const lth_jc::JsonContainer& config,
+              const std::string& script);
+
+    ActionOutcome callAction(const ActionRequest& request);
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_LUA_MODULE_H_
@@ -30,6 +30,18 @@ class Module {
         explicit ProcessingError(std::string const& msg) : Error(msg) {}
     };
 
+    /// The action process was terminated for exceeding one of the
+    /// resource limits configured for the module
+    struct ResourceLimitError : public ProcessingError {
+        explicit ResourceLimitError(std::string const& msg,
+                                    std::string const& limit_)
+                : ProcessingError(msg),
+                  limit { limit_ } {}
+
+        /// Name of the exceeded limit
+        std::string limit;
+    };
+
     std::string module_name;
     std::vector<std::string> actions;
     PCPClient::Validator config_validator_;
@@ -0,0 +1,80 @@
+#ifndef SRC_MODULES_FILE_TRANSFER_H_
+#define SRC_MODULES_FILE_TRANSFER_H_
+
+#include <pxp-agent/module.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace PXPAgent {
+namespace Modules {
+
+/// Receives files in sequenced chunks, writing them directly to disk.
+///
+/// The chunks of a file are written to a partial file next to its
+/// destination ('<destination>.part') by the 'write_chunk' action; a
+/// chunk's data can be sent as the payload of a binary request or, for
+/// text, as the 'data' parameter. Chunks must be sent in sequence; a
+/// chunk can be re-sent (its offset must not exceed the size of the
+/// partial file), so that an interrupted upload can be resumed from
+/// the size returned by the 'status' action.
+/// The 'commit' action verifies the SHA-256 checksum of the partial
+/// file and renames it to its destination.
+///
+/// Destinations must be within the root directory the module is
+/// configured with; the operations on a destination are serialized,
+/// while different destinations are processed concurrently.
+class FileTransfer : public PXPAgent::Module {
+  public:
+    /// Suffix of the partial files
+    static const std::string PARTIAL_SUFFIX;
+
+    /// Files are only written within root_dir; in case it's empty,
+    /// all the transfers are rejected.
+    explicit FileTransfer(const std::string& root_dir);
+
+  private:
+    const std::string root_dir_;
+
+    /// Number of bytes written to each partial file since it was last
+    /// synced to disk; the files are synced in batches, once enough
+    /// data has been written, and before being committed
+    std::map<std::string, size_t> unsynced_bytes_;
+
+    /// Locks of the destinations that are being processed; an entry
+    /// is removed once no request is using it
+    std::map<std::string, std::shared_ptr<PCPClient::Util::mutex>> destination_mutexes_;
+
+    /// Protects the maps above
+    PCPClient::Util::mutex mutex_;
+
+    ActionOutcome callAction(const ActionRequest& request);
+
+    /// Throw a Module::ProcessingError in case the destination is not
+    /// an absolute path within the root directory, it contains '.' or
+    /// '..' components, or one of its parents within the root
+    /// directory, or its partial file, is a symbolic link
+    void validateDestination(const std::string& destination);
+
+    std::shared_ptr<PCPClient::Util::mutex> acquireDestinationMutex(
+        const std::string& destination);
+
+    void releaseDestinationMutex(const std::string& destination,
+                                 std::shared_ptr<PCPClient::Util::mutex>& destination_mutex);
+
+    lth_jc::JsonContainer writeChunk(const ActionRequest& request,
+                                     const std::string& destination);
+
+    lth_jc::JsonContainer getStatus(const std::string& destination);
+
+    lth_jc::JsonContainer commit(const ActionRequest& request,
+                                 const std::string& destination);
+};
+
+}  // namespace Modules
+}  // namespace PXPAgent
+
+#endif  // SRC_MODULES_FILE_TRANSFER_H_
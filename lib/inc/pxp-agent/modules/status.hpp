@@ -3,7 +3,12 @@
 
 #include <pxp-agent/module.hpp>
 
+#include <memory>
+
 namespace PXPAgent {
+
+class JobJournal;
+
 namespace Modules {
 
 class Status : public PXPAgent::Module {
@@ -13,8 +18,12 @@ class Status : public PXPAgent::Module {
     static const std::string FAILURE;
     static const std::string RUNNING;
 
-    Status();
+    /// The results of completed jobs are retrieved from the journal,
+    /// if specified, and then from the spool directory
+    explicit Status(std::shared_ptr<JobJournal> journal = nullptr);
   private:
+    std::shared_ptr<JobJournal> journal_;
+
     ActionOutcome callAction(const ActionRequest& request);
 };
 
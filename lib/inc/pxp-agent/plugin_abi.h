@@ -0,0 +1,58 @@
+/*
+ * C ABI of the pxp-agent plugin modules.
+ *
+ * A plugin module is a shared library, placed in the modules directory
+ * with the platform suffix (e.g. '.so'), that is loaded in the
+ * pxp-agent process; its actions are executed in-process, without
+ * spawning any process. The plugin metadata and the action input and
+ * output are the same JSON documents exchanged with external modules,
+ * so plugins get the same schema validation and result handling.
+ *
+ * A plugin must export the following symbols with C linkage:
+ *
+ *  - int pxp_plugin_abi_version(void)
+ *      return PXP_PLUGIN_ABI_VERSION;
+ *
+ *  - const char* pxp_plugin_metadata(void)
+ *      return the module metadata as a NUL-terminated JSON string owned
+ *      by the plugin, valid until the library is unloaded;
+ *
+ *  - int pxp_plugin_call_action(const char* action, const char* input,
+ *                               char** output, char** error)
+ *      execute the specified action with the specified JSON input
+ *      ({"params" : ..., "config" : ...}); set *output to the JSON
+ *      results and, optionally, *error to an error message, as
+ *      NUL-terminated buffers that pxp-agent releases by calling
+ *      pxp_plugin_free(); return the action exit code (0 on success);
+ *
+ *  - void pxp_plugin_free(char* buffer)
+ *      release a buffer returned by pxp_plugin_call_action().
+ *
+ * pxp_plugin_call_action() may be called concurrently by multiple
+ * threads and must not terminate the process, raise signals, or
+ * propagate C++ exceptions. A faulty plugin takes down the agent; use
+ * external modules for untrusted or unstable code.
+ */
+
+#ifndef PXP_AGENT_PLUGIN_ABI_H_
+#define PXP_AGENT_PLUGIN_ABI_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PXP_PLUGIN_ABI_VERSION 1
+
+typedef int (*pxp_plugin_abi_version_fn)(void);
+typedef const char* (*pxp_plugin_metadata_fn)(void);
+typedef int (*pxp_plugin_call_action_fn)(const char* action,
+                                         const char* input,
+                                         char** output,
+                                         char** error);
+typedef void (*pxp_plugin_free_fn)(char* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* PXP_AGENT_PLUGIN_ABI_H_ */
@@ -0,0 +1,56 @@
+#ifndef SRC_PLUGIN_MODULE_H_
+#define SRC_PLUGIN_MODULE_H_
+
+#include <pxp-agent/external_module.hpp>
+#include <pxp-agent/plugin_abi.h>
+
+#include <memory>
+#include <string>
+
+namespace PXPAgent {
+
+/// Module provided by a shared library implementing the plugin C ABI
+/// (see plugin_abi.h); its actions are executed in the pxp-agent
+/// process. The metadata, the configuration, the output limits, and
+/// the action input and output are handled as for external modules.
+class PluginModule : public ExternalModule {
+  public:
+    /// Suffix of the plugin files
+    static const std::string PLUGIN_SUFFIX;
+
+    /// Load the plugin library and register its metadata; a private
+    /// copy of the library is loaded, so that a new version of the
+    /// file can be loaded while the previous one is in use.
+    /// Throw a Module::LoadingError in case the library can't be
+    /// loaded, it doesn't export the ABI symbols, its ABI version is
+    /// not supported, or in case of invalid metadata; also in case
+    /// the copy can't be loaded and the library is already loaded.
+    explicit PluginModule(const std::string& path,
+                          const lth_jc::JsonContainer& config =
+                              lth_jc::JsonContainer { "{}" });
+
+  private:
+    /// Handle and entry points of the loaded library; the library is
+    /// unloaded once the module is destroyed
+    struct Library {
+        void* handle;
+        pxp_plugin_metadata_fn metadata;
+        pxp_plugin_call_action_fn call_action;
+        pxp_plugin_free_fn free;
+
+        explicit Library(const std::string& path);
+        ~Library();
+    };
+
+    std::unique_ptr<Library> library_;
+
+    PluginModule(const std::string& path,
+                 const lth_jc::JsonContainer& config,
+                 std::unique_ptr<Library> library);
+
+    ActionOutcome callAction(const ActionRequest& request);
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_PLUGIN_MODULE_H_
@@ -16,6 +16,7 @@
 
 #include <cassert>
 #include <memory>
+#include <vector>
 
 namespace PXPAgent {
 
@@ -34,6 +35,16 @@ class PXPConnector : public PCPClient::Connector {
                     const ActionRequest& request,
                     const std::string& description);
 
+    /// Send a PXP error for a request that was rejected before being
+    /// parsed; in case retry_after is positive, it's included as the
+    /// number of seconds after which the request would be accepted.
+    TEST_VIRTUAL_SPECIFIER void sendPXPError(
+                    const std::string& request_id,
+                    const std::string& transaction_id,
+                    const std::string& sender,
+                    const std::string& description,
+                    int retry_after = 0);
+
     TEST_VIRTUAL_SPECIFIER void sendBlockingResponse(
                     const ActionRequest& request,
                     const leatherman::json_container::JsonContainer& results);
@@ -43,6 +54,28 @@ class PXPConnector : public PCPClient::Connector {
                     const leatherman::json_container::JsonContainer& results,
                     const std::string& job_id);
 
+    /// Send a batch response; results must contain an entry for
+    /// each action of the batch request, in the same order.
+    TEST_VIRTUAL_SPECIFIER void sendBatchResponse(
+                    const ActionRequest& request,
+                    const std::vector<lth_jc::JsonContainer>& results);
+
+    /// Send the results text of a blocking or, if job_id is not
+    /// empty, non-blocking response as a sequence of response chunk
+    /// messages, each carrying at most chunk_size bytes, followed by
+    /// a response end message that carries the number of chunks and
+    /// the size and the SHA-256 checksum of the whole results text.
+    /// In case the requester accepts the gzip encoding, the results
+    /// text is compressed and Base64 encoded before being chunked;
+    /// the size and the checksum are the ones of the encoded text and
+    /// the response end message includes the results encoding.
+    /// In case it fails to send a chunk, no further message is sent.
+    TEST_VIRTUAL_SPECIFIER void sendChunkedResponse(
+                    const ActionRequest& request,
+                    const std::string& results_txt,
+                    size_t chunk_size,
+                    const std::string& job_id = "");
+
     TEST_VIRTUAL_SPECIFIER void sendProvisionalResponse(
                     const ActionRequest& request);
 };
@@ -27,6 +27,40 @@ PCPClient::Schema NonBlockingRequestSchema();
 PCPClient::Schema NonBlockingResponseSchema();
 PCPClient::Schema ProvisionalResponseSchema();
 
+// PXP blocking and non blocking transactions with binary data; the
+// data chunk starts with a line containing the JSON request entries
+// (as for the JSON requests), followed by the binary payload that is
+// passed to the module; responses are the JSON ones
+static const std::string BLOCKING_BINARY_REQUEST_TYPE  {
+    "http://puppetlabs.com/rpc_blocking_binary_request" };
+static const std::string NON_BLOCKING_BINARY_REQUEST_TYPE  {
+    "http://puppetlabs.com/rpc_non_blocking_binary_request" };
+PCPClient::Schema BlockingBinaryRequestSchema();
+PCPClient::Schema NonBlockingBinaryRequestSchema();
+
+// Encoding of the results of blocking and non-blocking responses that
+// can be requested by the 'response_encoding' entry; the encoded
+// results are gzip compressed and then Base64 encoded
+static const std::string GZIP_ENCODING { "gzip" };
+
+// PXP batch transaction; the actions are executed as blocking ones
+// and their outcomes are sent back in a single batch response
+static const std::string BATCH_REQUEST_TYPE  {
+    "http://puppetlabs.com/rpc_batch_request" };
+static const std::string BATCH_RESPONSE_TYPE {
+    "http://puppetlabs.com/rpc_batch_response" };
+PCPClient::Schema BatchRequestSchema();
+PCPClient::Schema BatchResponseSchema();
+
+// PXP chunked response; results larger than the configured chunk
+// size are sent as a sequence of chunks followed by a terminator
+static const std::string RESPONSE_CHUNK_TYPE {
+    "http://puppetlabs.com/rpc_response_chunk" };
+static const std::string RESPONSE_END_TYPE {
+    "http://puppetlabs.com/rpc_response_end" };
+PCPClient::Schema ResponseChunkSchema();
+PCPClient::Schema ResponseEndSchema();
+
 // PXP error
 static const std::string PXP_ERROR_MSG_TYPE {
     "http://puppetlabs.com/rpc_error_message" };
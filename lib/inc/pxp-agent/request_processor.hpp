@@ -4,11 +4,21 @@
 #include <pxp-agent/module.hpp>
 #include <pxp-agent/thread_container.hpp>
 #include <pxp-agent/action_request.hpp>
+#include <pxp-agent/job_journal.hpp>
 #include <pxp-agent/pxp_connector.hpp>
 #include <pxp-agent/configuration.hpp>
+#include <pxp-agent/util/rate_limiter.hpp>
+
+#ifndef _WIN32
+#include <pxp-agent/util/posix/directory_watcher.hpp>
+#endif
+
+#include <cpp-pcp-client/util/thread.hpp>
 
 #include <boost/filesystem/path.hpp>
 
+#include <ctime>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -32,7 +42,12 @@ class RequestProcessor {
     /// requester a blocking response containing the action results.
     /// Propagates possible request errors raised by the action logic.
     /// In case it fails to send the response, no further attempt will
-    /// be made.
+    /// be made. In case response chunking is enabled and the results
+    /// exceed the chunk size, send them as a chunked response.
+    ///
+    /// In case of batch request, execute its actions as blocking
+    /// ones and send back a single response containing the outcome
+    /// of each of them.
     ///
     /// In case of non-blocking action, start a task for the specified
     /// action in a separate execution thread.
@@ -45,7 +60,27 @@ class RequestProcessor {
     void processRequest(const RequestType& request_type,
                         const PCPClient::ParsedChunks& parsed_chunks);
 
+    /// Rescan the modules directory and the modules configuration
+    /// directory and reload the external modules whose file or
+    /// configuration changed; unchanged modules are not reloaded.
+    /// The new set of modules is then swapped in atomically: requests
+    /// that are already being processed, including non-blocking jobs,
+    /// keep using the module instances they started with.
+    /// On *nix, it's called automatically when the content of the
+    /// directories changes (Linux only) or on SIGHUP.
+    void reloadModules();
+
   private:
+    typedef std::map<std::string, std::shared_ptr<Module>> ModulesMap;
+
+    /// State of a loaded external module, used to determine whether
+    /// it must be reloaded
+    struct ExternalModuleState {
+        std::time_t mtime;
+        std::string config_txt;
+        std::shared_ptr<Module> module;
+    };
+
     /// Manages the lifecycle of non-blocking action jobs
     ThreadContainer thread_container_;
 
@@ -56,15 +91,73 @@ class RequestProcessor {
     /// be created
     const std::string spool_dir_;
 
-    /// Modules
-    std::map<std::string, std::shared_ptr<Module>> modules_;
+    /// Stores the results of completed non-blocking jobs, in case
+    /// spool-format is 'journal'; null otherwise
+    std::shared_ptr<JobJournal> journal_;
+
+    /// Modules; a published map is never modified, as reloads swap
+    /// in a new one, so that readers can use a snapshot of it without
+    /// holding the lock
+    std::shared_ptr<const ModulesMap> modules_;
+    PCPClient::Util::mutex modules_mutex_;
+
+    /// Internal modules; loaded once
+    ModulesMap internal_modules_;
+
+    /// Where the external modules are stored
+    const std::string modules_dir_;
 
     /// Where the configuration files of modules are stored
     const std::string modules_config_dir_;
 
+    /// Where the file_transfer module writes files
+    const std::string file_transfer_dir_;
+
     /// Modules configuration
     std::map<std::string, lth_jc::JsonContainer> modules_config_;
 
+    /// State of the loaded external modules, by file path
+    std::map<std::string, ExternalModuleState> external_modules_state_;
+
+    /// Serializes the (re)loading of modules
+    PCPClient::Util::mutex reload_mutex_;
+
+    /// Results larger than this size, in bytes, are sent as chunked
+    /// responses; zero means responses are never chunked
+    const size_t response_chunk_size_;
+
+    /// Output files of non-blocking actions larger than this size,
+    /// in bytes, are compressed once the action completes; zero
+    /// means no compression
+    const size_t spool_compression_threshold_;
+
+    /// Limits the rate of requests, per sender and overall
+    Util::RateLimiter rate_limiter_;
+
+    /// Requests whose data (binary data plus params) is larger than
+    /// this size, in bytes, are rejected; zero means no limit
+    const size_t max_request_size_;
+
+    /// Return false in case the request must be rejected, after
+    /// sending a PXP error: when it exceeds the rate limits, or when
+    /// it targets an unknown module or action.
+    /// Only the envelope and the module, action, and transaction_id
+    /// entries are inspected, before the request is copied and
+    /// validated, so that rejected requests are cheap to process;
+    /// requests that can't be inspected are left to ActionRequest.
+    bool preDispatch(const RequestType& request_type,
+                     const PCPClient::ParsedChunks& parsed_chunks);
+
+    /// Return a snapshot of the loaded modules
+    std::shared_ptr<const ModulesMap> getModules();
+
+    /// Throw a RequestProcessor::Error in case of unknown module
+    std::shared_ptr<Module> getModule(const std::string& module_name);
+
+    /// Throw a RequestProcessor::Error in case the specified size of
+    /// the request data exceeds the maximum request size
+    void checkRequestSize(size_t size) const;
+
     /// Throw a RequestProcessor::Error in case of unknown module,
     /// unknown action, or if the requested input parameters entry
     /// does not match the JSON schema defined for the relevant action
@@ -74,6 +167,24 @@ class RequestProcessor {
 
     void processNonBlockingRequest(const ActionRequest& request);
 
+    /// Execute the actions of the batch request, sequentially or, if
+    /// the parallel flag is set, in separate threads, and send back a
+    /// single batch response.
+    /// Throw a RequestProcessor::Error if the batch is too large.
+    void processBatchRequest(const ActionRequest& request);
+
+    /// Validate and execute an action of a batch request; return its
+    /// entry of the batch response, containing either the action
+    /// results or the error message.
+    lth_jc::JsonContainer processBatchEntry(const ActionRequest& entry);
+
+    /// Inspect the spool directory for jobs flagged as running by a
+    /// previous pxp-agent instance. In case a job process is still
+    /// executing, start a task that waits for its completion and then
+    /// stores its outcome. Otherwise, store the outcome retrieved
+    /// from disk or, if unknown, flag the job as failed.
+    void recoverOrphanedJobs();
+
     /// Load the modules configuration files
     void loadModulesConfiguration();
 
@@ -81,10 +192,23 @@ class RequestProcessor {
     void loadInternalModules();
 
     /// Load the external modules contained in the specified directory
-    void loadExternalModulesFrom(boost::filesystem::path modules_dir_path);
+    /// into the specified map; the modules whose file and
+    /// configuration did not change since they were loaded are reused
+    void loadExternalModulesFrom(boost::filesystem::path modules_dir_path,
+                                 ModulesMap& modules);
+
+    /// Load the modules configuration and the external modules, then
+    /// publish the new modules map
+    void loadModules();
 
     /// Log the loaded modules
-    void logLoadedModules() const;
+    void logLoadedModules(const ModulesMap& modules) const;
+
+#ifndef _WIN32
+    /// Triggers the reload of modules; declared last, so that it's
+    /// stopped before any other member is destroyed
+    std::unique_ptr<Util::DirectoryWatcher> watcher_;
+#endif
 };
 
 }  // namespace PXPAgent
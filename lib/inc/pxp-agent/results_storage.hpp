@@ -0,0 +1,173 @@
+#ifndef SRC_AGENT_RESULTS_STORAGE_HPP_
+#define SRC_AGENT_RESULTS_STORAGE_HPP_
+
+#include <pxp-agent/action_outcome.hpp>
+#include <pxp-agent/action_request.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace PXPAgent {
+
+namespace lth_jc = leatherman::json_container;
+
+class JobJournal;
+
+/// Manages the files that store the metadata and the outcome of a
+/// non-blocking action job; they are located in the
+/// spool-dir/<transaction_id> directory.
+class ResultsStorage {
+  public:
+    struct Error : public std::runtime_error {
+        explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+    };
+
+    /// Names of the result files
+    static const std::string STATUS_FILE;
+    static const std::string STDOUT_FILE;
+    static const std::string STDERR_FILE;
+    static const std::string EXITCODE_FILE;
+    static const std::string PID_FILE;
+    static const std::string RESOURCES_FILE;
+    static const std::string PROGRESS_FILE;
+
+    /// Suffix of the compressed output files
+    static const std::string COMPRESSED_SUFFIX;
+
+    /// Values of the 'status' entry of the status file
+    static const std::string RUNNING;
+    static const std::string COMPLETED;
+    static const std::string FAILED;
+
+    /// Create the results directory, if necessary, and write the
+    /// status file of the job, flagging it as running; the output
+    /// files are created by the job process (a missing output file
+    /// means no output).
+    /// Throw a ResultsStorage::Error in case of failure while writing
+    /// the status file.
+    ResultsStorage(const ActionRequest& request, const std::string& results_dir);
+
+    /// Load the status of an existing job.
+    /// Throw a ResultsStorage::Error in case the status file cannot
+    /// be read or parsed.
+    explicit ResultsStorage(const std::string& results_dir);
+
+    /// Flag the job as completed and store its outcome; the resource
+    /// usage of its process, if previously stored by
+    /// writeResourceUsage(), is recorded in the status file.
+    /// The output is stored before the status, so that a completed
+    /// job is never found without its output.
+    void write(const ActionOutcome& outcome, const std::string& exec_error,
+               const std::string& duration);
+
+    /// Flag as completed a job whose process terminated without
+    /// being waited by pxp-agent (e.g. its execution spanned an
+    /// agent restart); its output is already stored in the results
+    /// directory.
+    void writeRecovered(int exitcode, const std::string& duration);
+
+    /// Flag as failed a job whose outcome cannot be determined and
+    /// append the specified reason to its stderr file.
+    void markFailed(const std::string& reason);
+
+    /// Record that the job process was terminated for exceeding the
+    /// specified resource limit; the entry is stored by write().
+    void setLimitExceeded(const std::string& limit);
+
+    /// Replace the stdout and stderr files of the completed job with
+    /// their gzip compressed version (with the COMPRESSED_SUFFIX) in
+    /// case they are larger than the specified threshold, in bytes.
+    /// Failures are logged; the uncompressed files are left in place.
+    void compressOutput(size_t threshold);
+
+    /// Append the record of the completed job (status, stdout, and
+    /// stderr) to the journal and remove the results directory.
+    /// Throw a ResultsStorage::Error in case the record can't be
+    /// appended; the results directory is left in place.
+    void archive(JobJournal& journal);
+
+    bool isRunning() const;
+
+    /// Set whether the result files are synced to disk when written,
+    /// so that they survive a crash; the syncs of concurrent jobs are
+    /// group committed. Syncing is supported only on POSIX platforms.
+    static void setSyncWrites(bool sync);
+
+    const std::string& resultsDir() const;
+
+    /// Store the PID and the start time of the process executing the
+    /// job action, so that it can be retrieved after a restart.
+    static void writeProcessInfo(const std::string& results_dir,
+                                 int pid,
+                                 const std::string& start_time);
+
+    /// Store the resources consumed by the process executing the job
+    /// action (wall and CPU time, memory, I/O).
+    static void writeResourceUsage(const std::string& results_dir,
+                                   const lth_jc::JsonContainer& usage);
+
+    /// Return true and set the pid and start_time arguments in case
+    /// the process info file of the job exists and is valid; return
+    /// false otherwise.
+    static bool readProcessInfo(const std::string& results_dir,
+                                int& pid,
+                                std::string& start_time);
+
+    /// Return true and set the exitcode argument in case the exit
+    /// code of the job action was stored on disk; return false
+    /// otherwise.
+    static bool readExitcode(const std::string& results_dir, int& exitcode);
+
+    /// Return true and set the progress argument in case the module
+    /// stored the progress of the job action in the progress file,
+    /// in JSON format; return false otherwise.
+    static bool readProgress(const std::string& results_dir,
+                             lth_jc::JsonContainer& progress);
+
+    /// Return the content of the specified output file (STDOUT_FILE
+    /// or STDERR_FILE) of the job, decompressing it in case it was
+    /// stored by compressOutput(); return an empty string in case
+    /// the file does not exist.
+    /// Throw a ResultsStorage::Error in case of invalid compressed
+    /// data.
+    static std::string readOutput(const std::string& results_dir,
+                                  const std::string& file_name);
+
+    /// Return at most length bytes (up to its end, if length is
+    /// negative) of the specified output file of the job, starting
+    /// at offset, and set size to the size of the whole output; a
+    /// compressed output is decompressed only up to the end of the
+    /// range. Return an empty string, and set size to zero, in case
+    /// the file does not exist.
+    /// Throw a ResultsStorage::Error in case of invalid compressed
+    /// data.
+    static std::string readOutputRange(const std::string& results_dir,
+                                       const std::string& file_name,
+                                       uint64_t offset,
+                                       int64_t length,
+                                       uint64_t& size);
+
+    /// Return true in case the specified output file of the job is
+    /// stored compressed.
+    static bool isOutputCompressed(const std::string& results_dir,
+                                   const std::string& file_name);
+
+  private:
+    std::string results_dir_;
+    std::string out_path_;
+    std::string err_path_;
+    std::string status_path_;
+    lth_jc::JsonContainer action_status_;
+
+    void initialize(const ActionRequest& request);
+    void readResourceUsage();
+    void compressFile(const std::string& file_path, size_t threshold);
+    void writeStatus();
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_RESULTS_STORAGE_HPP_
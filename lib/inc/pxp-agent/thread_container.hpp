@@ -3,55 +3,36 @@
 
 #include <cpp-pcp-client/util/thread.hpp>
 
-#include <vector>
+#include <functional>
 #include <memory>   // shared_ptr
-#include <atomic>
 #include <string>
+#include <unordered_map>
 
 namespace PXPAgent {
 
-static const uint32_t THREADS_MONITORING_INTERVAL_MS { 500 };  // [ms]
-
-// Number of stored threads above which we start the monitoring task
-static const uint32_t THREADS_THRESHOLD { 10 };
-
-struct ManagedThread {
-    /// Thread object
-    PCPClient::Util::thread the_instance;
-
-    /// Flag that indicates whether or not the thread has finished its
-    /// execution
-    std::shared_ptr<std::atomic<bool>> is_done;
-};
-
-/// Store thread objects. If the number of stored threads is greater
-/// than the specified threshold, the container will delete the
-/// instances of those threads that have completed their execution,
-/// after detaching them. It is assumed that the completion of a given
-/// thread is indicated by the associated atomic flag 'done'.
+/// Execute tasks in separate threads and manage the lifecycle of the
+/// relative thread objects.
+///
+/// Each thread signals its own completion: once its task is done,
+/// the thread removes its object from the container and detaches it,
+/// so that completed threads are reaped immediately, in constant
+/// time, and no periodic inspection of the stored threads is needed.
 ///
-/// The purpose of this class is to manage the lifecycle of threads;
-/// in case one or more stored threads are executing by the time
-/// the ThreadContainer destructor is called, the std::terminate
-/// function will be invoked; the program will then immediately abort.
+/// In case one or more threads are still executing by the time the
+/// ThreadContainer destructor is called, they will be detached; their
+/// completion will then be ignored.
 class ThreadContainer {
   public:
-    uint32_t check_interval;  // [ms]
-    uint32_t threads_threshold;  // number of stored thread objects
-
-    ThreadContainer(const std::string& name = "",
-                    uint32_t _check_interval = THREADS_MONITORING_INTERVAL_MS,
-                    uint32_t _threads_threshold = THREADS_THRESHOLD);
+    ThreadContainer(const std::string& name = "");
     ~ThreadContainer();
 
-    /// Add the specified thread instance to the container together
-    /// with the pointer to the atomic boolean that will tell when
-    /// it has completed its execution
-    void add(PCPClient::Util::thread task, std::shared_ptr<std::atomic<bool>> done);
+    /// Execute the specified task in a new thread.
+    /// Exceptions thrown by the task will be logged and filtered.
+    /// Throw a std::system_error in case the thread cannot be started.
+    void add(std::function<void()> task);
 
-    /// Return true if the monitoring thread is actually executing,
-    /// false otherwise
-    bool isMonitoring();
+    /// Number of threads that are currently executing
+    uint32_t getNumRunningThreads();
 
     uint32_t getNumAddedThreads();
     uint32_t getNumErasedThreads();
@@ -59,17 +40,22 @@ class ThreadContainer {
     void setName(const std::string& name);
 
   private:
-    std::string name_;
-    std::vector<std::shared_ptr<ManagedThread>> threads_;
-    std::unique_ptr<PCPClient::Util::thread> monitoring_thread_ptr_;
-    bool destructing_;
-    PCPClient::Util::mutex mutex_;
-    PCPClient::Util::condition_variable cond_var_;
-    bool is_monitoring_;
-    uint32_t num_added_threads_;
-    uint32_t num_erased_threads_;
-
-    void monitoringTask_();
+    /// State shared with the managed threads; it outlives the
+    /// container in case threads are still executing when the
+    /// container is destroyed
+    struct State {
+        PCPClient::Util::mutex mutex;
+        std::unordered_map<uint32_t, PCPClient::Util::thread> threads;
+        std::string name;
+        uint32_t num_added_threads { 0 };
+        uint32_t num_erased_threads { 0 };
+    };
+
+    std::shared_ptr<State> state_;
+
+    /// Remove the object of the specified thread and detach it;
+    /// meant to be called by the thread itself when it's done
+    static void reap(std::shared_ptr<State> state, uint32_t thread_idx);
 };
 
 }  // namespace PXPAgent
@@ -0,0 +1,24 @@
+#ifndef SRC_AGENT_UTIL_CHECKSUM_HPP_
+#define SRC_AGENT_UTIL_CHECKSUM_HPP_
+
+#include <stdexcept>
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+
+// Return the SHA-256 digest of the specified data, as a lowercase
+// hexadecimal string.
+// Throw a std::runtime_error in case the digest can't be computed.
+std::string getSha256(const std::string& data);
+
+// Return the SHA-256 digest of the content of the specified file, as
+// a lowercase hexadecimal string; the file is read in blocks.
+// Throw a std::runtime_error in case the file can't be read or the
+// digest can't be computed.
+std::string getFileSha256(const std::string& file_path);
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_UTIL_CHECKSUM_HPP_
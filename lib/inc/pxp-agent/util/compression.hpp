@@ -0,0 +1,47 @@
+#ifndef SRC_AGENT_UTIL_COMPRESSION_HPP_
+#define SRC_AGENT_UTIL_COMPRESSION_HPP_
+
+#include <cstdint>
+#include <istream>
+#include <stdexcept>
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+
+struct compression_error : public std::runtime_error {
+    explicit compression_error(std::string const& msg) : std::runtime_error(msg) {}
+};
+
+// Return the specified data compressed in the gzip format, so that
+// it can be inspected with the standard tools (e.g. zcat).
+// Throw a compression_error in case of zlib failure.
+std::string gzipCompress(const std::string& data);
+
+// Return the decompressed content of the specified gzip data.
+// Throw a compression_error in case the data is not valid gzip.
+std::string gzipDecompress(const std::string& data);
+
+// Return at most length bytes (up to the end, if length is negative)
+// of the decompressed content of the gzip data read from the input
+// stream, starting at offset. The data is inflated in blocks, the
+// bytes preceding offset are discarded, and inflation stops once the
+// range is complete, so that memory usage is bounded by the range.
+// Throw a compression_error in case the data is not valid gzip.
+std::string gzipDecompressRange(std::istream& input,
+                                uint64_t offset,
+                                int64_t length);
+
+// Return the decompressed size of the gzip data read from the input
+// stream, as stored in its trailer; the size is modulo 4 GiB, which
+// is exact for the data compressed by gzipCompress().
+// Throw a compression_error in case the data is too short.
+uint64_t gzipDecompressedSize(std::istream& input);
+
+// Return the Base64 encoding of the specified data
+std::string encodeBase64(const std::string& data);
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_UTIL_COMPRESSION_HPP_
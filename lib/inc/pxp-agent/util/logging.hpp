@@ -0,0 +1,223 @@
+#ifndef SRC_AGENT_UTIL_LOGGING_HPP_
+#define SRC_AGENT_UTIL_LOGGING_HPP_
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+
+// Maximum size of the payloads (request data, action input and
+// output) included in log messages [bytes]
+extern const size_t MAX_LOGGED_PAYLOAD_SIZE;
+
+// Return the payload, truncated to max_size bytes, without splitting
+// UTF-8 characters, and followed by the number of omitted bytes.
+// NB: the LOG_ macros evaluate their arguments only in case the
+// level is enabled, so this is called only for messages that are
+// actually logged.
+std::string logPayload(const std::string& payload,
+                       size_t max_size = MAX_LOGGED_PAYLOAD_SIZE);
+
+// Rename the file to path.1, after renaming each existing path.N
+// file to path.N+1; files beyond path.num_kept are removed.
+// Errors are ignored, as the file is reopened anyway.
+void rotateFiles(const std::string& path, unsigned int num_kept);
+
+// Write the log messages to the stream in JSON format, one object
+// per line, with the timestamp, level, and message entries and the
+// entries of the log context of the logging thread.
+// NB: the namespace of the messages is not known, as leatherman
+// doesn't pass it to the message callback; it's included only in
+// the records logged by logEvent().
+void setupJsonLogging(std::ostream& stream);
+
+// Restore the text format of the log messages
+void resetJsonLogging();
+
+bool jsonLoggingEnabled();
+
+// Request being processed by a thread; its entries are included in
+// the JSON log records of the thread
+struct LogContext {
+    std::string request_id;
+    std::string transaction_id;
+    std::string sender;
+    std::string module;
+    std::string action;
+};
+
+// Set the log context of the current thread, restoring the previous
+// one when destroyed
+class LogContextScope {
+  public:
+    LogContextScope(const std::string& request_id,
+                    const std::string& transaction_id,
+                    const std::string& sender,
+                    const std::string& module,
+                    const std::string& action);
+    ~LogContextScope();
+
+  private:
+    LogContext previous_context_;
+};
+
+// In case JSON logging is enabled, log at info level a record of
+// the event with the specified namespace, the log context of the
+// thread, and the specified entries (e.g. the duration)
+void logEvent(const std::string& log_namespace,
+              const std::string& event,
+              const leatherman::json_container::JsonContainer& entries =
+                  leatherman::json_container::JsonContainer {});
+
+// Log the event when destroyed, with its duration_ms and, in case
+// it failed (an exception is being thrown or fail() was called), the
+// failed entry
+class LogEventScope {
+  public:
+    LogEventScope(const std::string& log_namespace, const std::string& event);
+    ~LogEventScope();
+
+    void fail() { failed_ = true; }
+
+  private:
+    const std::string log_namespace_;
+    const std::string event_;
+    const std::chrono::steady_clock::time_point start_;
+    bool failed_;
+};
+
+// Output stream for log messages that queues the entries and writes
+// them to the destination stream from a dedicated thread, so that
+// logging threads never wait for the file I/O. An entry is queued
+// each time the stream is flushed, as done by the logging libraries
+// after each message; the text of each entry is accumulated by the
+// logging thread.
+// Entries are queued in a lock-free ring buffer and written in
+// batches, every FLUSH_INTERVAL or once half of the capacity is
+// used. The queue holds up to capacity bytes; further entries are
+// dropped and their number is reported once the queue is written.
+// Before start() and after stop(), entries are written synchronously.
+class AsyncLogStream : public std::ostream {
+  public:
+    static const size_t DEFAULT_CAPACITY;
+    static const std::chrono::milliseconds FLUSH_INTERVAL;
+
+    // The reopen function, if any, is called by reopen() to reopen
+    // the destination (e.g. after the log file is rotated)
+    AsyncLogStream(std::ostream& destination,
+                   std::function<void()> reopen = nullptr,
+                   size_t capacity = DEFAULT_CAPACITY);
+
+    // Write the queued entries and stop the writer thread
+    ~AsyncLogStream();
+
+    // Make the writer thread call the rotate function once max_size
+    // bytes have been written to the destination (initial_size being
+    // its current size) or max_age has elapsed since the last
+    // rotation; zero values disable the relevant check. It must be
+    // called before start().
+    void setRotation(std::function<void()> rotate,
+                     size_t max_size,
+                     std::chrono::seconds max_age,
+                     size_t initial_size = 0);
+
+    // Start the writer thread; it must be done after forking
+    // processes that log, as the thread is not inherited
+    void start();
+
+    // Write the queued entries and stop the writer thread
+    void stop();
+
+    // Reopen the destination once the queued entries are written.
+    // NB: it only sets a flag when the writer thread is running, so
+    // it can be called by a signal handler
+    void reopen();
+
+  private:
+    class Buffer : public std::streambuf {
+      public:
+        Buffer(std::ostream& destination,
+               std::function<void()> reopen,
+               size_t capacity);
+
+        void setRotation(std::function<void()> rotate,
+                         size_t max_size,
+                         std::chrono::seconds max_age,
+                         size_t initial_size);
+        void start();
+        void stop();
+        void reopen();
+
+      protected:
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char* s, std::streamsize n) override;
+        int sync() override;
+
+      private:
+        using Clock = std::chrono::steady_clock;
+
+        // Slot of the ring buffer; the sequence number tells whether
+        // the slot is free or holds an entry for the given position
+        struct Slot {
+            std::atomic<size_t> sequence;
+            std::string entry;
+        };
+
+        std::ostream& destination_;
+        std::function<void()> reopen_function_;
+        const size_t capacity_;
+
+        std::unique_ptr<Slot[]> slots_;
+        const size_t slots_mask_;
+        std::atomic<size_t> enqueue_position_;
+        size_t dequeue_position_;
+        std::atomic<size_t> queued_size_;
+        std::atomic<size_t> num_dropped_;
+
+        // Number of threads that are queueing an entry
+        std::atomic<int> num_producers_;
+        std::atomic<bool> running_;
+        std::atomic<bool> stopping_;
+        std::atomic<bool> reopen_requested_;
+
+        std::function<void()> rotate_function_;
+        size_t rotation_size_;
+        std::chrono::seconds rotation_age_;
+        size_t written_size_;
+        Clock::time_point rotation_time_;
+
+        // Serializes the writes to the destination
+        PCPClient::Util::mutex destination_mutex_;
+        // Used only to wake up the writer thread
+        PCPClient::Util::mutex wakeup_mutex_;
+        PCPClient::Util::condition_variable cond_var_;
+        PCPClient::Util::thread writer_;
+
+        std::string& pendingEntry();
+
+        // Return false if the ring buffer is full
+        bool push(std::string& entry);
+        // Return false if the ring buffer is empty; writer only
+        bool pop(std::string& entry);
+
+        void write();
+        void writeQueued();
+    };
+
+    Buffer buffer_;
+};
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_UTIL_LOGGING_HPP_
@@ -0,0 +1,50 @@
+#ifndef SRC_AGENT_UTIL_POSIX_DIRECTORY_WATCHER_HPP_
+#define SRC_AGENT_UTIL_POSIX_DIRECTORY_WATCHER_HPP_
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+namespace Util {
+
+// Call a function, in a dedicated thread, whenever the content of the
+// watched directories changes or the process receives SIGHUP.
+//
+// On Linux, changes are detected with inotify; on other platforms
+// only SIGHUP triggers the function. Changes are debounced: the
+// function is called once no further change has been detected for
+// DEBOUNCE_MS, so that a batch of file updates results in a single
+// call. Directories that don't exist are not watched.
+// Only one DirectoryWatcher should exist at a time, as the SIGHUP
+// disposition is process wide.
+class DirectoryWatcher {
+  public:
+    static const int DEBOUNCE_MS;
+
+    DirectoryWatcher(const std::vector<std::string>& dir_paths,
+                     std::function<void()> on_change);
+
+    // Stop the watcher thread and restore the SIGHUP disposition
+    ~DirectoryWatcher();
+
+  private:
+    std::function<void()> on_change_;
+    int inotify_fd_;
+    std::atomic<bool> stop_;
+    PCPClient::Util::thread thread_;
+
+    void watch();
+
+    // Return true in case of change notifications or SIGHUP within
+    // the specified time interval; consume the notifications
+    bool waitForChanges(int timeout_ms);
+};
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_UTIL_POSIX_DIRECTORY_WATCHER_HPP_
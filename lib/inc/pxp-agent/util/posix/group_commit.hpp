@@ -0,0 +1,73 @@
+#ifndef SRC_AGENT_UTIL_POSIX_GROUP_COMMIT_HPP_
+#define SRC_AGENT_UTIL_POSIX_GROUP_COMMIT_HPP_
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace PXPAgent {
+namespace Util {
+
+struct commit_error : public std::runtime_error {
+    explicit commit_error(std::string const& msg) : std::runtime_error(msg) {}
+};
+
+// Sync the specified files or directories to disk, each one once.
+// Throw a commit_error in case of failure.
+void syncFiles(const std::vector<std::string>& paths);
+
+// Replaces the content of files atomically: each file is written to
+// a temporary file that is then renamed, so that it's never found
+// incomplete.
+// In case syncing is enabled, the temporary files are synced before
+// being renamed and their directories after, so that the content
+// survives a crash. The syncs of concurrent writers are group
+// committed: the first waiting thread commits the files of all the
+// waiting ones, while the others collect the next batch.
+class GroupCommitWriter {
+  public:
+    // Paths and contents of the files to be written
+    using Files = std::vector<std::pair<std::string, std::string>>;
+
+    explicit GroupCommitWriter(bool sync = false);
+
+    void setSync(bool sync);
+
+    bool isSyncing() const;
+
+    // Write the files, renaming them in the given order, and return
+    // once they are committed.
+    // Throw a commit_error in case of failure; files that were
+    // renamed before the failure keep their new content.
+    void write(const Files& files);
+
+    void write(const std::string& path, const std::string& content);
+
+  private:
+    struct Commit {
+        std::vector<std::string> paths;
+        bool done;
+        std::string error;
+    };
+
+    std::atomic<bool> sync_;
+
+    // Commits waiting for the next batch and whether a thread is
+    // committing a batch
+    std::vector<std::shared_ptr<Commit>> pending_;
+    bool committing_;
+    PCPClient::Util::mutex mutex_;
+    PCPClient::Util::condition_variable cond_var_;
+
+    void commitBatch(const std::vector<std::shared_ptr<Commit>>& batch);
+};
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_UTIL_POSIX_GROUP_COMMIT_HPP_
@@ -0,0 +1,280 @@
+#ifndef SRC_AGENT_UTIL_POSIX_PROCESS_HPP_
+#define SRC_AGENT_UTIL_POSIX_PROCESS_HPP_
+
+#include <sys/types.h>          // pid_t
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace PXPAgent {
+namespace Util {
+
+struct process_error : public std::runtime_error {
+    explicit process_error(std::string const& msg) : std::runtime_error(msg) {}
+};
+
+// Names of the limits that can be detected as exceeded
+extern const std::string CPU_TIME_LIMIT;
+extern const std::string MEMORY_LIMIT;
+extern const std::string OUTPUT_SIZE_LIMIT;
+
+// Resource limits applied to a child process before exec; zero
+// values (and an empty cgroup path) mean no limit.
+struct ProcessLimits {
+    // RLIMIT_CPU; the process gets SIGXCPU when exceeding it
+    int cpu_seconds { 0 };
+    // RLIMIT_AS
+    int memory_mb { 0 };
+    // RLIMIT_NOFILE
+    int open_files { 0 };
+    // Scheduling priority, as for setpriority()
+    int nice { 0 };
+    // I/O scheduling class (1 realtime, 2 best-effort, 3 idle) and
+    // priority level within the class; Linux only
+    int ionice_class { 0 };
+    int ionice_level { 0 };
+    // Path of a cgroup v2 directory the process will be moved to
+    std::string cgroup {};
+
+    bool empty() const;
+};
+
+// Environment of a child process, as NAME=value entries; the array
+// passed to execve() is prepared on construction, so that it can be
+// reused by any number of processes.
+class Environment {
+  public:
+    explicit Environment(std::vector<std::string> entries = {});
+    Environment(const Environment& other);
+    Environment& operator=(const Environment& other);
+
+    // Return the environment made of the specified variables and, if
+    // inherit is true, of the other variables of the calling process
+    static Environment build(const std::map<std::string, std::string>& variables,
+                             bool inherit);
+
+    const std::vector<std::string>& entries() const { return entries_; }
+
+    // NULL-terminated array of the entries
+    char* const* envp() const { return envp_.data(); }
+
+  private:
+    std::vector<std::string> entries_;
+    std::vector<char*> envp_;
+
+    void setPointers();
+};
+
+// Resources consumed by a child process, including its descendants
+// that were waited for, as reported by wait4()
+struct ResourceUsage {
+    // Time elapsed between the spawn and the termination of the
+    // process; set by the caller that spawned it
+    double wall_time_s { 0 };
+    double user_cpu_s { 0 };
+    double system_cpu_s { 0 };
+    // Maximum resident set size of the process tree, in KiB
+    long max_rss_kb { 0 };
+    // Number of filesystem input and output block operations
+    long read_blocks { 0 };
+    long written_blocks { 0 };
+};
+
+struct ExecutionResult {
+    int exitcode;
+    std::string output;
+    std::string error;
+    // Name of the exceeded limit, if any was detected
+    std::string limit_exceeded;
+    ResourceUsage usage;
+};
+
+// Start the fork server: a single-threaded helper process, forked
+// from the agent, that creates the processes requested by the
+// functions below on behalf of the agent, so that their creation
+// cost doesn't depend on the agent size and threads. Each process is
+// created by a monitor process, forked from the server, that reports
+// its PID and outcome to the agent. The agent spawns the processes
+// itself if the server is not running or not reachable.
+// Must be called while the agent is single-threaded.
+// Throw a process_error in case the server can't be started.
+void startForkServer();
+
+// Stop the fork server, if running; the processes it created keep
+// executing and their outcome can still be waited for.
+void stopForkServer();
+
+// Spawn the specified executable with the given arguments, wrapped
+// by a minimal /bin/sh script that, once the executable terminates,
+// atomically writes its exit code to exitcode_path. The process
+// output is redirected to the stdout_path and stderr_path files
+// (truncated, if they exist) and the input text is written to its
+// standard input. The specified limits are applied to the wrapper
+// and inherited by the executable; the process gets the specified
+// environment or, if null, the one of the agent.
+// As a consequence, the outcome of the process can be retrieved from
+// disk even if the caller terminates before the process does.
+// In case max_output_size or max_error_size is not zero, the relevant
+// stream is a pipe read by a pump process (/bin/sh and head -c) that
+// stores no more than that many bytes in the file and discards the
+// rest while the process runs, so that the process is not affected;
+// waitForProcess() also waits for the pumps, so that the files are
+// complete once it returns.
+// Return the PID of the wrapper process.
+// Throw a process_error in case it fails to open the output files,
+// to create the pipes, or to create the processes.
+pid_t spawnWrapped(const std::string& file,
+                   const std::vector<std::string>& arguments,
+                   const std::string& input,
+                   const std::string& stdout_path,
+                   const std::string& stderr_path,
+                   const std::string& exitcode_path,
+                   const ProcessLimits& limits = ProcessLimits {},
+                   const Environment* environment = nullptr,
+                   size_t max_output_size = 0,
+                   size_t max_error_size = 0);
+
+// Execute the specified executable with the given arguments, limits
+// and environment (the agent one, if null), write the input text to
+// its standard input, and wait for its completion while collecting
+// its output.
+// At most max_output_size bytes of stdout and max_error_size bytes
+// of stderr are collected (zero means no limit); the rest of the
+// streams is read and discarded, so memory usage is bounded no
+// matter how much the process writes.
+// In case the child fails to apply the limits, it exits with 126 and
+// reports the failure on its stderr.
+// Throw a process_error in case it fails to create the pipes, to
+// create the process, or to wait for it.
+ExecutionResult execute(const std::string& file,
+                        const std::vector<std::string>& arguments,
+                        const std::string& input,
+                        const ProcessLimits& limits = ProcessLimits {},
+                        size_t max_output_size = 0,
+                        size_t max_error_size = 0,
+                        const Environment* environment = nullptr);
+
+// A preloader is a process, executed once, that loads the code of a
+// module and then forks a child for each action request it gets on
+// its standard input, a Unix datagram socket, so that the actions
+// don't pay the startup cost of the interpreter and of the module
+// libraries. The protocol is:
+//  - once ready, the preloader sends the message "ready";
+//  - each request is a message made of the action name and the path
+//    of the exit code file (possibly empty), separated by a NUL
+//    character, carrying four descriptors: the standard streams of
+//    the child and the status socket;
+//  - the preloader forks the child and writes "<PID>\n" to the
+//    status socket; once the child terminates, it writes its exit
+//    code to the exit code file (if any) and "<exit code>\n" to the
+//    status socket, and closes it;
+//  - the preloader exits once the socket is closed and its children
+//    are done.
+class Preloader {
+  public:
+    // Execute the specified command, with the given limits (inherited
+    // by the children) and environment, and wait for the preloader
+    // to be ready. The preloader is always a child of the agent: it's
+    // not created by the fork server.
+    // Throw a process_error in case it fails to create the process
+    // or if the preloader is not ready within the timeout.
+    Preloader(const std::string& file,
+              const std::vector<std::string>& arguments,
+              const ProcessLimits& limits = ProcessLimits {},
+              const Environment* environment = nullptr,
+              int ready_timeout_s = 60);
+
+    // Close the socket; the preloader is reaped asynchronously, by a
+    // thread shared by all the preloaders
+    ~Preloader();
+
+    Preloader(const Preloader&) = delete;
+    Preloader& operator=(const Preloader&) = delete;
+
+    pid_t pid() const { return pid_; }
+
+    const ProcessLimits& limits() const { return limits_; }
+
+    // Return false if the preloader closed its socket (e.g. it died)
+    bool running() const;
+
+    // Request a child executing the specified action, with the given
+    // standard streams; its exit code is also written to
+    // exitcode_path, if not empty.
+    // Return the PID of the child; its outcome can be retrieved by
+    // waitForProcess().
+    // Throw a process_error in case the preloader is not reachable or
+    // fails to create the child.
+    pid_t spawn(const std::string& action,
+                int in_fd, int out_fd, int err_fd,
+                const std::string& exitcode_path = "");
+
+  private:
+    pid_t pid_;
+    int control_fd_;
+    ProcessLimits limits_;
+};
+
+// As spawnWrapped() above; the child is forked by the preloader,
+// that writes its exit code to exitcode_path.
+pid_t spawnWrapped(Preloader& preloader,
+                   const std::string& action,
+                   const std::string& input,
+                   const std::string& stdout_path,
+                   const std::string& stderr_path,
+                   const std::string& exitcode_path,
+                   size_t max_output_size = 0,
+                   size_t max_error_size = 0);
+
+// As execute() above; the child is forked by the preloader and is
+// subject to its limits.
+ExecutionResult execute(Preloader& preloader,
+                        const std::string& action,
+                        const std::string& input,
+                        size_t max_output_size = 0,
+                        size_t max_error_size = 0);
+
+// Wait for the termination of the specified child process and of its
+// output pumps, if any (see spawnWrapped()).
+// Return the exit code of the process or, in case it was terminated
+// by a signal, 128 plus the signal number (as a shell would do).
+// Throw a process_error in case waitpid fails.
+int waitForProcess(pid_t pid);
+
+// As above; also set the CPU, memory, and I/O entries of the usage
+// argument.
+int waitForProcess(pid_t pid, ResourceUsage& usage);
+
+// Return the number of processes of the specified cgroup that were
+// killed by the OOM killer, as reported by memory.events; return 0
+// if the cgroup path is empty or the file cannot be read.
+unsigned long getCgroupOOMKills(const std::string& cgroup);
+
+// Return the name of the limit exceeded by a process, given its exit
+// code and the OOM kills count of its cgroup when it was spawned;
+// return an empty string if no limit violation is detected.
+// NB: only CPU time (SIGXCPU) and cgroup memory (OOM kill) violations
+// can be detected; the failure of a process due to the memory_mb or
+// open_files limits can't be told apart from any other failure.
+std::string getExceededLimit(const ProcessLimits& limits,
+                             int exitcode,
+                             unsigned long oom_kills_before);
+
+// Return the start time of the specified process, in clock ticks
+// since boot, as reported by /proc/<pid>/stat; the value is meant
+// to be compared with a previous reading in order to detect recycled
+// PIDs. Return an empty string if the start time cannot be retrieved
+// (e.g. on platforms without procfs or if the process is gone).
+std::string getProcessStartTime(pid_t pid);
+
+// Return true if a process with the specified PID is executing and,
+// in case a start time is specified, if the process start time
+// matches it; return false otherwise.
+bool isProcessExecuting(pid_t pid, const std::string& start_time);
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_UTIL_POSIX_PROCESS_HPP_
@@ -0,0 +1,78 @@
+#ifndef SRC_AGENT_UTIL_RATE_LIMITER_HPP_
+#define SRC_AGENT_UTIL_RATE_LIMITER_HPP_
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <chrono>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace PXPAgent {
+namespace Util {
+
+// Token bucket rate limiter with a global bucket and a bucket for
+// each key (e.g. the request sender). Buckets hold up to burst
+// tokens and are refilled at the relevant rate; a request is
+// accepted if it can take a token from both buckets.
+class RateLimiter {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // Rates are in requests per second; a zero rate disables the
+    // relevant limit. Burst must be at least 1.
+    RateLimiter(double global_rate, double key_rate, double burst);
+
+    bool enabled() const { return global_rate_ > 0 || key_rate_ > 0; }
+
+    double burst() const { return burst_; }
+
+    // Take a token from the global bucket and from the one of the
+    // specified key, in case both have one, and return zero;
+    // otherwise, take no token and return the time, in seconds,
+    // after which the request would be accepted.
+    double acquire(const std::string& key, Clock::time_point now = Clock::now());
+
+    // As above, taking the specified number of tokens from each
+    // bucket, all or none. NB: a number of tokens larger than burst
+    // can never be taken; the caller must reject such requests.
+    double acquire(const std::string& key,
+                   unsigned int tokens,
+                   Clock::time_point now = Clock::now());
+
+  private:
+    struct Bucket {
+        double tokens;
+        Clock::time_point last_refill;
+    };
+
+    const double global_rate_;
+    const double key_rate_;
+    const double burst_;
+
+    using KeyBuckets = std::list<std::pair<std::string, Bucket>>;
+
+    Bucket global_bucket_;
+    // Key buckets, from the most to the least recently used, and
+    // their index. NB: once the maximum number of buckets is
+    // reached, the least recently used one is evicted, so that a
+    // flood of keys costs constant memory and time per request
+    KeyBuckets key_buckets_;
+    std::unordered_map<std::string, KeyBuckets::iterator> key_index_;
+    PCPClient::Util::mutex mutex_;
+
+    void refill(Bucket& bucket, double rate, Clock::time_point now) const;
+
+    // Time until the bucket has the specified number of tokens [s]
+    double waitTime(const Bucket& bucket, double rate, unsigned int tokens) const;
+
+    // Return the bucket of the key, creating it if needed, and mark
+    // it as the most recently used
+    Bucket& getKeyBucket(const std::string& key, Clock::time_point now);
+};
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_UTIL_RATE_LIMITER_HPP_
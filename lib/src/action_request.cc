@@ -1,4 +1,8 @@
 #include <pxp-agent/action_request.hpp>
+#include <pxp-agent/pxp_schemas.hpp>
+#include <pxp-agent/util/logging.hpp>
+
+#include <cpp-pcp-client/validator/validator.hpp>
 
 #define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.action_request"
 #include <leatherman/logging/logging.hpp>
@@ -12,6 +16,7 @@ ActionRequest::ActionRequest(RequestType type,
         : type_ { type },
           notify_outcome_ { true },
           parsed_chunks_ { parsed_chunks },
+          results_dir_ { "" },
           params_ { "{}" },
           params_txt_ { "" } {
     init();
@@ -22,6 +27,7 @@ ActionRequest::ActionRequest(RequestType type,
         : type_ { type },
           notify_outcome_ { true },
           parsed_chunks_ { parsed_chunks },
+          results_dir_ { "" },
           params_ { "{}" },
           params_txt_ { "" } {
     init();
@@ -39,6 +45,10 @@ const PCPClient::ParsedChunks& ActionRequest::parsedChunks() const {
     return parsed_chunks_;
 }
 
+const std::string& ActionRequest::binaryData() const {
+    return parsed_chunks_.binary_data;
+}
+
 const lth_jc::JsonContainer& ActionRequest::params() const {
     if (params_.empty() && parsed_chunks_.data.includes("params")) {
         params_ = parsed_chunks_.data.get<lth_jc::JsonContainer>("params");
@@ -53,6 +63,44 @@ const std::string& ActionRequest::paramsTxt() const {
     return params_txt_;
 }
 
+std::vector<ActionRequest> ActionRequest::batchEntries() const {
+    std::vector<ActionRequest> entries {};
+
+    if (type_ != RequestType::Batch) {
+        return entries;
+    }
+
+    for (auto& action : parsed_chunks_.data.get<std::vector<lth_jc::JsonContainer>>(
+                            "actions")) {
+        lth_jc::JsonContainer entry_data {};
+        entry_data.set<std::string>("transaction_id", transaction_id_);
+        entry_data.set<std::string>("module", action.get<std::string>("module"));
+        entry_data.set<std::string>("action", action.get<std::string>("action"));
+
+        if (action.includes("params")) {
+            entry_data.set<lth_jc::JsonContainer>(
+                "params", action.get<lth_jc::JsonContainer>("params"));
+        }
+
+        entries.push_back(
+            ActionRequest { RequestType::Blocking,
+                            PCPClient::ParsedChunks { parsed_chunks_.envelope,
+                                                      entry_data,
+                                                      parsed_chunks_.debug,
+                                                      0 } });
+    }
+
+    return entries;
+}
+
+const std::string& ActionRequest::resultsDir() const {
+    return results_dir_;
+}
+
+void ActionRequest::setResultsDir(const std::string& results_dir) {
+    results_dir_ = results_dir;
+}
+
 // Private interface
 
 void ActionRequest::init() {
@@ -61,11 +109,21 @@ void ActionRequest::init() {
 
     LOG_INFO("Validating %1% request %2% by %3%",
              requestTypeNames[type_], id_, sender_);
-    LOG_DEBUG("Request %1%:\n%2%", id_, parsed_chunks_.toString());
+    LOG_DEBUG("Request %1%:\n%2%", id_,
+              Util::logPayload(parsed_chunks_.toString()));
 
     validateFormat();
 
     transaction_id_ = parsed_chunks_.data.get<std::string>("transaction_id");
+
+    if (type_ == RequestType::Batch) {
+        if (!parsed_chunks_.data.includes("actions")) {
+            throw ActionRequest::Error { "no actions" };
+        }
+
+        return;
+    }
+
     module_ = parsed_chunks_.data.get<std::string>("module");
     action_ = parsed_chunks_.data.get<std::string>("action");
 
@@ -81,10 +139,55 @@ void ActionRequest::validateFormat() {
     if (parsed_chunks_.invalid_data) {
         throw ActionRequest::Error { "invalid data" };
     }
-    // NOTE(ale): currently, we don't support ContentType::Binary
-    if (parsed_chunks_.data_type != PCPClient::ContentType::Json) {
-        throw ActionRequest::Error { "data is not in JSON format" };
+    if (parsed_chunks_.data_type == PCPClient::ContentType::Binary) {
+        parseBinaryData();
+    }
+}
+
+void ActionRequest::parseBinaryData() {
+    if (type_ == RequestType::Batch) {
+        throw ActionRequest::Error { "binary data is not supported by batch "
+                                     "requests" };
+    }
+
+    auto& binary_data = parsed_chunks_.binary_data;
+    auto header_end = binary_data.find('\n');
+
+    if (header_end == std::string::npos) {
+        throw ActionRequest::Error { "no header in binary data" };
     }
+
+    lth_jc::JsonContainer header {};
+
+    try {
+        header = lth_jc::JsonContainer { binary_data.substr(0, header_end) };
+    } catch (lth_jc::data_parse_error& e) {
+        throw ActionRequest::Error { "invalid binary data header" };
+    }
+
+    // Validate the header as the data of the JSON request
+    PCPClient::Validator validator {};
+    auto schema = (type_ == RequestType::Blocking
+                   ? PXPSchemas::BlockingRequestSchema()
+                   : PXPSchemas::NonBlockingRequestSchema());
+    auto schema_name = (type_ == RequestType::Blocking
+                        ? PXPSchemas::BLOCKING_REQUEST_TYPE
+                        : PXPSchemas::NON_BLOCKING_REQUEST_TYPE);
+    validator.registerSchema(schema);
+
+    try {
+        validator.validate(header, schema_name);
+    } catch (PCPClient::validation_error& e) {
+        throw ActionRequest::Error { std::string { "invalid binary data header: " }
+                                     + e.what() };
+    }
+
+    LOG_DEBUG("Request %1% has %2% bytes of binary data", id_,
+              binary_data.size() - header_end - 1);
+
+    // NB: the rest of the request processing relies on the data entry
+    parsed_chunks_.data = header;
+    binary_data.erase(0, header_end + 1);
 }
 
 }  // namespace PXPAgent
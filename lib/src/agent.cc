@@ -1,4 +1,5 @@
 #include <pxp-agent/agent.hpp>
+#include <pxp-agent/job_journal.hpp>
 #include <pxp-agent/pxp_schemas.hpp>
 
 #define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.agent"
@@ -14,6 +15,9 @@ Agent::Agent(const Configuration::Agent& agent_configuration)
               request_processor_ { connector_ptr_, agent_configuration } {
 } catch (PCPClient::connection_config_error& e) {
     throw Agent::Error { std::string { "failed to configure: " } + e.what() };
+} catch (JobJournal::Error& e) {
+    throw Agent::Error { std::string { "failed to open the job journal: " }
+                         + e.what() };
 }
 
 void Agent::start() {
@@ -31,6 +35,24 @@ void Agent::start() {
             nonBlockingRequestCallback(parsed_chunks);
         });
 
+    connector_ptr_->registerMessageCallback(
+        PXPSchemas::BlockingBinaryRequestSchema(),
+        [this](const PCPClient::ParsedChunks& parsed_chunks) {
+            blockingRequestCallback(parsed_chunks);
+        });
+
+    connector_ptr_->registerMessageCallback(
+        PXPSchemas::NonBlockingBinaryRequestSchema(),
+        [this](const PCPClient::ParsedChunks& parsed_chunks) {
+            nonBlockingRequestCallback(parsed_chunks);
+        });
+
+    connector_ptr_->registerMessageCallback(
+        PXPSchemas::BatchRequestSchema(),
+        [this](const PCPClient::ParsedChunks& parsed_chunks) {
+            batchRequestCallback(parsed_chunks);
+        });
+
     try {
         connector_ptr_->connect();
     } catch (PCPClient::connection_config_error& e) {
@@ -66,4 +88,9 @@ void Agent::nonBlockingRequestCallback(
     request_processor_.processRequest(RequestType::NonBlocking, parsed_chunks);
 }
 
+void Agent::batchRequestCallback(
+                const PCPClient::ParsedChunks& parsed_chunks) {
+    request_processor_.processRequest(RequestType::Batch, parsed_chunks);
+}
+
 }  // namespace PXPAgent
@@ -17,6 +17,12 @@
 
 #include <boost/nowide/iostream.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
 #ifdef _WIN32
     #include <leatherman/windows/system_error.hpp>
     #include <leatherman/windows/windows.hpp>
@@ -47,6 +53,8 @@ namespace lth_loc = leatherman::locale;
 
     static const fs::path DEFAULT_CONF_DIR { DATA_DIR / "etc" };
     const std::string DEFAULT_SPOOL_DIR { (DATA_DIR / "var" / "spool").string() };
+    static const std::string DEFAULT_FILE_TRANSFER_DIR {
+        (DATA_DIR / "var" / "transfers").string() };
     const std::string PID_DIR { (DATA_DIR / "var" / "run").string() };
     static const std::string DEFAULT_LOG_DIR { (DATA_DIR / "var" / "log").string() };
 
@@ -72,6 +80,8 @@ namespace lth_loc = leatherman::locale;
 #else
     static const fs::path DEFAULT_CONF_DIR { "/etc/puppetlabs/pxp-agent" };
     const std::string DEFAULT_SPOOL_DIR { "/opt/puppetlabs/pxp-agent/spool" };
+    static const std::string DEFAULT_FILE_TRANSFER_DIR {
+        "/opt/puppetlabs/pxp-agent/transfers" };
     const std::string PID_DIR { "/var/run/puppetlabs" };
     static const std::string DEFAULT_LOG_DIR { "/var/log/puppetlabs/pxp-agent" };
     static const std::string DEFAULT_MODULES_DIR { "/opt/puppetlabs/pxp-agent/modules" };
@@ -85,6 +95,19 @@ static const std::string DEFAULT_CONFIG_FILE {
 static const std::string AGENT_CLIENT_TYPE { "agent" };
 const std::string LOGFILE_NAME { "pxp-agent.log" };
 
+// Flags that specify a size in KiB, and their maximum value, such
+// that the size in bytes fits in a size_t
+static const std::vector<std::string> SIZE_KIB_FLAGS {
+    "response-chunk-size", "spool-compression-threshold", "max-request-size" };
+static const uintmax_t MAX_SIZE_KIB {
+    std::min<uintmax_t>(std::numeric_limits<int>::max(),
+                        std::numeric_limits<size_t>::max() / 1024) };
+
+// Return the size specified by the flag in KiB, in bytes
+static size_t getSizeFlag(const std::string& size_name) {
+    return static_cast<size_t>(HW::GetFlag<int>(size_name)) * 1024;
+}
+
 //
 // Public interface
 //
@@ -205,6 +228,49 @@ void Configuration::validateAndNormalizeConfiguration() {
         }
     }
 
+    // NB: the sizes are given in KiB and stored in bytes
+    for (const auto& size_name : SIZE_KIB_FLAGS) {
+        auto size_kib = HW::GetFlag<int>(size_name);
+
+        if (size_kib < 0) {
+            throw Configuration::Error { size_name + " must not be negative" };
+        }
+
+        if (static_cast<uintmax_t>(size_kib) > MAX_SIZE_KIB) {
+            throw Configuration::Error { size_name + " must not exceed "
+                                         + std::to_string(MAX_SIZE_KIB) };
+        }
+    }
+
+    if (HW::GetFlag<int>("rate-limit") < 0
+            || HW::GetFlag<int>("global-rate-limit") < 0) {
+        throw Configuration::Error { "rate limits must not be negative" };
+    }
+
+    if (HW::GetFlag<int>("rate-limit-burst") < 1) {
+        throw Configuration::Error { "rate-limit-burst must be positive" };
+    }
+
+    auto file_transfer_dir = HW::GetFlag<std::string>("file-transfer-dir");
+
+    if (!file_transfer_dir.empty()) {
+        file_transfer_dir = lth_file::tilde_expand(file_transfer_dir);
+
+        if (!fs::path(file_transfer_dir).is_absolute()) {
+            throw Configuration::Error { "file-transfer-dir must be an absolute "
+                                         "path: " + file_transfer_dir };
+        }
+
+        HW::SetFlag<std::string>("file-transfer-dir", file_transfer_dir);
+    }
+
+    auto spool_format = HW::GetFlag<std::string>("spool-format");
+
+    if (spool_format != "directory" && spool_format != "journal") {
+        throw Configuration::Error { "invalid spool-format '" + spool_format
+                                     + "'; must be 'directory' or 'journal'" };
+    }
+
     if (!HW::GetFlag<bool>("foreground")) {
         if (HW::GetFlag<bool>("console-logger")) {
             throw Configuration::Error { "must log to file when executing "
@@ -222,6 +288,26 @@ bool Configuration::isInitialized() const {
 }
 
 void Configuration::reopenLogfile() const {
+    if (log_stream_) {
+        // NB: the log stream reopens the logfile once the queued
+        // messages are written
+        log_stream_->reopen();
+    } else {
+        reopenLogfileStream();
+    }
+}
+
+void Configuration::startLogWriter() {
+    if (log_stream_) {
+        log_stream_->start();
+    }
+}
+
+//
+// Private interface
+//
+
+void Configuration::reopenLogfileStream() const {
     if (!logfile_.empty()) {
         try {
             logfile_fstream_.close();
@@ -236,17 +322,14 @@ void Configuration::reopenLogfile() const {
     }
 }
 
-//
-// Private interface
-//
-
 Configuration::Configuration() : initialized_ { false },
                                  defaults_ {},
                                  config_file_ { "" },
                                  start_function_ {},
                                  agent_configuration_ {},
                                  logfile_ { "" },
-                                 logfile_fstream_ {} {
+                                 logfile_fstream_ {},
+                                 log_stream_ {} {
     defineDefaultValues();
 }
 
@@ -297,6 +380,37 @@ void Configuration::defineDefaultValues() {
                                Types::String,
                                "info"))));
 
+    defaults_.insert(std::pair<std::string, Base_ptr>("log-format", Base_ptr(
+        new Entry<std::string>("log-format",
+                               "",
+                               "Format of the log messages, 'text' or 'json'; "
+                               "defaults to 'text'",
+                               Types::String,
+                               "text"))));
+
+    defaults_.insert(std::pair<std::string, Base_ptr>("log-rotate-size", Base_ptr(
+        new Entry<int>("log-rotate-size",
+                       "",
+                       "The logfile is rotated once larger than this size "
+                       "[MiB], default: 0 (disabled)",
+                       Types::Integer,
+                       0))));
+
+    defaults_.insert(std::pair<std::string, Base_ptr>("log-rotate-interval", Base_ptr(
+        new Entry<int>("log-rotate-interval",
+                       "",
+                       "The logfile is rotated at this interval [hours], "
+                       "default: 0 (disabled)",
+                       Types::Integer,
+                       0))));
+
+    defaults_.insert(std::pair<std::string, Base_ptr>("log-rotate-count", Base_ptr(
+        new Entry<int>("log-rotate-count",
+                       "",
+                       "Number of rotated logfiles to keep, default: 5",
+                       Types::Integer,
+                       5))));
+
     defaults_.insert(std::pair<std::string, Base_ptr>("console-logger", Base_ptr(
         new Entry<bool>("console-logger",
                         "",
@@ -320,6 +434,15 @@ void Configuration::defineDefaultValues() {
                                Types::String,
                                DEFAULT_SPOOL_DIR))));
 
+    defaults_.insert(std::pair<std::string, Base_ptr>("file-transfer-dir", Base_ptr(
+        new Entry<std::string>("file-transfer-dir",
+                               "",
+                               { "Directory the file_transfer module writes "
+                                 "files to, empty to disable transfers, "
+                                 "default: " + DEFAULT_FILE_TRANSFER_DIR },
+                               Types::String,
+                               DEFAULT_FILE_TRANSFER_DIR))));
+
     defaults_.insert(std::pair<std::string, Base_ptr>("modules-config-dir", Base_ptr(
         new Entry<std::string>("modules-config-dir",
                                "",
@@ -339,6 +462,72 @@ void Configuration::defineDefaultValues() {
                                Types::String,
                                DEFAULT_MODULES_DIR))));
 
+    defaults_.insert(std::pair<std::string, Base_ptr>("response-chunk-size", Base_ptr(
+        new Entry<int>("response-chunk-size",
+                       "",
+                       "Results larger than this size [KiB] are sent in chunks, "
+                       "default: 0 (disabled)",
+                       Types::Integer,
+                       0))));
+
+    defaults_.insert(std::pair<std::string, Base_ptr>("spool-compression-threshold", Base_ptr(
+        new Entry<int>("spool-compression-threshold",
+                       "",
+                       "Output files of non-blocking actions larger than this "
+                       "size [KiB] are compressed, default: 0 (disabled)",
+                       Types::Integer,
+                       0))));
+
+    defaults_.insert(std::pair<std::string, Base_ptr>("spool-format", Base_ptr(
+        new Entry<std::string>("spool-format",
+                               "",
+                               "How the results of completed non-blocking actions "
+                               "are stored in the spool directory, 'directory' "
+                               "(one per transaction) or 'journal', default: "
+                               "directory",
+                               Types::String,
+                               "directory"))));
+
+    defaults_.insert(std::pair<std::string, Base_ptr>("spool-sync", Base_ptr(
+        new Entry<bool>("spool-sync",
+                        "",
+                        "Sync the spool files of non-blocking actions to disk "
+                        "when they are written, default: false",
+                        Types::Bool,
+                        false))));
+
+    defaults_.insert(std::pair<std::string, Base_ptr>("rate-limit", Base_ptr(
+        new Entry<int>("rate-limit",
+                       "",
+                       "Maximum number of requests per minute accepted from "
+                       "each sender, default: 0 (disabled)",
+                       Types::Integer,
+                       0))));
+
+    defaults_.insert(std::pair<std::string, Base_ptr>("global-rate-limit", Base_ptr(
+        new Entry<int>("global-rate-limit",
+                       "",
+                       "Maximum number of requests per minute accepted from "
+                       "all senders, default: 0 (disabled)",
+                       Types::Integer,
+                       0))));
+
+    defaults_.insert(std::pair<std::string, Base_ptr>("rate-limit-burst", Base_ptr(
+        new Entry<int>("rate-limit-burst",
+                       "",
+                       "Number of requests accepted at once beyond the rate "
+                       "limits, default: 10",
+                       Types::Integer,
+                       10))));
+
+    defaults_.insert(std::pair<std::string, Base_ptr>("max-request-size", Base_ptr(
+        new Entry<int>("max-request-size",
+                       "",
+                       "Requests with data (binary data plus params) larger "
+                       "than this size [KiB] are rejected, default: 0 (no limit)",
+                       Types::Integer,
+                       0))));
+
     defaults_.insert(std::pair<std::string, Base_ptr>("foreground", Base_ptr(
         new Entry<bool>("foreground",
                         "",
@@ -487,8 +676,13 @@ static void validateLogDirPath(fs::path logdir_path) {
 void Configuration::setupLogging() {
     auto console_logger = HW::GetFlag<bool>("console-logger");
     auto loglevel = HW::GetFlag<std::string>("loglevel");
+    auto log_format = HW::GetFlag<std::string>("log-format");
     std::ostream *stream = nullptr;
 
+    if (log_format != "text" && log_format != "json") {
+        throw Configuration::Error { "invalid log format: '" + log_format + "'" };
+    }
+
     if (!console_logger) {
         // We should log on file
         auto logdir = HW::GetFlag<std::string>("logdir");
@@ -504,9 +698,35 @@ void Configuration::setupLogging() {
         // up logging before calling validateAndNormalizeConfiguration
         validateLogDirPath(logdir_path);
 
+        auto rotate_size = HW::GetFlag<int>("log-rotate-size");
+        auto rotate_interval = HW::GetFlag<int>("log-rotate-interval");
+        auto rotate_count = HW::GetFlag<int>("log-rotate-count");
+
+        if (rotate_size < 0 || rotate_interval < 0 || rotate_count < 0) {
+            throw Configuration::Error { "log rotation options must not be "
+                                         "negative" };
+        }
+
         logfile_ = (logdir_path / LOGFILE_NAME).string();
         logfile_fstream_.open(logfile_.c_str(), std::ios_base::app);
-        stream = &logfile_fstream_;
+        log_stream_.reset(new Util::AsyncLogStream {
+            logfile_fstream_, [this]() { reopenLogfileStream(); } });
+
+        if (rotate_size > 0 || rotate_interval > 0) {
+            boost::system::error_code ec {};
+            auto logfile_size = fs::file_size(logfile_, ec);
+            log_stream_->setRotation(
+                [this, rotate_count]() {
+                    logfile_fstream_.close();
+                    Util::rotateFiles(logfile_, rotate_count);
+                    reopenLogfileStream();
+                },
+                static_cast<size_t>(rotate_size) * 1024 * 1024,
+                std::chrono::hours(rotate_interval),
+                (ec ? 0 : static_cast<size_t>(logfile_size)));
+        }
+
+        stream = log_stream_.get();
     } else {
         // Log on stdout by default
         stream = &boost::nowide::cout;
@@ -534,6 +754,12 @@ void Configuration::setupLogging() {
     lth_log::setup_logging(*stream);
     lth_log::set_level(lvl);
 
+    if (log_format == "json") {
+        Util::setupJsonLogging(*stream);
+    } else {
+        Util::resetJsonLogging();
+    }
+
 #ifdef DEV_LOG_COLOR
     // Enable colorozation anyway (development setting - it helps
     // debugging PXP message workflow, but it will add useless shell
@@ -564,7 +790,16 @@ void Configuration::setAgentConfiguration() {
         HW::GetFlag<std::string>("key"),
         HW::GetFlag<std::string>("spool-dir"),
         HW::GetFlag<std::string>("modules-config-dir"),
-        AGENT_CLIENT_TYPE };
+        AGENT_CLIENT_TYPE,
+        getSizeFlag("response-chunk-size"),
+        getSizeFlag("spool-compression-threshold"),
+        HW::GetFlag<int>("rate-limit"),
+        HW::GetFlag<int>("global-rate-limit"),
+        HW::GetFlag<int>("rate-limit-burst"),
+        getSizeFlag("max-request-size"),
+        HW::GetFlag<bool>("spool-sync"),
+        HW::GetFlag<std::string>("spool-format"),
+        HW::GetFlag<std::string>("file-transfer-dir") };
 }
 
 }  // namespace PXPAgent
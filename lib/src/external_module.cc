@@ -1,13 +1,21 @@
 #include <pxp-agent/external_module.hpp>
+#include <pxp-agent/results_storage.hpp>
+#include <pxp-agent/util/logging.hpp>
 
 #define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.external_module"
 #include <leatherman/logging/logging.hpp>
 #include <leatherman/execution/execution.hpp>
+#include <leatherman/file_util/file.hpp>
 
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 
 #include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <climits>  // INT_MAX
+#include <fstream>
+#include <map>
 #include <memory>  // shared_ptr
 
 // TODO(ale): disable assert() once we're confident with the code...
@@ -24,7 +32,23 @@ static const std::string ACTION_SCHEMA_NAME { "action_metadata" };
 static const std::string METADATA_CONFIGURATION_ENTRY { "configuration" };
 static const std::string METADATA_ACTIONS_ENTRY { "actions" };
 
+static const std::string CONFIGURATION_LIMITS_ENTRY { "limits" };
+static const std::string CONFIGURATION_ENVIRONMENT_ENTRY { "environment" };
+static const std::string CONFIGURATION_INHERIT_ENVIRONMENT_ENTRY { "inherit_environment" };
+static const std::string CONFIGURATION_PRELOAD_ENTRY { "preload" };
+
+// Action name of the preloader command
+static const std::string PRELOAD_ACTION { "preload" };
+
+// Minimum time between attempts to start a preloader [s]
+static const int PRELOADER_RETRY_INTERVAL_S { 60 };
+
+// Default maximum sizes of the action stdout and stderr [KiB]
+static const int DEFAULT_MAX_STDOUT_KB { 16 * 1024 };
+static const int DEFAULT_MAX_STDERR_KB { 1024 };
+
 namespace lth_exec = leatherman::execution;
+namespace lth_file = leatherman::file_util;
 
 //
 // Free functions
@@ -61,31 +85,36 @@ PCPClient::Validator getMetadataValidator() {
 ExternalModule::ExternalModule(const std::string& path,
                                const lth_jc::JsonContainer& config)
         : path_ { path },
-          config_ { config } {
+          config_ { config },
+          max_stdout_size_ { DEFAULT_MAX_STDOUT_KB * 1024u },
+          max_stderr_size_ { DEFAULT_MAX_STDERR_KB * 1024u } {
     boost::filesystem::path module_path { path };
     module_name = module_path.filename().string();
-    auto metadata = getMetadata();
-
-    try {
-        if (metadata.includes(METADATA_CONFIGURATION_ENTRY)) {
-            registerConfiguration(
-                metadata.get<lth_jc::JsonContainer>(METADATA_CONFIGURATION_ENTRY));
-        } else {
-            LOG_DEBUG("Found no configuration schema for module '%1%'", module_name);
-        }
+    registerMetadata(getMetadata());
+#ifndef _WIN32
+    registerPreloader();
+#endif
+}
 
-        registerActions(metadata);
-    } catch (lth_jc::data_error& e) {
-        LOG_ERROR("Failed to retrieve metadata of module %1%: %2%",
-                  module_name, e.what());
-        std::string err { "invalid metadata of module " + module_name };
-        throw Module::LoadingError { err };
-    }
+ExternalModule::ExternalModule(const std::string& path,
+                               const lth_jc::JsonContainer& config,
+                               const lth_jc::JsonContainer& metadata)
+        : path_ { path },
+          config_ { config },
+          max_stdout_size_ { DEFAULT_MAX_STDOUT_KB * 1024u },
+          max_stderr_size_ { DEFAULT_MAX_STDERR_KB * 1024u } {
+    // NB: the module name is the file name without extension
+    boost::filesystem::path module_path { path };
+    module_name = module_path.stem().string();
+    validateMetadata(metadata);
+    registerMetadata(metadata);
 }
 
 ExternalModule::ExternalModule(const std::string& path)
         : path_ { path },
-          config_ { "{}" } {
+          config_ { "{}" },
+          max_stdout_size_ { DEFAULT_MAX_STDOUT_KB * 1024u },
+          max_stderr_size_ { DEFAULT_MAX_STDERR_KB * 1024u } {
     boost::filesystem::path module_path { path };
     module_name = module_path.filename().string();
     auto metadata = getMetadata();
@@ -146,7 +175,12 @@ const lth_jc::JsonContainer ExternalModule::getMetadata() {
     }
 
     lth_jc::JsonContainer metadata { exec.output };
+    validateMetadata(metadata);
+
+    return metadata;
+}
 
+void ExternalModule::validateMetadata(const lth_jc::JsonContainer& metadata) {
     try {
         metadata_validator_.validate(metadata, METADATA_SCHEMA_NAME);
         LOG_INFO("External module %1%: metadata validation OK", module_name);
@@ -154,8 +188,29 @@ const lth_jc::JsonContainer ExternalModule::getMetadata() {
         throw Module::LoadingError { std::string { "metadata validation failure: " }
                                      + e.what() };
     }
+}
 
-    return metadata;
+void ExternalModule::registerMetadata(const lth_jc::JsonContainer& metadata) {
+    try {
+        if (metadata.includes(METADATA_CONFIGURATION_ENTRY)) {
+            registerConfiguration(
+                metadata.get<lth_jc::JsonContainer>(METADATA_CONFIGURATION_ENTRY));
+        } else {
+            LOG_DEBUG("Found no configuration schema for module '%1%'", module_name);
+        }
+
+        registerActions(metadata);
+    } catch (lth_jc::data_error& e) {
+        LOG_ERROR("Failed to retrieve metadata of module %1%: %2%",
+                  module_name, e.what());
+        std::string err { "invalid metadata of module " + module_name };
+        throw Module::LoadingError { err };
+    }
+
+    registerLimits();
+#ifndef _WIN32
+    registerEnvironment();
+#endif
 }
 
 void ExternalModule::registerConfiguration(const lth_jc::JsonContainer& config_metadata) {
@@ -171,6 +226,87 @@ void ExternalModule::registerConfiguration(const lth_jc::JsonContainer& config_m
     }
 }
 
+static const std::map<std::string, int> IONICE_CLASSES {
+    { "realtime", 1 },
+    { "best-effort", 2 },
+    { "idle", 3 } };
+
+void ExternalModule::registerLimits() {
+    if (!config_.includes(CONFIGURATION_LIMITS_ENTRY)) {
+        return;
+    }
+
+    auto invalid = [this](const std::string& reason) {
+        LOG_ERROR("Invalid limits for module '%1%': %2%", module_name, reason);
+        return Module::LoadingError { "invalid limits of module " + module_name
+                                      + ": " + reason };
+    };
+
+    try {
+        auto limits = config_.get<lth_jc::JsonContainer>(CONFIGURATION_LIMITS_ENTRY);
+
+        auto getLimit = [&](const std::string& key, int min, int max, int& value) {
+            if (limits.includes(key)) {
+                value = limits.get<int>(key);
+
+                if (value < min || value > max) {
+                    throw invalid(key + " must be in [" + std::to_string(min)
+                                  + ", " + std::to_string(max) + "]");
+                }
+            }
+        };
+
+        int max_stdout_kb { DEFAULT_MAX_STDOUT_KB };
+        int max_stderr_kb { DEFAULT_MAX_STDERR_KB };
+        getLimit("max_stdout_kb", 0, INT_MAX / 1024, max_stdout_kb);
+        getLimit("max_stderr_kb", 0, INT_MAX / 1024, max_stderr_kb);
+        max_stdout_size_ = max_stdout_kb * 1024u;
+        max_stderr_size_ = max_stderr_kb * 1024u;
+
+#ifndef _WIN32
+        getLimit("cpu_seconds", 0, INT_MAX, limits_.cpu_seconds);
+        getLimit("memory_mb", 0, INT_MAX, limits_.memory_mb);
+        getLimit("open_files", 0, INT_MAX, limits_.open_files);
+        getLimit("nice", -20, 19, limits_.nice);
+
+        if (limits.includes("ionice_class")) {
+            auto io_class = limits.get<std::string>("ionice_class");
+            auto class_itr = IONICE_CLASSES.find(io_class);
+
+            if (class_itr == IONICE_CLASSES.end()) {
+                throw invalid("unknown ionice_class '" + io_class + "'");
+            }
+
+            limits_.ionice_class = class_itr->second;
+            getLimit("ionice_level", 0, 7, limits_.ionice_level);
+        }
+
+        if (limits.includes("cgroup")) {
+            limits_.cgroup = limits.get<std::string>("cgroup");
+
+            if (!boost::filesystem::is_directory(limits_.cgroup)) {
+                throw invalid("cgroup '" + limits_.cgroup + "' does not exist");
+            }
+        }
+
+        if (!limits_.empty()) {
+            LOG_INFO("Resource limits will be applied to the actions of module "
+                     "'%1%'", module_name);
+        }
+#else
+        for (auto& key : limits.keys()) {
+            if (key != "max_stdout_kb" && key != "max_stderr_kb") {
+                LOG_WARNING("Resource limits are not supported on Windows; the "
+                            "'%1%' limit of module '%2%' will be ignored",
+                            key, module_name);
+            }
+        }
+#endif
+    } catch (lth_jc::data_error& e) {
+        throw invalid(e.what());
+    }
+}
+
 void ExternalModule::registerActions(const lth_jc::JsonContainer& metadata) {
     for (auto& action : metadata.get<std::vector<lth_jc::JsonContainer>>(
                                     METADATA_ACTIONS_ENTRY)) {
@@ -213,68 +349,450 @@ void ExternalModule::registerAction(const lth_jc::JsonContainer& action) {
 }
 
 
-ActionOutcome ExternalModule::callAction(const ActionRequest& request) {
-    auto& action_name = request.action();
+#ifndef _WIN32
 
-    lth_jc::JsonContainer request_input {};
-    request_input.set<lth_jc::JsonContainer>("params", request.params());
-    request_input.set<lth_jc::JsonContainer>("config", config_);
-    auto request_input_txt = request_input.toString();
+void ExternalModule::registerEnvironment() {
+    auto inherit = true;
+    std::map<std::string, std::string> variables {};
+
+    try {
+        if (config_.includes(CONFIGURATION_INHERIT_ENVIRONMENT_ENTRY)) {
+            inherit = config_.get<bool>(CONFIGURATION_INHERIT_ENVIRONMENT_ENTRY);
+        }
 
-    LOG_INFO("About to execute '%1% %2%' - request input: %3%",
-             module_name, action_name, request_input_txt);
+        if (config_.includes(CONFIGURATION_ENVIRONMENT_ENTRY)) {
+            auto environment =
+                config_.get<lth_jc::JsonContainer>(CONFIGURATION_ENVIRONMENT_ENTRY);
 
-    lth_exec::result exec { false, "", "", 0 };
+            for (auto& name : environment.keys()) {
+                if (name.empty() || name.find('=') != std::string::npos) {
+                    throw Module::LoadingError { "invalid environment variable "
+                                                 "name '" + name + "' for module "
+                                                 + module_name };
+                }
+
+                variables[name] = environment.get<std::string>(name);
+            }
+        }
+    } catch (lth_jc::data_error& e) {
+        throw Module::LoadingError { "invalid environment of module "
+                                     + module_name + ": " + e.what() };
+    }
+
+    if (inherit && variables.empty()) {
+        return;
+    }
+
+    environment_.reset(new Util::Environment {
+        Util::Environment::build(variables, inherit) });
+    LOG_DEBUG("Module '%1%' actions will be executed with %2% environment "
+              "variables", module_name, environment_->entries().size());
+}
+
+void ExternalModule::registerPreloader() {
+    try {
+        if (config_.includes(CONFIGURATION_PRELOAD_ENTRY)) {
+            preload_ = config_.get<bool>(CONFIGURATION_PRELOAD_ENTRY);
+        }
+    } catch (lth_jc::data_error& e) {
+        throw Module::LoadingError { "invalid preload entry of module "
+                                     + module_name + ": " + e.what() };
+    }
+
+    // NB: the preloader is started by the first action, so that
+    // modules that are reloaded before being used don't start one
+}
+
+std::shared_ptr<Util::Preloader> ExternalModule::getPreloader() {
+    if (!preload_) {
+        return nullptr;
+    }
+
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock {
+        preloader_mutex_ };
+
+    if (preloader_ && !preloader_->running()) {
+        LOG_WARNING("The preloader of module '%1%' terminated; restarting it",
+                    module_name);
+        preloader_.reset();
+    }
 
+    if (!preloader_ && std::chrono::steady_clock::now() >= preloader_retry_time_) {
+        std::string file {};
+        std::vector<std::string> arguments {};
+        getCommand(PRELOAD_ACTION, file, arguments);
+
+        try {
+            preloader_ = std::make_shared<Util::Preloader>(file, arguments, limits_,
+                                                           environment_.get());
+            LOG_INFO("Started the preloader of module '%1%' with PID %2%",
+                     module_name, preloader_->pid());
+        } catch (const Util::process_error& e) {
+            LOG_WARNING("Failed to start the preloader of module '%1%' (%2%); "
+                        "its actions will be executed without preloading",
+                        module_name, e.what());
+            preloader_retry_time_ = std::chrono::steady_clock::now()
+                                    + std::chrono::seconds(PRELOADER_RETRY_INTERVAL_S);
+        }
+    }
+
+    return preloader_;
+}
+
+void ExternalModule::discardPreloader(const std::shared_ptr<Util::Preloader>& preloader,
+                                      const std::string& reason) {
+    LOG_WARNING("The preloader of module '%1%' failed (%2%); it will be "
+                "restarted", module_name, reason);
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock {
+        preloader_mutex_ };
+
+    if (preloader_ == preloader) {
+        preloader_.reset();
+    }
+}
+
+static lth_jc::JsonContainer getUsageJson(const Util::ResourceUsage& usage) {
+    lth_jc::JsonContainer usage_json {};
+    usage_json.set<double>("wall_time_s", usage.wall_time_s);
+    usage_json.set<double>("user_cpu_s", usage.user_cpu_s);
+    usage_json.set<double>("system_cpu_s", usage.system_cpu_s);
+    usage_json.set<int>("max_rss_kb", static_cast<int>(usage.max_rss_kb));
+    usage_json.set<int>("read_blocks", static_cast<int>(usage.read_blocks));
+    usage_json.set<int>("written_blocks", static_cast<int>(usage.written_blocks));
+    return usage_json;
+}
+
+#endif  // _WIN32
+
+void ExternalModule::getCommand(const std::string& action_name,
+                                std::string& file,
+                                std::vector<std::string>& arguments) {
     if (config_.includes("interpreter")) {
-        std::string interpreter { config_.get<std::string>("interpreter") };
+        file = config_.get<std::string>("interpreter");
         LOG_DEBUG("Found 'interpreter' field with value '%1%' in module '%2%' config'",
-                  interpreter, module_name);
-        exec = lth_exec::execute(interpreter,
-                                 {path_, action_name}, request_input_txt, 0,
-                                 {lth_exec::execution_options::merge_environment});
+                  file, module_name);
+        arguments = { path_, action_name };
     } else {
-        exec =
 #ifdef _WIN32
-            lth_exec::execute("cmd.exe", { "/c", path_, action_name },
+        file = "cmd.exe";
+        arguments = { "/c", path_, action_name };
 #else
-            lth_exec::execute(path_, { action_name },
+        file = path_;
+        arguments = { action_name };
 #endif
-            request_input_txt, 0, {lth_exec::execution_options::merge_environment});
     }
+}
 
-    if (exec.output.empty()) {
-        LOG_DEBUG("'%1% %2%' produced no output", module_name, action_name);
+ExternalModule::BinaryDataFile::BinaryDataFile(const ActionRequest& request)
+        : path_ {} {
+    namespace fs = boost::filesystem;
+
+    // NB: the results directory is used for non-blocking actions
+    // so that the data file is kept together with the job files
+    fs::path dir { request.resultsDir() };
+    if (dir.empty()) {
+        dir = fs::temp_directory_path();
+    }
+    path_ = (dir / fs::unique_path("pxp-binary-data-%%%%-%%%%-%%%%")).string();
+
+    std::ofstream data_stream { path_, std::ios::binary };
+
+    if (data_stream) {
+        fs::permissions(path_, fs::owner_read | fs::owner_write);
+        data_stream.write(request.binaryData().data(),
+                          request.binaryData().size());
+    }
+
+    if (!data_stream) {
+        throw Module::ProcessingError { "failed to write the binary data "
+                                        "file " + path_ };
+    }
+}
+
+ExternalModule::BinaryDataFile::~BinaryDataFile() {
+    boost::system::error_code ec;
+    boost::filesystem::remove(path_, ec);
+}
+
+std::string ExternalModule::getActionInput(
+        const ActionRequest& request,
+        std::unique_ptr<BinaryDataFile>& binary_data_file) {
+    lth_jc::JsonContainer request_input {};
+    request_input.set<lth_jc::JsonContainer>("config", config_);
+
+    // The binary data of the request is passed by file, so that it
+    // doesn't have to be encoded in the JSON input
+    if (!request.binaryData().empty()) {
+        binary_data_file.reset(new BinaryDataFile { request });
+        request_input.set<std::string>("binary_data_file", binary_data_file->path());
+    }
+
+    // Non-blocking actions may report their progress, that is
+    // returned by status queries while they run
+    if (!request.resultsDir().empty()) {
+        request_input.set<std::string>("progress_file",
+            request.resultsDir() + "/" + ResultsStorage::PROGRESS_FILE);
+    }
+
+    // NB: the params text is serialized once and cached by the request,
+    // that measures it to enforce the maximum request size; it's
+    // prepended to the other entries of the input object
+    auto input_txt = request_input.toString();
+    return "{\"params\":" + request.paramsTxt() + "," + input_txt.substr(1);
+}
+
+void ExternalModule::storeOutput(const ActionRequest& request,
+                                 const std::string& output,
+                                 const std::string& error) {
+    auto& results_dir = request.resultsDir();
+
+    if (!results_dir.empty()) {
+        lth_file::atomic_write_to_file(output,
+            results_dir + "/" + ResultsStorage::STDOUT_FILE);
+        lth_file::atomic_write_to_file(error,
+            results_dir + "/" + ResultsStorage::STDERR_FILE);
+    }
+}
+
+ActionOutcome ExternalModule::callAction(const ActionRequest& request) {
+    auto& action_name = request.action();
+    Util::LogContextScope log_context { request.id(), request.transactionId(),
+                                        request.sender(), module_name,
+                                        action_name };
+    Util::LogEventScope log_event { LEATHERMAN_LOGGING_NAMESPACE,
+                                    "executed action" };
+
+    std::unique_ptr<BinaryDataFile> binary_data_file {};
+    auto request_input_txt = getActionInput(request, binary_data_file);
+
+    LOG_INFO("About to execute '%1% %2%'", module_name, action_name);
+    LOG_DEBUG("'%1% %2%' request input: %3%", module_name, action_name,
+              Util::logPayload(request_input_txt));
+
+    std::string file {};
+    std::vector<std::string> arguments {};
+    getCommand(action_name, file, arguments);
+
+#ifndef _WIN32
+    auto preloader = getPreloader();
+
+    if (!request.resultsDir().empty()) {
+        return callNonBlockingAction(request, file, arguments, request_input_txt,
+                                     preloader);
+    }
+
+    // NB: one byte more than the maximum is collected, so that
+    // processOutput() can detect oversized output
+    auto max_output_size = max_stdout_size_ ? max_stdout_size_ + 1 : 0;
+    auto max_error_size = max_stderr_size_ ? max_stderr_size_ + 1 : 0;
+    Util::ExecutionResult exec {};
+
+    if (preloader) {
+        try {
+            exec = Util::execute(*preloader, action_name, request_input_txt,
+                                 max_output_size, max_error_size);
+        } catch (const Util::process_error& e) {
+            discardPreloader(preloader, e.what());
+            throw;
+        }
     } else {
-        LOG_DEBUG("'%1% %2%' output: %3%", module_name, action_name, exec.output);
+        exec = Util::execute(file, arguments, request_input_txt, limits_,
+                             max_output_size, max_error_size, environment_.get());
     }
 
-    if (exec.exit_code) {
+    LOG_DEBUG("'%1% %2%' resource usage: %3%", module_name, action_name,
+              getUsageJson(exec.usage).toString());
+
+    return processOutput(action_name, exec.exitcode, exec.output, exec.error,
+                         exec.limit_exceeded);
+#else
+    auto exec = lth_exec::execute(file, arguments, request_input_txt, 0,
+                                  {lth_exec::execution_options::merge_environment});
+
+    if (!request.resultsDir().empty()) {
+        // Non-blocking request; store the output in the results dir
+        auto& results_dir = request.resultsDir();
+        lth_file::atomic_write_to_file(exec.output + "\n",
+            results_dir + "/" + ResultsStorage::STDOUT_FILE);
         if (!exec.error.empty()) {
+            lth_file::atomic_write_to_file(exec.error + "\n",
+                results_dir + "/" + ResultsStorage::STDERR_FILE);
+        }
+    }
+
+    return processOutput(action_name, exec.exit_code, exec.output, exec.error);
+#endif
+}
+
+#ifndef _WIN32
+
+// Read up to max_size bytes of the specified file (all of it if
+// max_size is zero)
+static void readFilePrefix(const std::string& path,
+                           size_t max_size,
+                           std::string& content) {
+    if (max_size == 0) {
+        lth_file::read(path, content);
+        return;
+    }
+
+    std::ifstream file_stream { path, std::ios::binary };
+    content.resize(max_size);
+    file_stream.read(&content[0], max_size);
+    content.resize(file_stream.gcount());
+}
+
+// Execute the action in a wrapped process that stores its output and
+// exit code in the results directory, so that the job outcome can be
+// retrieved even if pxp-agent is restarted meanwhile; the PID of the
+// process is stored there as well.
+ActionOutcome ExternalModule::callNonBlockingAction(
+                                const ActionRequest& request,
+                                const std::string& file,
+                                const std::vector<std::string>& arguments,
+                                const std::string& input_txt,
+                                const std::shared_ptr<Util::Preloader>& preloader) {
+    auto& results_dir = request.resultsDir();
+    auto out_path = results_dir + "/" + ResultsStorage::STDOUT_FILE;
+    auto err_path = results_dir + "/" + ResultsStorage::STDERR_FILE;
+
+    auto oom_kills_before = Util::getCgroupOOMKills(limits_.cgroup);
+    auto start = std::chrono::steady_clock::now();
+    auto exitcode_path = results_dir + "/" + ResultsStorage::EXITCODE_FILE;
+    pid_t pid;
+
+    // NB: the output files are capped while the process runs, so that
+    // a runaway job can't fill the spool; one byte more than the
+    // maximum is stored, so that oversized output can be detected
+    auto max_output_size = max_stdout_size_ ? max_stdout_size_ + 1 : 0;
+    auto max_error_size = max_stderr_size_ ? max_stderr_size_ + 1 : 0;
+
+    if (preloader) {
+        try {
+            pid = Util::spawnWrapped(*preloader, request.action(), input_txt,
+                                     out_path, err_path, exitcode_path,
+                                     max_output_size, max_error_size);
+        } catch (const Util::process_error& e) {
+            discardPreloader(preloader, e.what());
+            throw;
+        }
+    } else {
+        pid = Util::spawnWrapped(file, arguments, input_txt, out_path, err_path,
+                                 exitcode_path, limits_, environment_.get(),
+                                 max_output_size, max_error_size);
+    }
+
+    ResultsStorage::writeProcessInfo(results_dir, pid,
+                                     Util::getProcessStartTime(pid));
+    LOG_DEBUG("'%1% %2%' job for transaction %3% is executing with PID %4%",
+              module_name, request.action(), request.transactionId(), pid);
+
+    Util::ResourceUsage usage {};
+    auto exitcode = Util::waitForProcess(pid, usage);
+    usage.wall_time_s = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    ResultsStorage::writeResourceUsage(results_dir, getUsageJson(usage));
+
+    // Cap the files in the results directory to the maximum sizes,
+    // so that oversized output won't be loaded by status queries
+    std::string output {};
+    std::string error {};
+    readFilePrefix(out_path, max_output_size, output);
+    readFilePrefix(err_path, max_error_size, error);
+    auto limit_exceeded = Util::getExceededLimit(limits_, exitcode, oom_kills_before);
+
+    if (max_stdout_size_ && output.size() > max_stdout_size_) {
+        boost::filesystem::resize_file(out_path, max_stdout_size_);
+
+        if (limit_exceeded.empty()) {
+            limit_exceeded = Util::OUTPUT_SIZE_LIMIT;
+        }
+    }
+
+    if (truncateError(error)) {
+        lth_file::atomic_write_to_file(error, err_path);
+    }
+
+    return processOutput(request.action(), exitcode, output, error,
+                         limit_exceeded);
+}
+
+#endif  // _WIN32
+
+bool ExternalModule::truncateError(std::string& error) {
+    if (max_stderr_size_ == 0 || error.size() <= max_stderr_size_) {
+        return false;
+    }
+
+    std::string marker { "\n[truncated by pxp-agent: stderr exceeded "
+                         + std::to_string(max_stderr_size_) + " bytes]\n" };
+    error.resize(max_stderr_size_ - std::min(marker.size(), max_stderr_size_));
+    error += marker;
+    return true;
+}
+
+ActionOutcome ExternalModule::processOutput(const std::string& action_name,
+                                            int exitcode,
+                                            std::string& output,
+                                            std::string& error,
+                                            const std::string& limit_exceeded) {
+    if (!limit_exceeded.empty()) {
+        LOG_ERROR("'%1% %2%' was terminated for exceeding the %3% limit "
+                  "(exit code %4%)", module_name, action_name, limit_exceeded,
+                  exitcode);
+        throw Module::ResourceLimitError {
+            "'" + module_name + " " + action_name + "' exceeded the "
+            + limit_exceeded + " limit", limit_exceeded };
+    }
+
+    if (truncateError(error)) {
+        LOG_WARNING("The stderr of '%1% %2%' exceeded %3% bytes and was truncated",
+                    module_name, action_name, max_stderr_size_);
+    }
+
+    if (max_stdout_size_ && output.size() > max_stdout_size_) {
+        LOG_ERROR("The output of '%1% %2%' exceeded the maximum size of %3% bytes",
+                  module_name, action_name, max_stdout_size_);
+        throw Module::ProcessingError {
+            "'" + module_name + " " + action_name + "' output exceeded the "
+            "maximum size of " + std::to_string(max_stdout_size_) + " bytes" };
+    }
+
+    if (output.empty()) {
+        LOG_DEBUG("'%1% %2%' produced no output", module_name, action_name);
+    } else {
+        LOG_DEBUG("'%1% %2%' output: %3%", module_name, action_name,
+                  Util::logPayload(output));
+    }
+
+    if (exitcode) {
+        if (!error.empty()) {
             LOG_ERROR("'%1% %2%' failure, returned %3%; error: %4%",
-                      module_name, action_name, exec.exit_code, exec.error);
+                      module_name, action_name, exitcode,
+                      Util::logPayload(error));
         } else {
             LOG_ERROR("'%1% %2%' failure, returned %3%",
-                      module_name, action_name, exec.exit_code);
+                      module_name, action_name, exitcode);
         }
-    } else if (!exec.error.empty()) {
-        LOG_WARNING("'%1% %2%' error: %3%", module_name, action_name, exec.error);
+    } else if (!error.empty()) {
+        LOG_WARNING("'%1% %2%' error: %3%", module_name, action_name,
+                    Util::logPayload(error));
     }
 
     // Ensure output format is valid JSON by instantiating JsonContainer
     lth_jc::JsonContainer results {};
 
     try {
-        results = lth_jc::JsonContainer { exec.output };
+        results = lth_jc::JsonContainer { output };
     } catch (lth_jc::data_parse_error& e) {
         LOG_ERROR("'%1% %2%' output is not valid JSON: %3%",
                   module_name, action_name, e.what());
         std::string err_msg { "'" + module_name + " " + action_name + "' "
-                              "returned invalid JSON - stderr: " + exec.error };
+                              "returned invalid JSON - stderr: " + error };
         throw Module::ProcessingError { err_msg };
     }
 
-    return ActionOutcome { exec.exit_code, exec.error, exec.output, results };
+    return ActionOutcome { exitcode, error, output, results };
 }
 
 }  // namespace PXPAgent
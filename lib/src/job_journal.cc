@@ -0,0 +1,767 @@
+#include <pxp-agent/job_journal.hpp>
+#include <pxp-agent/results_storage.hpp>
+
+#ifndef _WIN32
+#include <pxp-agent/util/posix/group_commit.hpp>
+#endif
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.job_journal"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cctype>       // isdigit()
+#include <cerrno>
+#include <functional>
+#include <map>
+#include <set>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/file.h>   // flock()
+#include <fcntl.h>      // open() flags
+#include <unistd.h>     // fsync(), fdatasync(), close()
+#endif
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_util = PCPClient::Util;
+
+const std::string JobJournal::DIRECTORY_NAME { "journal" };
+const size_t JobJournal::DEFAULT_SEGMENT_SIZE { 64 * 1024 * 1024 };
+
+static const std::string SEGMENT_SUFFIX { ".log" };
+static const std::string INDEX_FILE { "index" };
+static const std::string LOCK_FILE { "lock" };
+
+// Sync the files to disk; it does nothing on Windows.
+// Throw a JobJournal::Error in case of failure.
+static void syncPaths(const std::vector<std::string>& paths) {
+#ifndef _WIN32
+    try {
+        Util::syncFiles(paths);
+    } catch (const Util::commit_error& e) {
+        throw JobJournal::Error { std::string { "failed to sync the journal: " }
+                                  + e.what() };
+    }
+#endif
+}
+
+// Sync the data of the file to disk, with fdatasync() on Linux, as
+// its metadata other than the size is not needed; it does nothing on
+// Windows.
+// Throw a JobJournal::Error in case of failure.
+static void syncData(const std::string& path) {
+#ifndef _WIN32
+    auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1) {
+        throw JobJournal::Error { "failed to open " + path + "; errno="
+                                  + std::to_string(errno) };
+    }
+
+#ifdef __linux__
+    auto result = fdatasync(fd);
+#else
+    auto result = fsync(fd);
+#endif
+    auto sync_errno = errno;
+    close(fd);
+
+    if (result == -1) {
+        throw JobJournal::Error { "failed to sync " + path + "; errno="
+                                  + std::to_string(sync_errno) };
+    }
+#endif
+}
+
+//
+// Records
+//
+
+struct RecordHeader {
+    uint64_t status_size;
+    uint64_t out_size;
+    uint64_t err_size;
+    unsigned long checksum;
+    std::string transaction_id;
+
+    uint64_t dataSize() const {
+        return status_size + out_size + err_size;
+    }
+};
+
+// Size of the blocks in which the record data is copied and
+// checksummed
+static const size_t BLOCK_SIZE { 64 * 1024 };
+
+// Update the CRC-32 checksum with the data
+static unsigned long updateChecksum(unsigned long checksum,
+                                    const char* data,
+                                    size_t size) {
+    // NB: crc32() takes the length as uInt, so feed it in blocks
+    const uInt block_size { 1 << 30 };
+
+    for (size_t done = 0; done < size; done += block_size) {
+        checksum = crc32(checksum,
+                         reinterpret_cast<const Bytef*>(data + done),
+                         static_cast<uInt>(std::min(static_cast<size_t>(block_size),
+                                                    size - done)));
+    }
+
+    return checksum;
+}
+
+// CRC-32 of the transaction id, to be updated with the record data
+static unsigned long initChecksum(const std::string& transaction_id) {
+    return updateChecksum(crc32(0L, Z_NULL, 0),
+                          transaction_id.data(), transaction_id.size());
+}
+
+static bool parseHeader(const std::string& line, RecordHeader& header) {
+    std::istringstream line_stream { line };
+
+    if (!(line_stream >> header.status_size >> header.out_size
+                      >> header.err_size >> header.checksum)
+            || line_stream.get() != ' ') {
+        return false;
+    }
+
+    std::getline(line_stream, header.transaction_id);
+    return !header.transaction_id.empty();
+}
+
+// Read the record at the current position of the stream, whose size
+// is available_size bytes at most, verifying its checksum in blocks;
+// in case record is not null, set its fields. Return false in case
+// it's incomplete or corrupted
+static bool readRecord(std::ifstream& segment_stream,
+                       uint64_t available_size,
+                       RecordHeader& header,
+                       JobJournal::Record* record,
+                       uint64_t& record_size) {
+    std::string line;
+
+    if (!std::getline(segment_stream, line) || segment_stream.eof()
+            || !parseHeader(line, header)) {
+        return false;
+    }
+
+    auto header_size = line.size() + 1;
+
+    // NB: check the sizes before allocating, as they may be garbage
+    if (header_size > available_size
+            || header.status_size > available_size
+            || header.out_size > available_size
+            || header.err_size > available_size
+            || header.dataSize() > available_size - header_size) {
+        return false;
+    }
+
+    auto checksum = initChecksum(header.transaction_id);
+    std::vector<std::pair<uint64_t, std::string*>> fields {
+        { header.status_size, record ? &record->status : nullptr },
+        { header.out_size, record ? &record->out : nullptr },
+        { header.err_size, record ? &record->err : nullptr } };
+    std::vector<char> block(BLOCK_SIZE);
+
+    for (const auto& field : fields) {
+        if (field.second) {
+            field.second->clear();
+            field.second->reserve(field.first);
+        }
+
+        for (uint64_t done = 0; done < field.first;) {
+            auto size = std::min(static_cast<uint64_t>(BLOCK_SIZE), field.first - done);
+            segment_stream.read(block.data(), size);
+
+            if (static_cast<uint64_t>(segment_stream.gcount()) != size) {
+                return false;
+            }
+
+            checksum = updateChecksum(checksum, block.data(), size);
+
+            if (field.second) {
+                field.second->append(block.data(), size);
+            }
+
+            done += size;
+        }
+    }
+
+    if (checksum != header.checksum) {
+        return false;
+    }
+
+    record_size = header_size + header.dataSize();
+    return true;
+}
+
+// Read size bytes of the segment starting at position
+static bool readData(std::ifstream& segment_stream,
+                     uint64_t position,
+                     uint64_t size,
+                     std::string& data) {
+    data.assign(size, '\0');
+
+    if (size == 0) {
+        return true;
+    }
+
+    return segment_stream.seekg(position)
+           && segment_stream.read(&data[0], size)
+           && static_cast<uint64_t>(segment_stream.gcount()) == size;
+}
+
+//
+// Public interface
+//
+
+JobJournal::JobJournal(const std::string& spool_dir,
+                       bool sync,
+                       size_t segment_size)
+        : spool_dir_ { spool_dir },
+          journal_dir_ { (fs::path(spool_dir) / DIRECTORY_NAME).string() },
+          index_path_ { (fs::path(journal_dir_) / INDEX_FILE).string() },
+          sync_ { sync },
+          segment_size_ { segment_size },
+          index_ {},
+          segment_number_ { 0 },
+          segment_end_ { 0 },
+          index_stream_ {},
+          lock_fd_ { -1 },
+          appended_sequence_ { 0 },
+          synced_sequence_ { 0 },
+          syncing_ { false },
+          unsynced_segments_ {},
+          mutex_ {},
+          cond_var_ {} {
+    try {
+        fs::create_directories(journal_dir_);
+    } catch (const fs::filesystem_error& e) {
+        throw Error { std::string { "failed to create the journal directory: " }
+                      + e.what() };
+    }
+
+    lock();
+
+    try {
+        load();
+        index_stream_.open(index_path_, std::ios::binary | std::ios::app);
+
+        if (!index_stream_) {
+            throw Error { "failed to open " + index_path_ };
+        }
+
+        if (sync_) {
+            syncPaths({ journal_dir_ });
+        }
+    } catch (const fs::filesystem_error& e) {
+        unlock();
+        throw Error { std::string { "failed to load the journal: " } + e.what() };
+    } catch (...) {
+        unlock();
+        throw;
+    }
+
+    LOG_INFO("Loaded the job journal in %1%: %2% jobs, %3% segments",
+             journal_dir_, index_.size(), segment_number_);
+}
+
+JobJournal::~JobJournal() {
+    unlock();
+}
+
+void JobJournal::append(const std::string& transaction_id, const Record& record) {
+    appendFields(transaction_id,
+                 { Field { &record.status, "", record.status.size() },
+                   Field { &record.out, "", record.out.size() },
+                   Field { &record.err, "", record.err.size() } });
+}
+
+void JobJournal::appendFiles(const std::string& transaction_id,
+                             const std::string& status,
+                             const std::string& out_path,
+                             const std::string& err_path) {
+    auto getFileSize = [](const std::string& path) -> uint64_t {
+        boost::system::error_code ec;
+        auto size = fs::file_size(path, ec);
+        return ec ? 0 : size;
+    };
+
+    appendFields(transaction_id,
+                 { Field { &status, "", status.size() },
+                   Field { nullptr, out_path, getFileSize(out_path) },
+                   Field { nullptr, err_path, getFileSize(err_path) } });
+}
+
+bool JobJournal::read(const std::string& transaction_id, Record& record) {
+    Location location;
+
+    if (!findRecord(transaction_id, location)) {
+        return false;
+    }
+
+    // NB: indexed records are never modified, so they're read without
+    // holding the lock
+    auto segment_path = segmentPath(location.segment);
+    std::ifstream segment_stream { segment_path, std::ios::binary };
+    RecordHeader header;
+    uint64_t record_size;
+
+    if (!segment_stream || !segment_stream.seekg(location.offset)
+            || !readRecord(segment_stream, location.size, header, &record, record_size)
+            || header.transaction_id != transaction_id) {
+        throw Error { "invalid journal record of " + transaction_id + " in "
+                      + segment_path };
+    }
+
+    return true;
+}
+
+bool JobJournal::readRange(const std::string& transaction_id,
+                           uint64_t offset,
+                           int64_t length,
+                           Record& record,
+                           uint64_t& out_size) {
+    Location location;
+
+    if (!findRecord(transaction_id, location)) {
+        return false;
+    }
+
+    auto segment_path = segmentPath(location.segment);
+    std::ifstream segment_stream { segment_path, std::ios::binary };
+    std::string line;
+    RecordHeader header;
+
+    if (!segment_stream || !segment_stream.seekg(location.offset)
+            || !std::getline(segment_stream, line)
+            || !parseHeader(line, header)
+            || header.transaction_id != transaction_id
+            || line.size() + 1 + header.dataSize() != location.size) {
+        throw Error { "invalid journal record of " + transaction_id + " in "
+                      + segment_path };
+    }
+
+    auto status_position = location.offset + line.size() + 1;
+    auto out_position = status_position + header.status_size;
+    auto range_size = offset < header.out_size ? header.out_size - offset : 0;
+
+    if (length >= 0) {
+        range_size = std::min(range_size, static_cast<uint64_t>(length));
+    }
+
+    if (!readData(segment_stream, status_position, header.status_size, record.status)
+            || !readData(segment_stream, out_position + std::min(offset, header.out_size),
+                         range_size, record.out)
+            || !readData(segment_stream, out_position + header.out_size,
+                         header.err_size, record.err)) {
+        throw Error { "failed to read the journal record of " + transaction_id
+                      + " in " + segment_path };
+    }
+
+    out_size = header.out_size;
+    return true;
+}
+
+size_t JobJournal::migrate() {
+    size_t num_migrated { 0 };
+    fs::directory_iterator end;
+
+    for (auto d = fs::directory_iterator(spool_dir_); d != end; ++d) {
+        if (!fs::is_directory(d->status())
+                || d->path().filename().string() == DIRECTORY_NAME) {
+            continue;
+        }
+
+        auto results_dir = d->path().string();
+
+        try {
+            ResultsStorage results_storage { results_dir };
+
+            if (results_storage.isRunning()) {
+                continue;
+            }
+
+            results_storage.archive(*this);
+            num_migrated++;
+        } catch (const std::exception& e) {
+            LOG_WARNING("Failed to move the job results in %1% to the journal: %2%",
+                        results_dir, e.what());
+        }
+    }
+
+    if (num_migrated > 0) {
+        LOG_INFO("Moved the results of %1% jobs to the journal", num_migrated);
+    }
+
+    return num_migrated;
+}
+
+//
+// Private interface
+//
+
+bool JobJournal::findRecord(const std::string& transaction_id, Location& location) {
+    lth_util::lock_guard<lth_util::mutex> the_lock { mutex_ };
+    auto entry = index_.find(transaction_id);
+
+    if (entry == index_.end()) {
+        return false;
+    }
+
+    location = entry->second;
+    return true;
+}
+
+void JobJournal::appendFields(const std::string& transaction_id,
+                              const std::vector<Field>& fields) {
+    if (transaction_id.empty()
+            || transaction_id.find_first_of("\r\n") != std::string::npos) {
+        throw Error { "invalid transaction id '" + transaction_id + "'" };
+    }
+
+    // Pass the data of the fields to process in blocks, so that the
+    // files are never loaded in memory; return false in case a file
+    // can't be read or it's shorter than its field
+    std::vector<char> block(BLOCK_SIZE);
+    auto processFields = [&](const std::function<void(const char*, size_t)>& process) {
+        for (const auto& field : fields) {
+            if (field.data) {
+                process(field.data->data(), field.data->size());
+                continue;
+            }
+
+            if (field.size == 0) {
+                continue;
+            }
+
+            std::ifstream field_stream { field.path, std::ios::binary };
+
+            for (uint64_t done = 0; done < field.size;) {
+                auto size = std::min(static_cast<uint64_t>(BLOCK_SIZE), field.size - done);
+
+                if (!field_stream.read(block.data(), size)) {
+                    return false;
+                }
+
+                process(block.data(), size);
+                done += size;
+            }
+        }
+
+        return true;
+    };
+
+    // NB: the checksum precedes the data, so the files are read twice
+    auto checksum = initChecksum(transaction_id);
+    uint64_t data_size { 0 };
+
+    if (!processFields([&](const char* data, size_t size) {
+                checksum = updateChecksum(checksum, data, size);
+                data_size += size;
+            })) {
+        throw Error { "failed to read the output of " + transaction_id };
+    }
+
+    std::ostringstream header_stream {};
+    header_stream << fields[0].size << ' ' << fields[1].size << ' ' << fields[2].size
+                  << ' ' << checksum << ' ' << transaction_id << '\n';
+    auto header_txt = header_stream.str();
+    auto record_size = header_txt.size() + data_size;
+
+    // Reserve the space of the record at the end of the segment, so
+    // that concurrent appends copy their data at the same time and
+    // findRecord() doesn't wait for the copies
+    lth_util::unique_lock<lth_util::mutex> the_lock { mutex_ };
+
+    if (segment_end_ > 0 && segment_end_ + record_size > segment_size_) {
+        openSegment(segment_number_ + 1);
+    }
+
+    Location location { segment_number_, segment_end_, record_size };
+    segment_end_ += record_size;
+    the_lock.unlock();
+
+    auto segment_path = segmentPath(location.segment);
+    std::fstream segment_stream { segment_path,
+                                  std::ios::binary | std::ios::in | std::ios::out };
+    auto copied = segment_stream.seekp(location.offset)
+                  && segment_stream.write(header_txt.data(), header_txt.size())
+                  && processFields([&](const char* data, size_t size) {
+                          segment_stream.write(data, size);
+                      })
+                  && segment_stream.flush();
+    segment_stream.close();
+
+    the_lock.lock();
+
+    if (!copied) {
+        // Discard the partial record, unless other records were
+        // reserved after it; in that case it's left unindexed and the
+        // following records are still found through the index
+        if (location.segment == segment_number_
+                && location.offset + record_size == segment_end_) {
+            boost::system::error_code ec;
+            fs::resize_file(segment_path, location.offset, ec);
+            segment_end_ = location.offset;
+        }
+
+        throw Error { "failed to append the record of " + transaction_id
+                      + " to " + segment_path };
+    }
+
+    // NB: the index file lists the records in the order they're
+    // completed, which may differ from the order of their offsets
+    index_stream_ << location.segment << ' ' << location.offset << ' '
+                  << location.size << ' ' << transaction_id << '\n';
+    index_stream_.flush();
+
+    if (!index_stream_) {
+        // NB: the record is indexed by scanning the segment when the
+        // journal is loaded again
+        index_stream_.clear();
+        LOG_WARNING("Failed to index the journal record of %1%", transaction_id);
+    }
+
+    index_[transaction_id] = location;
+
+    if (sync_) {
+        unsynced_segments_.insert(location.segment);
+        syncRecord(the_lock, ++appended_sequence_);
+    }
+}
+
+std::string JobJournal::segmentPath(uint32_t segment) const {
+    return (fs::path(journal_dir_)
+            / (std::to_string(segment) + SEGMENT_SUFFIX)).string();
+}
+
+void JobJournal::lock() {
+#ifndef _WIN32
+    auto lock_path = (fs::path(journal_dir_) / LOCK_FILE).string();
+    lock_fd_ = open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0640);
+
+    if (lock_fd_ == -1) {
+        throw Error { "failed to open " + lock_path + "; errno="
+                      + std::to_string(errno) };
+    }
+
+    if (flock(lock_fd_, LOCK_EX | LOCK_NB) == -1) {
+        unlock();
+        throw Error { "the journal in " + journal_dir_ + " is used by "
+                      "another process" };
+    }
+#endif
+}
+
+void JobJournal::unlock() {
+#ifndef _WIN32
+    if (lock_fd_ != -1) {
+        close(lock_fd_);
+        lock_fd_ = -1;
+    }
+#endif
+}
+
+void JobJournal::load() {
+    // Segment numbers and sizes
+    std::map<uint32_t, uint64_t> segments {};
+    fs::directory_iterator end;
+
+    for (auto f = fs::directory_iterator(journal_dir_); f != end; ++f) {
+        auto file_name = f->path().filename().string();
+
+        if (f->path().extension().string() == SEGMENT_SUFFIX
+                && std::all_of(file_name.begin(), file_name.end() - SEGMENT_SUFFIX.size(),
+                               ::isdigit)) {
+            segments[std::stoul(f->path().stem().string())] = fs::file_size(f->path());
+        }
+    }
+
+    // Entries pointing beyond the end of their segment (e.g. the
+    // segment was not synced before a crash) are dropped
+    std::ifstream index_file { index_path_, std::ios::binary };
+    std::string line;
+    auto rewrite_index = false;
+    std::pair<uint32_t, uint64_t> indexed_end { 0, 0 };
+
+    while (std::getline(index_file, line)) {
+        std::istringstream line_stream { line };
+        Location location;
+        std::string transaction_id;
+
+        if (!(line_stream >> location.segment >> location.offset >> location.size)
+                || line_stream.get() != ' '
+                || !std::getline(line_stream, transaction_id)
+                || transaction_id.empty()
+                || !segments.count(location.segment)
+                || location.offset + location.size > segments[location.segment]) {
+            rewrite_index = true;
+            continue;
+        }
+
+        index_[transaction_id] = location;
+        indexed_end = std::max(indexed_end, std::make_pair(location.segment,
+                                                           location.offset
+                                                           + location.size));
+    }
+
+    // Index the records that were appended after the last indexed one
+    for (const auto& segment : segments) {
+        if (segment.first < indexed_end.first) {
+            continue;
+        }
+
+        auto offset = (segment.first == indexed_end.first ? indexed_end.second : 0);
+        auto index_size = index_.size();
+
+        if (!scanSegment(segment.first, offset)) {
+            if (segment.first == segments.rbegin()->first) {
+                LOG_WARNING("Discarding the incomplete record at the end of %1%",
+                            segmentPath(segment.first));
+                fs::resize_file(segmentPath(segment.first), offset);
+            } else {
+                LOG_WARNING("Invalid record in %1% at offset %2%; the following "
+                            "records of the segment are ignored",
+                            segmentPath(segment.first), offset);
+            }
+        }
+
+        rewrite_index = rewrite_index || index_.size() != index_size;
+    }
+
+    if (rewrite_index) {
+        rewriteIndex();
+    }
+
+    openSegment(segments.empty() ? 1 : segments.rbegin()->first);
+}
+
+bool JobJournal::scanSegment(uint32_t segment, uint64_t& offset) {
+    auto segment_path = segmentPath(segment);
+    auto segment_size = fs::file_size(segment_path);
+    std::ifstream segment_stream { segment_path, std::ios::binary };
+
+    if (!segment_stream.seekg(offset)) {
+        return false;
+    }
+
+    while (offset < segment_size) {
+        RecordHeader header;
+        uint64_t record_size;
+
+        if (!readRecord(segment_stream, segment_size - offset, header, nullptr,
+                        record_size)) {
+            return false;
+        }
+
+        index_[header.transaction_id] = Location { segment, offset, record_size };
+        offset += record_size;
+    }
+
+    return true;
+}
+
+void JobJournal::rewriteIndex() {
+    std::vector<std::pair<Location, std::string>> entries {};
+
+    for (const auto& entry : index_) {
+        entries.push_back(std::make_pair(entry.second, entry.first));
+    }
+
+    // NB: entries are sorted by position, so that the last one marks
+    // the end of the indexed records
+    std::sort(entries.begin(), entries.end(),
+              [](const std::pair<Location, std::string>& a,
+                 const std::pair<Location, std::string>& b) {
+                  return std::make_pair(a.first.segment, a.first.offset)
+                         < std::make_pair(b.first.segment, b.first.offset);
+              });
+
+    auto tmp_path = index_path_ + ".tmp";
+    {
+        std::ofstream tmp_file { tmp_path, std::ios::binary | std::ios::trunc };
+
+        for (const auto& entry : entries) {
+            tmp_file << entry.first.segment << ' ' << entry.first.offset << ' '
+                     << entry.first.size << ' ' << entry.second << '\n';
+        }
+
+        if (!tmp_file.flush()) {
+            throw Error { "failed to write " + tmp_path };
+        }
+    }
+    fs::rename(tmp_path, index_path_);
+}
+
+void JobJournal::openSegment(uint32_t segment) {
+    auto segment_path = segmentPath(segment);
+    auto rotating = segment_number_ > 0 && segment != segment_number_;
+
+    // NB: records are written by the appending threads, each through
+    // its own stream; here the segment is only created
+    std::ofstream segment_stream { segment_path, std::ios::binary | std::ios::app };
+
+    if (!segment_stream) {
+        throw Error { "failed to open " + segment_path };
+    }
+
+    segment_number_ = segment;
+    segment_end_ = fs::file_size(segment_path);
+
+    if (sync_ && rotating) {
+        syncPaths({ journal_dir_ });
+    }
+}
+
+void JobJournal::syncRecord(lth_util::unique_lock<lth_util::mutex>& the_lock,
+                            uint64_t sequence) {
+    while (synced_sequence_ < sequence) {
+        if (syncing_) {
+            // Wait for the current sync; if it doesn't include this
+            // record, this thread may sync the next batch
+            cond_var_.wait(the_lock);
+            continue;
+        }
+
+        syncing_ = true;
+        auto target_sequence = appended_sequence_;
+        std::set<uint32_t> segments {};
+        segments.swap(unsynced_segments_);
+        the_lock.unlock();
+
+        std::string error {};
+
+        try {
+            for (auto segment : segments) {
+                syncData(segmentPath(segment));
+            }
+
+            syncData(index_path_);
+        } catch (const Error& e) {
+            error = e.what();
+        }
+
+        the_lock.lock();
+        syncing_ = false;
+        cond_var_.notify_all();
+
+        if (!error.empty()) {
+            unsynced_segments_.insert(segments.begin(), segments.end());
+            throw Error { error };
+        }
+
+        synced_sequence_ = std::max(synced_sequence_, target_sequence);
+    }
+}
+
+}  // namespace PXPAgent
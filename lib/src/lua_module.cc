@@ -0,0 +1,827 @@
+#include <pxp-agent/lua_module.hpp>
+#include <pxp-agent/util/logging.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.lua_module"
+#include <leatherman/logging/logging.hpp>
+#include <leatherman/file_util/file.hpp>
+
+#include <lua.hpp>
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#ifndef _WIN32
+#include <time.h>  // clock_gettime
+#endif
+
+namespace PXPAgent {
+
+namespace lth_file = leatherman::file_util;
+
+const std::string LuaModule::SCRIPT_SUFFIX { ".lua" };
+
+// Names of the exceeded limits, as reported for the action processes
+static const std::string CPU_TIME_LIMIT { "cpu_time" };
+static const std::string MEMORY_LIMIT { "memory" };
+
+static const int DEFAULT_MEMORY_MB { 64 };
+static const int MAX_MEMORY_MB { 4096 };
+static const int DEFAULT_CPU_SECONDS { 10 };
+
+// Number of VM instructions executed between CPU time checks; the
+// time spent in a single library call is checked once it returns
+static const int HOOK_INSTRUCTIONS { 10000 };
+
+// Maximum nesting of the JSON values exchanged with the script
+static const int MAX_JSON_DEPTH { 64 };
+
+// Globals of the base library that load code or access the system
+static const char* UNSAFE_GLOBALS[] = {
+    "collectgarbage", "dofile", "load", "loadfile", "loadstring", "print",
+    "require", nullptr };
+
+// Functions of the string library that match patterns; their matching
+// can take exponential time in a single call, out of reach of the CPU
+// time checks, so they're removed and string.find is restricted to
+// plain searches
+static const char* PATTERN_FUNCTIONS[] = { "gmatch", "gsub", "match", nullptr };
+
+//
+// Sandbox
+//
+
+// NB: Lua errors are raised with longjmp; the functions called by the
+// interpreter must not have objects with non trivial destructors
+
+static double getCpuTime() {
+#ifdef _WIN32
+    // No per-thread CPU clock; fall back to the wall time
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+// Resources used by a sandboxed execution
+struct SandboxState {
+    size_t memory_used;
+    size_t memory_limit;
+    double cpu_start;
+    double cpu_limit_s;
+    bool memory_exceeded;
+    bool cpu_time_exceeded;
+};
+
+static void* sandboxAlloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    auto state = static_cast<SandboxState*>(ud);
+
+    // NB: osize is the type of the object in case of new blocks
+    if (ptr == nullptr) {
+        osize = 0;
+    }
+
+    if (nsize == 0) {
+        std::free(ptr);
+        state->memory_used -= osize;
+        return nullptr;
+    }
+
+    if (nsize > osize
+            && state->memory_used - osize + nsize > state->memory_limit) {
+        state->memory_exceeded = true;
+        return nullptr;
+    }
+
+    auto new_ptr = std::realloc(ptr, nsize);
+
+    if (new_ptr != nullptr) {
+        state->memory_used = state->memory_used - osize + nsize;
+    }
+
+    return new_ptr;
+}
+
+static void cpuTimeHook(lua_State* L, lua_Debug*) {
+    void* ud;
+    lua_getallocf(L, &ud);
+    auto state = static_cast<SandboxState*>(ud);
+
+    if (getCpuTime() - state->cpu_start > state->cpu_limit_s) {
+        state->cpu_time_exceeded = true;
+        // Keep failing, in case the script catches the error
+        lua_sethook(L, cpuTimeHook, LUA_MASKCOUNT, 1);
+        luaL_error(L, "CPU time limit exceeded");
+    }
+}
+
+// pxp.read_file(path): return the content of the file or nil and an
+// error message
+static int readFile(lua_State* L) {
+    auto path = luaL_checkstring(L, 1);
+    auto file = std::fopen(path, "rb");
+
+    if (file == nullptr) {
+        lua_pushnil(L);
+        lua_pushstring(L, std::strerror(errno));
+        return 2;
+    }
+
+    std::fseek(file, 0, SEEK_END);
+    auto size = std::ftell(file);
+    std::fclose(file);
+
+    if (size < 0) {
+        lua_pushnil(L);
+        lua_pushstring(L, "failed to get the file size");
+        return 2;
+    }
+
+    // NB: the buffer is allocated first, as it may raise a memory error
+    auto buffer = static_cast<char*>(lua_newuserdata(L, size + 1));
+    file = std::fopen(path, "rb");
+
+    if (file == nullptr) {
+        lua_pushnil(L);
+        lua_pushstring(L, std::strerror(errno));
+        return 2;
+    }
+
+    auto read_size = std::fread(buffer, 1, size, file);
+    std::fclose(file);
+    lua_pushlstring(L, buffer, read_size);
+    return 1;
+}
+
+// string.find(s, pattern, init), searching the pattern as plain text;
+// the original function is the upvalue
+static int plainFind(lua_State* L) {
+    lua_settop(L, 3);
+    lua_pushboolean(L, 1);
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 1);
+    lua_call(L, 4, LUA_MULTRET);
+    return lua_gettop(L);
+}
+
+static void openSandboxLibraries(lua_State* L) {
+    luaL_requiref(L, "_G", luaopen_base, 1);
+    luaL_requiref(L, LUA_TABLIBNAME, luaopen_table, 1);
+    luaL_requiref(L, LUA_STRLIBNAME, luaopen_string, 1);
+    luaL_requiref(L, LUA_MATHLIBNAME, luaopen_math, 1);
+    lua_pop(L, 4);
+
+    // NB: the string table is also the __index of the strings
+    // metatable, so this applies to method calls as well
+    lua_getglobal(L, LUA_STRLIBNAME);
+
+    for (auto name = PATTERN_FUNCTIONS; *name != nullptr; ++name) {
+        lua_pushnil(L);
+        lua_setfield(L, -2, *name);
+    }
+
+    lua_getfield(L, -1, "find");
+    lua_pushcclosure(L, plainFind, 1);
+    lua_setfield(L, -2, "find");
+    lua_pop(L, 1);
+
+    for (auto name = UNSAFE_GLOBALS; *name != nullptr; ++name) {
+        lua_pushnil(L);
+        lua_setglobal(L, *name);
+    }
+
+    static const luaL_Reg pxp_functions[] = {
+        { "read_file", readFile },
+        { nullptr, nullptr } };
+    luaL_newlib(L, pxp_functions);
+    lua_setglobal(L, "pxp");
+}
+
+//
+// JSON to Lua
+//
+
+struct JsonReader {
+    const char* pos;
+    int depth;
+};
+
+static void skipSpace(JsonReader* reader) {
+    while (*reader->pos == ' ' || *reader->pos == '\t'
+           || *reader->pos == '\n' || *reader->pos == '\r') {
+        ++reader->pos;
+    }
+}
+
+static unsigned long readHex4(lua_State* L, JsonReader* reader) {
+    unsigned long code { 0 };
+
+    for (int i = 0; i < 4; ++i) {
+        auto c = *reader->pos++;
+        code <<= 4;
+
+        if (c >= '0' && c <= '9') {
+            code += c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            code += c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            code += c - 'A' + 10;
+        } else {
+            luaL_error(L, "invalid JSON unicode escape");
+        }
+    }
+
+    return code;
+}
+
+static void addUtf8(luaL_Buffer* buffer, unsigned long code) {
+    if (code < 0x80) {
+        luaL_addchar(buffer, static_cast<char>(code));
+    } else if (code < 0x800) {
+        luaL_addchar(buffer, static_cast<char>(0xC0 | (code >> 6)));
+        luaL_addchar(buffer, static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+        luaL_addchar(buffer, static_cast<char>(0xE0 | (code >> 12)));
+        luaL_addchar(buffer, static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        luaL_addchar(buffer, static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+        luaL_addchar(buffer, static_cast<char>(0xF0 | (code >> 18)));
+        luaL_addchar(buffer, static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+        luaL_addchar(buffer, static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        luaL_addchar(buffer, static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+
+static void pushJsonString(lua_State* L, JsonReader* reader) {
+    luaL_Buffer buffer;
+    luaL_buffinit(L, &buffer);
+    ++reader->pos;  // opening quote
+
+    while (*reader->pos != '"') {
+        if (*reader->pos == '\0') {
+            luaL_error(L, "unterminated JSON string");
+        }
+
+        if (*reader->pos != '\\') {
+            luaL_addchar(&buffer, *reader->pos++);
+            continue;
+        }
+
+        ++reader->pos;
+
+        switch (*reader->pos++) {
+            case '"':  luaL_addchar(&buffer, '"'); break;
+            case '\\': luaL_addchar(&buffer, '\\'); break;
+            case '/':  luaL_addchar(&buffer, '/'); break;
+            case 'b':  luaL_addchar(&buffer, '\b'); break;
+            case 'f':  luaL_addchar(&buffer, '\f'); break;
+            case 'n':  luaL_addchar(&buffer, '\n'); break;
+            case 'r':  luaL_addchar(&buffer, '\r'); break;
+            case 't':  luaL_addchar(&buffer, '\t'); break;
+            case 'u': {
+                auto code = readHex4(L, reader);
+
+                if (code >= 0xD800 && code < 0xDC00
+                        && reader->pos[0] == '\\' && reader->pos[1] == 'u') {
+                    reader->pos += 2;
+                    auto low = readHex4(L, reader);
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+
+                addUtf8(&buffer, code);
+                break;
+            }
+            default:
+                luaL_error(L, "invalid JSON escape");
+        }
+    }
+
+    ++reader->pos;  // closing quote
+    luaL_pushresult(&buffer);
+}
+
+static void pushJsonValue(lua_State* L, JsonReader* reader);
+
+static void pushJsonObject(lua_State* L, JsonReader* reader) {
+    ++reader->pos;
+    lua_newtable(L);
+    skipSpace(reader);
+
+    if (*reader->pos == '}') {
+        ++reader->pos;
+        return;
+    }
+
+    for (;;) {
+        skipSpace(reader);
+
+        if (*reader->pos != '"') {
+            luaL_error(L, "invalid JSON object key");
+        }
+
+        pushJsonString(L, reader);
+        skipSpace(reader);
+
+        if (*reader->pos++ != ':') {
+            luaL_error(L, "invalid JSON object");
+        }
+
+        pushJsonValue(L, reader);
+        lua_settable(L, -3);
+        skipSpace(reader);
+
+        if (*reader->pos == ',') {
+            ++reader->pos;
+        } else if (*reader->pos == '}') {
+            ++reader->pos;
+            return;
+        } else {
+            luaL_error(L, "invalid JSON object");
+        }
+    }
+}
+
+static void pushJsonArray(lua_State* L, JsonReader* reader) {
+    ++reader->pos;
+    lua_newtable(L);
+    skipSpace(reader);
+
+    if (*reader->pos == ']') {
+        ++reader->pos;
+        return;
+    }
+
+    for (lua_Integer idx = 1; ; ++idx) {
+        pushJsonValue(L, reader);
+        lua_rawseti(L, -2, idx);
+        skipSpace(reader);
+
+        if (*reader->pos == ',') {
+            ++reader->pos;
+        } else if (*reader->pos == ']') {
+            ++reader->pos;
+            return;
+        } else {
+            luaL_error(L, "invalid JSON array");
+        }
+    }
+}
+
+static void pushJsonLiteral(lua_State* L, JsonReader* reader) {
+    if (std::strncmp(reader->pos, "true", 4) == 0) {
+        lua_pushboolean(L, 1);
+        reader->pos += 4;
+    } else if (std::strncmp(reader->pos, "false", 5) == 0) {
+        lua_pushboolean(L, 0);
+        reader->pos += 5;
+    } else if (std::strncmp(reader->pos, "null", 4) == 0) {
+        lua_pushnil(L);
+        reader->pos += 4;
+    } else {
+        char* end;
+        auto value = std::strtod(reader->pos, &end);
+
+        if (end == reader->pos) {
+            luaL_error(L, "invalid JSON value");
+        }
+
+        auto is_integer = std::fabs(value) < 9007199254740992.0;  // 2^53
+        for (auto c = reader->pos; c != end && is_integer; ++c) {
+            is_integer = *c != '.' && *c != 'e' && *c != 'E';
+        }
+
+        if (is_integer) {
+            lua_pushinteger(L, static_cast<lua_Integer>(value));
+        } else {
+            lua_pushnumber(L, value);
+        }
+
+        reader->pos = end;
+    }
+}
+
+static void pushJsonValue(lua_State* L, JsonReader* reader) {
+    if (++reader->depth > MAX_JSON_DEPTH) {
+        luaL_error(L, "JSON value nested too deeply");
+    }
+
+    if (!lua_checkstack(L, 3)) {
+        luaL_error(L, "stack overflow");
+    }
+
+    skipSpace(reader);
+
+    switch (*reader->pos) {
+        case '{':
+            pushJsonObject(L, reader);
+            break;
+        case '[':
+            pushJsonArray(L, reader);
+            break;
+        case '"':
+            pushJsonString(L, reader);
+            break;
+        default:
+            pushJsonLiteral(L, reader);
+    }
+
+    --reader->depth;
+}
+
+//
+// Lua to JSON
+//
+
+// NB: the conversion only reads the Lua state, so it can't raise Lua
+// errors and can use C++ objects
+
+static void addJsonString(const char* txt, size_t size, std::string& json) {
+    json += '"';
+
+    for (size_t i = 0; i < size; ++i) {
+        auto c = static_cast<unsigned char>(txt[i]);
+
+        if (c == '"' || c == '\\') {
+            json += '\\';
+            json += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            json += escaped;
+        } else {
+            json += static_cast<char>(c);
+        }
+    }
+
+    json += '"';
+}
+
+static bool addJsonNumber(double value, std::string& json, std::string& error) {
+    if (!std::isfinite(value)) {
+        error = "the result contains a number that can't be represented in JSON";
+        return false;
+    }
+
+    char txt[32];
+
+    if (value == std::floor(value) && std::fabs(value) < 1e15) {
+        std::snprintf(txt, sizeof(txt), "%lld", static_cast<long long>(value));
+    } else {
+        std::snprintf(txt, sizeof(txt), "%.17g", value);
+    }
+
+    json += txt;
+    return true;
+}
+
+// Append the JSON representation of the Lua value at the specified
+// index; return false, setting the error message, in case the value
+// can't be represented in JSON or the JSON text exceeds max_size
+static bool addJsonValue(lua_State* L, int index, std::string& json,
+                         size_t max_size, int depth, std::string& error) {
+    index = lua_absindex(L, index);
+
+    if (depth > MAX_JSON_DEPTH || !lua_checkstack(L, 3)) {
+        error = "the result is nested too deeply";
+        return false;
+    }
+
+    switch (lua_type(L, index)) {
+        case LUA_TNIL:
+            json += "null";
+            break;
+        case LUA_TBOOLEAN:
+            json += lua_toboolean(L, index) ? "true" : "false";
+            break;
+        case LUA_TNUMBER:
+            if (!addJsonNumber(lua_tonumber(L, index), json, error)) {
+                return false;
+            }
+            break;
+        case LUA_TSTRING: {
+            size_t size;
+            auto txt = lua_tolstring(L, index, &size);
+            addJsonString(txt, size, json);
+            break;
+        }
+        case LUA_TTABLE: {
+            // Sequences are converted to arrays, other tables to objects
+            auto length = lua_rawlen(L, index);
+            size_t num_keys { 0 };
+
+            lua_pushnil(L);
+            while (lua_next(L, index)) {
+                ++num_keys;
+                lua_pop(L, 1);
+            }
+
+            if (length > 0 && num_keys == length) {
+                json += '[';
+
+                for (size_t i = 1; i <= length; ++i) {
+                    if (i > 1) {
+                        json += ',';
+                    }
+
+                    lua_rawgeti(L, index, i);
+                    if (!addJsonValue(L, -1, json, max_size, depth + 1, error)) {
+                        return false;
+                    }
+                    lua_pop(L, 1);
+                }
+
+                json += ']';
+            } else {
+                json += '{';
+                bool first { true };
+
+                lua_pushnil(L);
+                while (lua_next(L, index)) {
+                    if (!first) {
+                        json += ',';
+                    }
+                    first = false;
+
+                    // NB: lua_tolstring would convert numeric keys in
+                    // place, breaking the traversal
+                    if (lua_type(L, -2) == LUA_TSTRING) {
+                        size_t size;
+                        auto key = lua_tolstring(L, -2, &size);
+                        addJsonString(key, size, json);
+                    } else if (lua_type(L, -2) == LUA_TNUMBER) {
+                        json += '"';
+                        if (!addJsonNumber(lua_tonumber(L, -2), json, error)) {
+                            return false;
+                        }
+                        json += '"';
+                    } else {
+                        error = "the result contains a table key that can't "
+                                "be represented in JSON";
+                        return false;
+                    }
+
+                    json += ':';
+                    if (!addJsonValue(L, -1, json, max_size, depth + 1, error)) {
+                        return false;
+                    }
+                    lua_pop(L, 1);
+                }
+
+                json += '}';
+            }
+            break;
+        }
+        default:
+            error = std::string { "the result contains a " }
+                    + lua_typename(L, lua_type(L, index))
+                    + " value, that can't be represented in JSON";
+            return false;
+    }
+
+    if (json.size() > max_size) {
+        error = "the result exceeds the memory limit";
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Execution
+//
+
+// Arguments of the protected script execution
+struct ScriptCall {
+    const char* script;
+    size_t script_size;
+    const char* chunk_name;
+    const char* action;  // null to retrieve the metadata
+    const char* input;
+};
+
+// Execute the script and return the metadata or the action results
+static int runScript(lua_State* L) {
+    auto call = static_cast<ScriptCall*>(lua_touserdata(L, 1));
+    lua_settop(L, 0);
+    openSandboxLibraries(L);
+
+    // NB: precompiled chunks are not accepted, as they can't be verified
+    if (luaL_loadbufferx(L, call->script, call->script_size,
+                         call->chunk_name, "t") != LUA_OK) {
+        lua_error(L);
+    }
+
+    lua_call(L, 0, 0);
+
+    if (call->action == nullptr) {
+        lua_getglobal(L, "metadata");
+        return 1;
+    }
+
+    lua_getglobal(L, "actions");  // 1
+
+    if (lua_type(L, 1) != LUA_TTABLE) {
+        luaL_error(L, "the script does not define the 'actions' table");
+    }
+
+    JsonReader reader { call->input, 0 };
+    pushJsonValue(L, &reader);  // 2
+    lua_getfield(L, 1, call->action);  // 3
+
+    if (lua_type(L, 3) != LUA_TFUNCTION) {
+        luaL_error(L, "the script does not define the '%s' action",
+                   call->action);
+    }
+
+    lua_getfield(L, 2, "params");
+    lua_getfield(L, 2, "config");
+    lua_call(L, 2, 1);
+    return 1;
+}
+
+// Lua state with capped memory and CPU time, used for a single
+// execution of a module script
+class Sandbox {
+  public:
+    Sandbox(size_t memory_limit, double cpu_limit_s)
+            : state_ { 0, memory_limit, 0.0, cpu_limit_s, false, false },
+              lua_state_ { lua_newstate(sandboxAlloc, &state_) } {
+        if (lua_state_ == nullptr) {
+            throw Module::ProcessingError { "failed to create the Lua state" };
+        }
+    }
+
+    Sandbox(const Sandbox&) = delete;
+    Sandbox& operator=(const Sandbox&) = delete;
+
+    ~Sandbox() {
+        lua_close(lua_state_);
+    }
+
+    /// Execute the script and, if specified, the action with the
+    /// JSON input; return 0 and set the output to the JSON results
+    /// (the metadata if no action is specified) or, in case of
+    /// failure, return 1 and set the error message.
+    int run(const std::string& script,
+            const std::string& path,
+            const char* action,
+            const std::string& input,
+            std::string& output,
+            std::string& error) {
+        auto L = lua_state_;
+        auto chunk_name = "@" + path;
+        ScriptCall call { script.data(), script.size(), chunk_name.c_str(),
+                          action, input.c_str() };
+
+        state_.cpu_start = getCpuTime();
+        lua_sethook(L, cpuTimeHook, LUA_MASKCOUNT, HOOK_INSTRUCTIONS);
+        lua_pushcfunction(L, runScript);
+        lua_pushlightuserdata(L, &call);
+
+        if (lua_pcall(L, 1, 1, 0) != LUA_OK) {
+            // NB: only strings are read, as converting other values
+            // requires memory
+            error = lua_type(L, -1) == LUA_TSTRING ? lua_tostring(L, -1)
+                                                   : "unknown error";
+            return 1;
+        }
+
+        lua_sethook(L, nullptr, 0, 0);
+
+        if (!addJsonValue(L, -1, output, state_.memory_limit, 0, error)) {
+            output.clear();
+            return 1;
+        }
+
+        return 0;
+    }
+
+    /// Return the name of the limit exceeded by the last execution
+    /// or an empty string
+    std::string getExceededLimit() const {
+        if (state_.cpu_time_exceeded) {
+            return CPU_TIME_LIMIT;
+        }
+
+        if (state_.memory_exceeded) {
+            return MEMORY_LIMIT;
+        }
+
+        return "";
+    }
+
+  private:
+    SandboxState state_;
+    lua_State* lua_state_;
+};
+
+//
+// LuaModule
+//
+
+static std::string readScript(const std::string& path) {
+    std::string script {};
+
+    if (!lth_file::read(path, script)) {
+        throw Module::LoadingError { "failed to read " + path };
+    }
+
+    return script;
+}
+
+static lth_jc::JsonContainer getScriptMetadata(const std::string& path,
+                                               const std::string& script) {
+    Sandbox sandbox { static_cast<size_t>(DEFAULT_MEMORY_MB) * 1024 * 1024,
+                      DEFAULT_CPU_SECONDS };
+    std::string metadata_txt {};
+    std::string error {};
+
+    if (sandbox.run(script, path, nullptr, "", metadata_txt, error)) {
+        throw Module::LoadingError { "failed to retrieve the metadata of "
+                                     + path + ": " + error };
+    }
+
+    try {
+        return lth_jc::JsonContainer { metadata_txt };
+    } catch (lth_jc::data_parse_error& e) {
+        throw Module::LoadingError { "invalid metadata of " + path + ": "
+                                     + e.what() };
+    }
+}
+
+LuaModule::LuaModule(const std::string& path,
+                     const lth_jc::JsonContainer& config)
+        : LuaModule(path, config, readScript(path)) {
+}
+
+LuaModule::LuaModule(const std::string& path,
+                     const lth_jc::JsonContainer& config,
+                     const std::string& script)
+        : ExternalModule(path, config, getScriptMetadata(path, script)),
+          script_ { script },
+          memory_limit_ { static_cast<size_t>(DEFAULT_MEMORY_MB) * 1024 * 1024 },
+          cpu_limit_s_ { DEFAULT_CPU_SECONDS } {
+    auto invalid = [&](const std::string& reason) {
+        return Module::LoadingError { "invalid limits of module " + module_name
+                                      + ": " + reason };
+    };
+
+    if (!config_.includes("limits")) {
+        return;
+    }
+
+    try {
+        auto limits = config_.get<lth_jc::JsonContainer>("limits");
+
+        if (limits.includes("memory_mb")) {
+            auto memory_mb = limits.get<int>("memory_mb");
+            if (memory_mb <= 0 || memory_mb > MAX_MEMORY_MB) {
+                throw invalid("memory_mb must be between 1 and "
+                              + std::to_string(MAX_MEMORY_MB));
+            }
+            memory_limit_ = static_cast<size_t>(memory_mb) * 1024 * 1024;
+        }
+
+        if (limits.includes("cpu_seconds")) {
+            auto cpu_seconds = limits.get<int>("cpu_seconds");
+            if (cpu_seconds <= 0) {
+                throw invalid("cpu_seconds must be positive");
+            }
+            cpu_limit_s_ = cpu_seconds;
+        }
+    } catch (lth_jc::data_error& e) {
+        throw invalid(e.what());
+    }
+}
+
+ActionOutcome LuaModule::callAction(const ActionRequest& request) {
+    auto& action_name = request.action();
+
+    std::unique_ptr<BinaryDataFile> binary_data_file {};
+    auto request_input_txt = getActionInput(request, binary_data_file);
+
+    LOG_INFO("About to execute '%1% %2%' in the Lua sandbox",
+             module_name, action_name);
+    LOG_DEBUG("'%1% %2%' request input: %3%", module_name, action_name,
+              Util::logPayload(request_input_txt));
+
+    Sandbox sandbox { memory_limit_, cpu_limit_s_ };
+    std::string output {};
+    std::string error {};
+    auto exitcode = sandbox.run(script_, path_, action_name.c_str(),
+                                request_input_txt, output, error);
+
+    storeOutput(request, output, error);
+
+    return processOutput(action_name, exitcode, output, error,
+                         (exitcode ? sandbox.getExceededLimit() : ""));
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,377 @@
+#include <pxp-agent/modules/file_transfer.hpp>
+#include <pxp-agent/util/checksum.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.modules.file_transfer"
+#include <leatherman/logging/logging.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>         // _commit, _fileno
+#else
+#include <sys/types.h>  // off_t
+#include <unistd.h>     // fsync
+#endif
+
+namespace PXPAgent {
+namespace Modules {
+
+namespace fs = boost::filesystem;
+
+static const std::string FILE_TRANSFER { "file_transfer" };
+static const std::string WRITE_CHUNK { "write_chunk" };
+static const std::string STATUS { "status" };
+static const std::string COMMIT { "commit" };
+
+// Partial files are synced to disk once this amount of data has been
+// written to them since the last sync [bytes]
+static const size_t SYNC_BATCH_SIZE { 8 * 1024 * 1024 };
+
+const std::string FileTransfer::PARTIAL_SUFFIX { ".part" };
+
+// Set the position of the stream; offsets can exceed 2 GiB, so fseek
+// is not used. Return false on failure
+static bool seekFile(FILE* file, int64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    // NB: off_t is 32 bits wide on 32-bit platforms, unless built with
+    // _FILE_OFFSET_BITS=64
+    if (offset > std::numeric_limits<off_t>::max()) {
+        return false;
+    }
+
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// Flush the stream and sync the file to disk; return false on failure
+static bool syncFile(FILE* file) {
+    if (fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Return the components of the path, except the '.' ones (e.g. the
+// one of a trailing separator)
+static std::vector<std::string> getComponents(const fs::path& path) {
+    std::vector<std::string> components {};
+
+    for (const auto& component : path) {
+        if (component != ".") {
+            components.push_back(component.string());
+        }
+    }
+
+    return components;
+}
+
+FileTransfer::FileTransfer(const std::string& root_dir)
+        : root_dir_ { root_dir } {
+    module_name = FILE_TRANSFER;
+    actions.push_back(WRITE_CHUNK);
+    actions.push_back(STATUS);
+    actions.push_back(COMMIT);
+
+    PCPClient::Schema write_chunk_schema { WRITE_CHUNK };
+    write_chunk_schema.addConstraint("destination", PCPClient::TypeConstraint::String,
+                                     true);
+    write_chunk_schema.addConstraint("offset", PCPClient::TypeConstraint::Int,
+                                     true);
+    // NB: the chunk data is the request binary payload, if any
+    write_chunk_schema.addConstraint("data", PCPClient::TypeConstraint::String,
+                                     false);
+
+    PCPClient::Schema status_schema { STATUS };
+    status_schema.addConstraint("destination", PCPClient::TypeConstraint::String,
+                                true);
+
+    PCPClient::Schema commit_schema { COMMIT };
+    commit_schema.addConstraint("destination", PCPClient::TypeConstraint::String,
+                                true);
+    commit_schema.addConstraint("sha256", PCPClient::TypeConstraint::String,
+                                true);
+
+    input_validator_.registerSchema(write_chunk_schema);
+    input_validator_.registerSchema(status_schema);
+    input_validator_.registerSchema(commit_schema);
+
+    output_validator_.registerSchema(PCPClient::Schema { WRITE_CHUNK });
+    output_validator_.registerSchema(PCPClient::Schema { STATUS });
+    output_validator_.registerSchema(PCPClient::Schema { COMMIT });
+}
+
+ActionOutcome FileTransfer::callAction(const ActionRequest& request) {
+    auto destination = request.params().get<std::string>("destination");
+    validateDestination(destination);
+
+    lth_jc::JsonContainer results {};
+    auto destination_mutex = acquireDestinationMutex(destination);
+
+    try {
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock {
+            *destination_mutex };
+
+        if (request.action() == WRITE_CHUNK) {
+            results = writeChunk(request, destination);
+        } else if (request.action() == STATUS) {
+            results = getStatus(destination);
+        } else {
+            results = commit(request, destination);
+        }
+    } catch (...) {
+        releaseDestinationMutex(destination, destination_mutex);
+        throw;
+    }
+
+    releaseDestinationMutex(destination, destination_mutex);
+    return ActionOutcome { EXIT_SUCCESS, results };
+}
+
+void FileTransfer::validateDestination(const std::string& destination) {
+    if (root_dir_.empty()) {
+        throw Module::ProcessingError { "file transfers are disabled; no "
+                                        "file-transfer-dir is configured" };
+    }
+
+    fs::path destination_path { destination };
+
+    if (!destination_path.is_absolute()) {
+        throw Module::ProcessingError { "the destination must be an absolute "
+                                        "path: " + destination };
+    }
+
+    for (const auto& component : destination_path) {
+        if (component == "." || component == "..") {
+            throw Module::ProcessingError { "the destination must not contain "
+                                            "'.' or '..': " + destination };
+        }
+    }
+
+    // NB: paths are compared by component, as written; the root
+    // directory itself may be a symbolic link
+    auto root_components = getComponents(fs::path { root_dir_ });
+    auto components = getComponents(destination_path);
+
+    if (components.size() <= root_components.size()
+            || !std::equal(root_components.begin(), root_components.end(),
+                           components.begin())) {
+        throw Module::ProcessingError { "the destination must be within "
+                                        + root_dir_ + ": " + destination };
+    }
+
+    // The parents within the root directory must not be symbolic
+    // links, that may point outside of it
+    fs::path parent_path { root_dir_ };
+    boost::system::error_code ec;
+
+    for (auto idx = root_components.size(); idx < components.size() - 1; idx++) {
+        parent_path /= components[idx];
+
+        if (fs::is_symlink(fs::symlink_status(parent_path, ec))) {
+            throw Module::ProcessingError { "the destination must not have "
+                                            "symbolic links as parents: "
+                                            + parent_path.string() };
+        }
+    }
+
+    if (fs::is_symlink(fs::symlink_status(destination + PARTIAL_SUFFIX, ec))) {
+        throw Module::ProcessingError { "the partial file of " + destination
+                                        + " is a symbolic link" };
+    }
+}
+
+std::shared_ptr<PCPClient::Util::mutex> FileTransfer::acquireDestinationMutex(
+        const std::string& destination) {
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mutex_ };
+    auto& destination_mutex = destination_mutexes_[destination];
+
+    if (!destination_mutex) {
+        destination_mutex.reset(new PCPClient::Util::mutex());
+    }
+
+    return destination_mutex;
+}
+
+void FileTransfer::releaseDestinationMutex(
+        const std::string& destination,
+        std::shared_ptr<PCPClient::Util::mutex>& destination_mutex) {
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mutex_ };
+    destination_mutex.reset();
+
+    // NB: the references are only copied or released under mutex_
+    auto mutex_itr = destination_mutexes_.find(destination);
+
+    if (mutex_itr != destination_mutexes_.end()
+            && mutex_itr->second.use_count() == 1) {
+        destination_mutexes_.erase(mutex_itr);
+    }
+}
+
+lth_jc::JsonContainer FileTransfer::writeChunk(const ActionRequest& request,
+                                               const std::string& destination) {
+    auto partial_path = destination + PARTIAL_SUFFIX;
+    auto offset = request.params().get<int64_t>("offset");
+    std::string text_data {};
+    auto data_ptr = &request.binaryData();
+
+    if (data_ptr->empty() && request.params().includes("data")) {
+        text_data = request.params().get<std::string>("data");
+        data_ptr = &text_data;
+    }
+
+    auto& data = *data_ptr;
+    boost::system::error_code ec;
+    auto partial_size = fs::exists(partial_path, ec) ? fs::file_size(partial_path, ec) : 0;
+
+    if (ec) {
+        throw Module::ProcessingError { "failed to inspect " + partial_path
+                                        + ": " + ec.message() };
+    }
+
+    // NB: chunks can be re-sent, but no gap is allowed
+    if (offset < 0 || static_cast<uintmax_t>(offset) > partial_size) {
+        throw Module::ProcessingError {
+            "invalid offset " + std::to_string(offset) + "; the partial file "
+            "has " + std::to_string(partial_size) + " bytes" };
+    }
+
+    if (offset == 0) {
+        fs::create_directories(fs::path(partial_path).parent_path(), ec);
+    }
+
+    auto file = fopen(partial_path.c_str(), (partial_size > 0 ? "r+b" : "wb"));
+
+    if (file == nullptr) {
+        throw Module::ProcessingError { "failed to open " + partial_path };
+    }
+
+    auto written = (seekFile(file, offset)
+                    ? fwrite(data.data(), 1, data.size(), file) : 0);
+    auto sync_due = false;
+
+    {
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mutex_ };
+        auto& unsynced = unsynced_bytes_[partial_path];
+        unsynced += written;
+
+        if (unsynced >= SYNC_BATCH_SIZE) {
+            sync_due = true;
+            unsynced = 0;
+        }
+    }
+
+    auto synced = sync_due ? syncFile(file) : true;
+
+    auto closed = fclose(file) == 0;
+
+    if (written != data.size() || !synced || !closed) {
+        throw Module::ProcessingError { "failed to write the chunk at offset "
+                                        + std::to_string(offset) + " to "
+                                        + partial_path };
+    }
+
+    LOG_DEBUG("Wrote %1% bytes at offset %2% of %3%", data.size(), offset,
+              partial_path);
+
+    lth_jc::JsonContainer results {};
+    results.set<int64_t>("size", static_cast<int64_t>(
+        std::max<uintmax_t>(partial_size, offset + data.size())));
+    return results;
+}
+
+lth_jc::JsonContainer FileTransfer::getStatus(const std::string& destination) {
+    auto partial_path = destination + PARTIAL_SUFFIX;
+    boost::system::error_code ec;
+    lth_jc::JsonContainer results {};
+
+    // NB: the size of the partial file is the offset to resume from
+    if (fs::exists(partial_path, ec)) {
+        results.set<bool>("partial", true);
+        results.set<int64_t>("size",
+                             static_cast<int64_t>(fs::file_size(partial_path, ec)));
+    } else {
+        results.set<bool>("partial", false);
+        results.set<int64_t>("size", 0);
+    }
+
+    return results;
+}
+
+lth_jc::JsonContainer FileTransfer::commit(const ActionRequest& request,
+                                           const std::string& destination) {
+    auto partial_path = destination + PARTIAL_SUFFIX;
+    auto expected_sha256 = boost::algorithm::to_lower_copy(
+        request.params().get<std::string>("sha256"));
+
+    if (!fs::exists(partial_path)) {
+        throw Module::ProcessingError { "no partial file for " + destination };
+    }
+
+    auto file = fopen(partial_path.c_str(), "r+b");
+
+    if (file == nullptr || !syncFile(file)) {
+        if (file != nullptr) {
+            fclose(file);
+        }
+        throw Module::ProcessingError { "failed to sync " + partial_path };
+    }
+
+    fclose(file);
+
+    {
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mutex_ };
+        unsynced_bytes_.erase(partial_path);
+    }
+
+    std::string sha256 {};
+
+    try {
+        sha256 = Util::getFileSha256(partial_path);
+    } catch (const std::runtime_error& e) {
+        throw Module::ProcessingError { e.what() };
+    }
+
+    if (sha256 != expected_sha256) {
+        // NB: the partial file is removed, as it's not known which
+        // chunk is corrupted
+        LOG_WARNING("Checksum mismatch for %1% (expected %2%, got %3%); "
+                    "removing it", partial_path, expected_sha256, sha256);
+        boost::system::error_code ec;
+        fs::remove(partial_path, ec);
+        throw Module::ProcessingError { "checksum mismatch for " + destination
+                                        + ": " + sha256 };
+    }
+
+    auto size = fs::file_size(partial_path);
+    boost::system::error_code ec;
+    fs::rename(partial_path, destination, ec);
+
+    if (ec) {
+        throw Module::ProcessingError { "failed to rename " + partial_path
+                                        + ": " + ec.message() };
+    }
+
+    LOG_INFO("Received %1% (%2% bytes)", destination, size);
+
+    lth_jc::JsonContainer results {};
+    results.set<int64_t>("size", static_cast<int64_t>(size));
+    results.set<std::string>("sha256", sha256);
+    return results;
+}
+
+}  // namespace Modules
+}  // namespace PXPAgent
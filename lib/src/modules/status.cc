@@ -1,11 +1,15 @@
 #include <pxp-agent/modules/status.hpp>
 #include <pxp-agent/configuration.hpp>
+#include <pxp-agent/job_journal.hpp>
+#include <pxp-agent/results_storage.hpp>
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/operations.hpp>
 
 #include <leatherman/file_util/file.hpp>
 
+#include <cstdint>
+
 #define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.modules.status"
 #include <leatherman/logging/logging.hpp>
 
@@ -22,12 +26,15 @@ const std::string Status::SUCCESS { "success" };
 const std::string Status::FAILURE { "failure" };
 const std::string Status::RUNNING { "running" };
 
-Status::Status() {
+Status::Status(std::shared_ptr<JobJournal> journal)
+        : journal_ { journal } {
     module_name = "status";
     actions.push_back(QUERY);
     PCPClient::Schema input_schema { QUERY };
     input_schema.addConstraint("transaction_id", PCPClient::TypeConstraint::String,
                                true);
+    input_schema.addConstraint("offset", PCPClient::TypeConstraint::Int, false);
+    input_schema.addConstraint("length", PCPClient::TypeConstraint::Int, false);
 
     PCPClient::Schema output_schema { QUERY };
 
@@ -41,28 +48,102 @@ ActionOutcome Status::callAction(const ActionRequest& request) {
     fs::path results_path { Configuration::Instance().get<std::string>("spool-dir") };
     auto results_dir = (results_path / t_id).string();
 
-    if (!fs::exists(results_dir)) {
+    // NB: a range of the output can be requested, so that large
+    // outputs can be retrieved in multiple queries
+    auto ranged = request.params().includes("offset")
+                  || request.params().includes("length");
+    auto offset = request.params().includes("offset")
+                  ? request.params().get<int>("offset") : 0;
+    auto length = request.params().includes("length")
+                  ? request.params().get<int>("length") : -1;
+
+    if (offset < 0) {
+        throw Module::ProcessingError {
+            "invalid offset: " + std::to_string(offset) };
+    }
+
+    // NB: completed jobs are moved to the journal, if used; the
+    // results of running ones are always in their directory
+    JobJournal::Record record {};
+    uint64_t journaled_out_size { 0 };
+    bool journaled { false };
+
+    if (journal_) {
+        try {
+            journaled = ranged
+                        ? journal_->readRange(t_id, offset, length, record,
+                                              journaled_out_size)
+                        : journal_->read(t_id, record);
+        } catch (const JobJournal::Error& e) {
+            throw Module::ProcessingError { e.what() };
+        }
+    }
+
+    if (!journaled && !fs::exists(results_dir)) {
         LOG_ERROR("Found no results for job %1%", t_id);
         results.set<std::string>("status", Status::UNKNOWN);
     } else {
-        LOG_DEBUG("Retrieving results for job %1% from %2%", t_id, results_dir);
-        lth_jc::JsonContainer status_data { lth_file::read(results_dir + "/status") };
+        LOG_DEBUG("Retrieving results for job %1% from %2%", t_id,
+                  (journaled ? "the journal" : results_dir));
+        lth_jc::JsonContainer status_data {
+            journaled ? record.status
+                      : lth_file::read(results_dir + "/" + ResultsStorage::STATUS_FILE) };
 
         auto status_txt = status_data.get<std::string>("status");
         auto exitcode = status_data.get<int>("exitcode");;
 
-        if (status_txt == "running") {
+        if (status_txt == ResultsStorage::RUNNING) {
             results.set<std::string>("status", Status::RUNNING);
-        } else if (status_txt == "completed") {
+            lth_jc::JsonContainer progress {};
+
+            // NB: the progress is optionally reported by the module
+            if (ResultsStorage::readProgress(results_dir, progress)) {
+                results.set<lth_jc::JsonContainer>("progress", progress);
+            }
+        } else if (status_txt == ResultsStorage::COMPLETED
+                   || status_txt == ResultsStorage::FAILED) {
+            // NB: failed jobs are the ones whose outcome could not be
+            // determined, e.g. after a pxp-agent restart
             std::string status {
-                (exitcode == EXIT_SUCCESS ? Status::SUCCESS : Status::FAILURE) };
-            auto err = lth_file::read(results_dir + "/stderr");
-            auto out = lth_file::read(results_dir + "/stdout");
+                (status_txt == ResultsStorage::COMPLETED && exitcode == EXIT_SUCCESS
+                    ? Status::SUCCESS : Status::FAILURE) };
+            auto err = journaled ? record.err
+                                 : ResultsStorage::readOutput(results_dir,
+                                                              ResultsStorage::STDERR_FILE);
+            std::string out {};
+
+            if (journaled) {
+                // NB: in case of ranged query, only the range was read
+                out = record.out;
+
+                if (ranged) {
+                    results.set<int>("stdout_size", static_cast<int>(journaled_out_size));
+                }
+            } else if (ranged) {
+                uint64_t out_size { 0 };
+                out = ResultsStorage::readOutputRange(results_dir,
+                                                      ResultsStorage::STDOUT_FILE,
+                                                      offset, length, out_size);
+                results.set<int>("stdout_size", static_cast<int>(out_size));
+            } else {
+                out = ResultsStorage::readOutput(results_dir,
+                                                 ResultsStorage::STDOUT_FILE);
+            }
 
             results.set<std::string>("status", status);
             results.set<int>("exitcode", exitcode);
             results.set<std::string>("stdout", out);
             results.set<std::string>("stderr", err);
+
+            if (status_data.includes("resources")) {
+                results.set<lth_jc::JsonContainer>("resources",
+                    status_data.get<lth_jc::JsonContainer>("resources"));
+            }
+
+            if (status_data.includes("limit_exceeded")) {
+                results.set<std::string>("limit_exceeded",
+                    status_data.get<std::string>("limit_exceeded"));
+            }
         } else {
             results.set<std::string>("status", Status::UNKNOWN);
         }
@@ -0,0 +1,173 @@
+#include <pxp-agent/plugin_module.hpp>
+#include <pxp-agent/util/logging.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.plugin_module"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <dlfcn.h>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+
+#ifdef __APPLE__
+const std::string PluginModule::PLUGIN_SUFFIX { ".dylib" };
+#else
+const std::string PluginModule::PLUGIN_SUFFIX { ".so" };
+#endif
+
+// Return the specified symbol of the library
+template <typename Function>
+static Function getSymbol(void* handle, const std::string& path, const char* name) {
+    dlerror();
+    auto symbol = dlsym(handle, name);
+
+    if (symbol == nullptr) {
+        auto err = dlerror();
+        throw Module::LoadingError { "plugin " + path + " does not export "
+                                     + name + (err ? std::string { ": " } + err : "") };
+    }
+
+    return reinterpret_cast<Function>(symbol);
+}
+
+// Load a private copy of the library, so that a reloaded plugin is
+// not matched against the instance that is still loaded (the dynamic
+// loader identifies libraries by name and by inode); the copy is
+// removed once mapped. Return nullptr in case the copy can't be made
+// or loaded, e.g. if the temporary directory is mounted noexec.
+static void* openCopy(const std::string& path) {
+    boost::system::error_code ec;
+    auto copy_path = fs::temp_directory_path(ec)
+                     / fs::unique_path("pxp-plugin-%%%%-%%%%-%%%%-%%%%"
+                                       + PluginModule::PLUGIN_SUFFIX, ec);
+
+    if (!ec) {
+        fs::copy_file(path, copy_path, ec);
+    }
+
+    if (ec) {
+        LOG_DEBUG("Failed to copy plugin %1%: %2%", path, ec.message());
+        return nullptr;
+    }
+
+    auto handle = dlopen(copy_path.string().c_str(), RTLD_NOW | RTLD_LOCAL);
+    fs::remove(copy_path, ec);
+    return handle;
+}
+
+PluginModule::Library::Library(const std::string& path)
+        : handle { openCopy(path) } {
+    if (handle == nullptr) {
+        // NB: loading the library itself would silently return the
+        // old instance, if loaded
+        auto loaded_handle = dlopen(path.c_str(), RTLD_NOW | RTLD_NOLOAD);
+
+        if (loaded_handle != nullptr) {
+            dlclose(loaded_handle);
+            throw Module::LoadingError { "plugin " + path + " is already "
+                                         "loaded; restart pxp-agent to load "
+                                         "its new version" };
+        }
+
+        handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    }
+
+    if (handle == nullptr) {
+        auto err = dlerror();
+        throw Module::LoadingError { "failed to load plugin " + path
+                                     + (err ? std::string { ": " } + err : "") };
+    }
+
+    try {
+        auto abi_version = getSymbol<pxp_plugin_abi_version_fn>(
+            handle, path, "pxp_plugin_abi_version")();
+
+        if (abi_version != PXP_PLUGIN_ABI_VERSION) {
+            throw Module::LoadingError { "plugin " + path + " implements ABI "
+                                         "version " + std::to_string(abi_version)
+                                         + "; supported version: "
+                                         + std::to_string(PXP_PLUGIN_ABI_VERSION) };
+        }
+
+        metadata = getSymbol<pxp_plugin_metadata_fn>(
+            handle, path, "pxp_plugin_metadata");
+        call_action = getSymbol<pxp_plugin_call_action_fn>(
+            handle, path, "pxp_plugin_call_action");
+        free = getSymbol<pxp_plugin_free_fn>(handle, path, "pxp_plugin_free");
+    } catch (Module::LoadingError&) {
+        dlclose(handle);
+        throw;
+    }
+}
+
+PluginModule::Library::~Library() {
+    dlclose(handle);
+}
+
+// Retrieve the metadata of the specified plugin
+static lth_jc::JsonContainer getPluginMetadata(pxp_plugin_metadata_fn metadata_fn,
+                                               const std::string& path) {
+    auto metadata_txt = metadata_fn();
+
+    if (metadata_txt == nullptr) {
+        throw Module::LoadingError { "plugin " + path + " returned no metadata" };
+    }
+
+    try {
+        return lth_jc::JsonContainer { metadata_txt };
+    } catch (lth_jc::data_parse_error& e) {
+        throw Module::LoadingError { "plugin " + path + " returned invalid "
+                                     "metadata: " + e.what() };
+    }
+}
+
+PluginModule::PluginModule(const std::string& path,
+                           const lth_jc::JsonContainer& config)
+        : PluginModule(path, config,
+                       std::unique_ptr<Library> { new Library { path } }) {
+}
+
+PluginModule::PluginModule(const std::string& path,
+                           const lth_jc::JsonContainer& config,
+                           std::unique_ptr<Library> library)
+        : ExternalModule(path, config, getPluginMetadata(library->metadata, path)),
+          library_ { std::move(library) } {
+    LOG_DEBUG("Loaded plugin module '%1%' from %2%", module_name, path);
+}
+
+ActionOutcome PluginModule::callAction(const ActionRequest& request) {
+    auto& action_name = request.action();
+
+    std::unique_ptr<BinaryDataFile> binary_data_file {};
+    auto request_input_txt = getActionInput(request, binary_data_file);
+
+    LOG_INFO("About to execute '%1% %2%' in-process", module_name, action_name);
+    LOG_DEBUG("'%1% %2%' request input: %3%", module_name, action_name,
+              Util::logPayload(request_input_txt));
+
+    char* output_buffer { nullptr };
+    char* error_buffer { nullptr };
+    auto exitcode = library_->call_action(action_name.c_str(),
+                                          request_input_txt.c_str(),
+                                          &output_buffer,
+                                          &error_buffer);
+
+    std::string output { output_buffer ? output_buffer : "" };
+    std::string error { error_buffer ? error_buffer : "" };
+
+    if (output_buffer) {
+        library_->free(output_buffer);
+    }
+
+    if (error_buffer) {
+        library_->free(error_buffer);
+    }
+
+    storeOutput(request, output, error);
+    return processOutput(action_name, exitcode, output, error);
+}
+
+}  // namespace PXPAgent
@@ -1,5 +1,8 @@
 #include <pxp-agent/pxp_connector.hpp>
 #include <pxp-agent/pxp_schemas.hpp>
+#include <pxp-agent/util/checksum.hpp>
+#include <pxp-agent/util/compression.hpp>
+#include <pxp-agent/util/logging.hpp>
 
 #include <cpp-pcp-client/protocol/schemas.hpp>
 
@@ -15,6 +18,9 @@ namespace lth_util = leatherman::util;
 
 static const int DEFAULT_MSG_TIMEOUT_SEC { 2 };
 
+// Results smaller than this are not worth compressing [bytes]
+static const size_t MIN_ENCODED_RESULTS_SIZE { 1024 };
+
 std::vector<lth_jc::JsonContainer> wrapDebug(
         const PCPClient::ParsedChunks& parsed_chunks) {
     auto request_id = parsed_chunks.envelope.get<std::string>("id");
@@ -30,6 +36,58 @@ std::vector<lth_jc::JsonContainer> wrapDebug(
     return debug;
 }
 
+// Return true and set encoded_txt in case the requester accepts the
+// gzip encoding and the results text is at least
+// MIN_ENCODED_RESULTS_SIZE; the text is compressed and Base64 encoded
+static bool encodeResults(const ActionRequest& request,
+                          const std::string& results_txt,
+                          std::string& encoded_txt) {
+    auto& request_data = request.parsedChunks().data;
+
+    if (!request_data.includes("response_encoding")) {
+        return false;
+    }
+
+    auto encoding = request_data.get<std::string>("response_encoding");
+
+    if (encoding != PXPSchemas::GZIP_ENCODING) {
+        LOG_DEBUG("Unsupported response encoding '%1%' requested by %2%; "
+                  "ignoring it", encoding, request.sender());
+        return false;
+    }
+
+    if (results_txt.size() < MIN_ENCODED_RESULTS_SIZE) {
+        return false;
+    }
+
+    try {
+        encoded_txt = Util::encodeBase64(Util::gzipCompress(results_txt));
+        LOG_DEBUG("Compressed the results of request %1% from %2% to %3% bytes",
+                  request.id(), results_txt.size(), encoded_txt.size());
+        return true;
+    } catch (Util::compression_error& e) {
+        LOG_WARNING("Failed to compress the results of request %1%; sending "
+                    "them uncompressed: %2%", request.id(), e.what());
+        return false;
+    }
+}
+
+// Set the results of the response data, encoded by encodeResults()
+// if possible
+static void setResults(lth_jc::JsonContainer& response_data,
+                       const ActionRequest& request,
+                       const lth_jc::JsonContainer& results) {
+    std::string encoded_txt {};
+
+    if (encodeResults(request, results.toString(), encoded_txt)) {
+        response_data.set<std::string>("results_encoding", PXPSchemas::GZIP_ENCODING);
+        response_data.set<std::string>("encoded_results", encoded_txt);
+        return;
+    }
+
+    response_data.set<lth_jc::JsonContainer>("results", results);
+}
+
 PXPConnector::PXPConnector(const Configuration::Agent& agent_configuration)
         : PCPClient::Connector { agent_configuration.server_url,
                                  agent_configuration.client_type,
@@ -38,6 +96,21 @@ PXPConnector::PXPConnector(const Configuration::Agent& agent_configuration)
                                  agent_configuration.key } {
 }
 
+// Log the record of a message sent in reply to the request, in case
+// JSON logging is enabled
+static void logSent(const ActionRequest& request, const std::string& message_type) {
+    if (!Util::jsonLoggingEnabled()) {
+        return;
+    }
+
+    Util::LogContextScope log_context { request.id(), request.transactionId(),
+                                        request.sender(), request.module(),
+                                        request.action() };
+    lth_jc::JsonContainer entries {};
+    entries.set<std::string>("message_type", message_type);
+    Util::logEvent(LEATHERMAN_LOGGING_NAMESPACE, "sent message", entries);
+}
+
 void PXPConnector::sendPCPError(const std::string& request_id,
                                   const std::string& description,
                                   const std::vector<std::string>& endpoints) {
@@ -70,6 +143,7 @@ void PXPConnector::sendPXPError(const ActionRequest& request,
              PXPSchemas::PXP_ERROR_MSG_TYPE,
              DEFAULT_MSG_TIMEOUT_SEC,
              pxp_error_data);
+        logSent(request, PXPSchemas::PXP_ERROR_MSG_TYPE);
         LOG_INFO("Replied to %1% request %2% by %3%, transaction %4%, with "
                  "an PXP error message", requestTypeNames[request.type()],
                  request.id(), request.sender(), request.transactionId());
@@ -81,12 +155,47 @@ void PXPConnector::sendPXPError(const ActionRequest& request,
     }
 }
 
+void PXPConnector::sendPXPError(const std::string& request_id,
+                                const std::string& transaction_id,
+                                const std::string& sender,
+                                const std::string& description,
+                                int retry_after) {
+    lth_jc::JsonContainer pxp_error_data {};
+    pxp_error_data.set<std::string>("transaction_id", transaction_id);
+    pxp_error_data.set<std::string>("id", request_id);
+    pxp_error_data.set<std::string>("description", description);
+
+    if (retry_after > 0) {
+        pxp_error_data.set<int>("retry_after", retry_after);
+    }
+
+    try {
+        send(std::vector<std::string> { sender },
+             PXPSchemas::PXP_ERROR_MSG_TYPE,
+             DEFAULT_MSG_TIMEOUT_SEC,
+             pxp_error_data);
+        if (Util::jsonLoggingEnabled()) {
+            Util::LogContextScope log_context { request_id, transaction_id,
+                                                sender, "", "" };
+            lth_jc::JsonContainer entries {};
+            entries.set<std::string>("message_type", PXPSchemas::PXP_ERROR_MSG_TYPE);
+            Util::logEvent(LEATHERMAN_LOGGING_NAMESPACE, "sent message", entries);
+        }
+        LOG_INFO("Replied to request %1% by %2%, transaction %3%, with a PXP "
+                 "error message", request_id, sender, transaction_id);
+    } catch (PCPClient::connection_error& e) {
+        LOG_ERROR("Failed to send PXP error message for request %1% by %2% "
+                  "(no further sending attempts): %3%",
+                  request_id, sender, e.what());
+    }
+}
+
 void PXPConnector::sendBlockingResponse(const ActionRequest& request,
                                         const lth_jc::JsonContainer& results) {
     auto debug = wrapDebug(request.parsedChunks());
     lth_jc::JsonContainer response_data {};
     response_data.set<std::string>("transaction_id", request.transactionId());
-    response_data.set<lth_jc::JsonContainer>("results", results);
+    setResults(response_data, request, results);
 
     try {
         send(std::vector<std::string> { request.sender() },
@@ -94,6 +203,7 @@ void PXPConnector::sendBlockingResponse(const ActionRequest& request,
              DEFAULT_MSG_TIMEOUT_SEC,
              response_data,
              debug);
+        logSent(request, PXPSchemas::BLOCKING_RESPONSE_TYPE);
     } catch (PCPClient::connection_error& e) {
         LOG_ERROR("Failed to reply to blocking request %1% from %2%, "
                   "transaction %3%: %4%", request.id(), request.sender(),
@@ -107,7 +217,7 @@ void PXPConnector::sendNonBlockingResponse(const ActionRequest& request,
     lth_jc::JsonContainer response_data {};
     response_data.set<std::string>("transaction_id", request.transactionId());
     response_data.set<std::string>("job_id", job_id);
-    response_data.set<lth_jc::JsonContainer>("results", results);
+    setResults(response_data, request, results);
 
     try {
         // NOTE(ale): assuming debug was sent in provisional response
@@ -115,6 +225,7 @@ void PXPConnector::sendNonBlockingResponse(const ActionRequest& request,
              PXPSchemas::NON_BLOCKING_RESPONSE_TYPE,
              DEFAULT_MSG_TIMEOUT_SEC,
              response_data);
+        logSent(request, PXPSchemas::NON_BLOCKING_RESPONSE_TYPE);
         LOG_INFO("Sent response for non-blocking request %1% by %2%, "
                  "transaction %3%", request.id(), request.sender(),
                  request.transactionId());
@@ -126,6 +237,104 @@ void PXPConnector::sendNonBlockingResponse(const ActionRequest& request,
     }
 }
 
+void PXPConnector::sendBatchResponse(const ActionRequest& request,
+                                     const std::vector<lth_jc::JsonContainer>& results) {
+    auto debug = wrapDebug(request.parsedChunks());
+    lth_jc::JsonContainer response_data {};
+    response_data.set<std::string>("transaction_id", request.transactionId());
+    response_data.set<std::vector<lth_jc::JsonContainer>>("results", results);
+
+    try {
+        send(std::vector<std::string> { request.sender() },
+             PXPSchemas::BATCH_RESPONSE_TYPE,
+             DEFAULT_MSG_TIMEOUT_SEC,
+             response_data,
+             debug);
+        logSent(request, PXPSchemas::BATCH_RESPONSE_TYPE);
+        LOG_INFO("Sent response for batch request %1% by %2%, transaction %3%",
+                 request.id(), request.sender(), request.transactionId());
+    } catch (PCPClient::connection_error& e) {
+        LOG_ERROR("Failed to reply to batch request %1% from %2%, "
+                  "transaction %3%: %4%", request.id(), request.sender(),
+                  request.transactionId(), e.what());
+    }
+}
+
+// Return the size of the chunk of the text that starts at offset and
+// has at most max_size bytes, without splitting UTF-8 sequences
+static size_t getChunkSize(const std::string& txt, size_t offset, size_t max_size) {
+    if (offset + max_size >= txt.size()) {
+        return txt.size() - offset;
+    }
+
+    auto size = max_size;
+
+    // Move back while the first byte of the next chunk is a UTF-8
+    // continuation byte (10xxxxxx)
+    while (size > 1 && (static_cast<unsigned char>(txt[offset + size]) & 0xC0) == 0x80) {
+        size--;
+    }
+
+    return size;
+}
+
+void PXPConnector::sendChunkedResponse(const ActionRequest& request,
+                                       const std::string& results_txt,
+                                       size_t chunk_size,
+                                       const std::string& job_id) {
+    assert(chunk_size > 0);
+    int sequence { 0 };
+
+    // NB: the results are encoded before being chunked, so that the
+    // chunks carry the encoded text
+    std::string encoded_txt {};
+    auto encoded = encodeResults(request, results_txt, encoded_txt);
+    const auto& chunked_txt = encoded ? encoded_txt : results_txt;
+
+    try {
+        for (size_t offset = 0; offset < chunked_txt.size(); sequence++) {
+            auto size = getChunkSize(chunked_txt, offset, chunk_size);
+            lth_jc::JsonContainer chunk_data {};
+            chunk_data.set<std::string>("transaction_id", request.transactionId());
+            chunk_data.set<int>("sequence", sequence);
+            chunk_data.set<std::string>("data", chunked_txt.substr(offset, size));
+
+            send(std::vector<std::string> { request.sender() },
+                 PXPSchemas::RESPONSE_CHUNK_TYPE,
+                 DEFAULT_MSG_TIMEOUT_SEC,
+                 chunk_data);
+            offset += size;
+        }
+
+        lth_jc::JsonContainer end_data {};
+        end_data.set<std::string>("transaction_id", request.transactionId());
+        if (!job_id.empty()) {
+            end_data.set<std::string>("job_id", job_id);
+        }
+        if (encoded) {
+            end_data.set<std::string>("results_encoding", PXPSchemas::GZIP_ENCODING);
+        }
+        end_data.set<int>("num_chunks", sequence);
+        end_data.set<int>("size", static_cast<int>(chunked_txt.size()));
+        end_data.set<std::string>("sha256", Util::getSha256(chunked_txt));
+
+        send(std::vector<std::string> { request.sender() },
+             PXPSchemas::RESPONSE_END_TYPE,
+             DEFAULT_MSG_TIMEOUT_SEC,
+             end_data,
+             wrapDebug(request.parsedChunks()));
+        logSent(request, PXPSchemas::RESPONSE_END_TYPE);
+        LOG_INFO("Sent chunked response (%1% chunks) for %2% request %3% by "
+                 "%4%, transaction %5%", sequence, requestTypeNames[request.type()],
+                 request.id(), request.sender(), request.transactionId());
+    } catch (PCPClient::connection_error& e) {
+        LOG_ERROR("Failed to send chunk %1% of the response to %2% request %3% "
+                  "by %4%, transaction %5% (no further attempts): %6%",
+                  sequence, requestTypeNames[request.type()], request.id(),
+                  request.sender(), request.transactionId(), e.what());
+    }
+}
+
 void PXPConnector::sendProvisionalResponse(const ActionRequest& request) {
     auto debug = wrapDebug(request.parsedChunks());
     lth_jc::JsonContainer provisional_data {};
@@ -137,6 +346,7 @@ void PXPConnector::sendProvisionalResponse(const ActionRequest& request) {
              DEFAULT_MSG_TIMEOUT_SEC,
              provisional_data,
              debug);
+        logSent(request, PXPSchemas::PROVISIONAL_RESPONSE_TYPE);
         LOG_INFO("Sent provisional response for request %1% by %2%, "
                  "transaction %3%", request.id(), request.sender(),
                  request.transactionId());
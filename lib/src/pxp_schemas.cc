@@ -18,6 +18,8 @@ PCPClient::Schema BlockingRequestSchema() {
     schema.addConstraint("module", T_Constraint::String, true);
     schema.addConstraint("action", T_Constraint::String, true);
     schema.addConstraint("params", T_Constraint::Object, false);
+    // Encoding the requester accepts for the response results
+    schema.addConstraint("response_encoding", T_Constraint::String, false);
     return schema;
 }
 
@@ -25,7 +27,11 @@ PCPClient::Schema BlockingResponseSchema() {
     PCPClient::Schema schema { BLOCKING_RESPONSE_TYPE, C_Type::Json };
     // NB: additionalProperties = false
     schema.addConstraint("transaction_id", T_Constraint::String, true);
-    schema.addConstraint("results", T_Constraint::Object, true);
+    // NB: in case the results are encoded, 'encoded_results' is
+    // included instead of 'results'
+    schema.addConstraint("results", T_Constraint::Object, false);
+    schema.addConstraint("results_encoding", T_Constraint::String, false);
+    schema.addConstraint("encoded_results", T_Constraint::String, false);
     return schema;
 }
 
@@ -37,6 +43,8 @@ PCPClient::Schema NonBlockingRequestSchema() {
     schema.addConstraint("module", T_Constraint::String, true);
     schema.addConstraint("action", T_Constraint::String, true);
     schema.addConstraint("params", T_Constraint::Object, false);
+    // Encoding the requester accepts for the response results
+    schema.addConstraint("response_encoding", T_Constraint::String, false);
     return schema;
 }
 
@@ -45,7 +53,11 @@ PCPClient::Schema NonBlockingResponseSchema() {
     // NB: additionalProperties = false
     schema.addConstraint("transaction_id", T_Constraint::String, true);
     schema.addConstraint("job_id", T_Constraint::String, true);
-    schema.addConstraint("results", T_Constraint::Object, true);
+    // NB: in case the results are encoded, 'encoded_results' is
+    // included instead of 'results'
+    schema.addConstraint("results", T_Constraint::Object, false);
+    schema.addConstraint("results_encoding", T_Constraint::String, false);
+    schema.addConstraint("encoded_results", T_Constraint::String, false);
     return schema;
 }
 
@@ -56,12 +68,73 @@ PCPClient::Schema ProvisionalResponseSchema() {
     return schema;
 }
 
+PCPClient::Schema BlockingBinaryRequestSchema() {
+    // NB: the header of the binary data is validated by ActionRequest
+    return PCPClient::Schema { BLOCKING_BINARY_REQUEST_TYPE, C_Type::Binary };
+}
+
+PCPClient::Schema NonBlockingBinaryRequestSchema() {
+    // NB: the header of the binary data is validated by ActionRequest
+    return PCPClient::Schema { NON_BLOCKING_BINARY_REQUEST_TYPE, C_Type::Binary };
+}
+
+PCPClient::Schema BatchRequestSchema() {
+    PCPClient::Schema schema { BATCH_REQUEST_TYPE, C_Type::Json };
+    // NB: additionalProperties = false
+    schema.addConstraint("transaction_id", T_Constraint::String, true);
+    schema.addConstraint("actions", T_Constraint::Array, true);
+    schema.addConstraint("parallel", T_Constraint::Bool, false);
+
+    // 'actions' is an array of module/action/params entries
+    PCPClient::Schema action_schema { "batch_action", C_Type::Json };
+    action_schema.addConstraint("module", T_Constraint::String, true);
+    action_schema.addConstraint("action", T_Constraint::String, true);
+    action_schema.addConstraint("params", T_Constraint::Object, false);
+
+    schema.addConstraint("actions", action_schema, false);
+    return schema;
+}
+
+PCPClient::Schema BatchResponseSchema() {
+    PCPClient::Schema schema { BATCH_RESPONSE_TYPE, C_Type::Json };
+    // NB: additionalProperties = false
+    schema.addConstraint("transaction_id", T_Constraint::String, true);
+    schema.addConstraint("results", T_Constraint::Array, true);
+    return schema;
+}
+
+PCPClient::Schema ResponseChunkSchema() {
+    PCPClient::Schema schema { RESPONSE_CHUNK_TYPE, C_Type::Json };
+    // NB: additionalProperties = false
+    schema.addConstraint("transaction_id", T_Constraint::String, true);
+    schema.addConstraint("sequence", T_Constraint::Int, true);
+    schema.addConstraint("data", T_Constraint::String, true);
+    return schema;
+}
+
+PCPClient::Schema ResponseEndSchema() {
+    PCPClient::Schema schema { RESPONSE_END_TYPE, C_Type::Json };
+    // NB: additionalProperties = false
+    schema.addConstraint("transaction_id", T_Constraint::String, true);
+    // Included for non-blocking responses
+    schema.addConstraint("job_id", T_Constraint::String, false);
+    // Included in case the chunked text is encoded
+    schema.addConstraint("results_encoding", T_Constraint::String, false);
+    schema.addConstraint("num_chunks", T_Constraint::Int, true);
+    schema.addConstraint("size", T_Constraint::Int, true);
+    schema.addConstraint("sha256", T_Constraint::String, true);
+    return schema;
+}
+
 PCPClient::Schema PXPErrorSchema() {
     PCPClient::Schema schema { PXP_ERROR_MSG_TYPE, C_Type::Json };
     // NB: additionalProperties = false
     schema.addConstraint("transaction_id", T_Constraint::String, true);
     schema.addConstraint("id", T_Constraint::String, true);
     schema.addConstraint("description", T_Constraint::String, true);
+    // Seconds after which a request rejected by the rate limits
+    // would be accepted
+    schema.addConstraint("retry_after", T_Constraint::Int, false);
     return schema;
 }
 
@@ -1,10 +1,22 @@
 #include <pxp-agent/request_processor.hpp>
 #include <pxp-agent/action_outcome.hpp>
+#include <pxp-agent/job_journal.hpp>
+#include <pxp-agent/results_storage.hpp>
 #include <pxp-agent/pxp_schemas.hpp>
 #include <pxp-agent/external_module.hpp>
+#ifdef PXP_AGENT_WITH_LUA
+#include <pxp-agent/lua_module.hpp>
+#endif
 #include <pxp-agent/modules/echo.hpp>
+#include <pxp-agent/modules/file_transfer.hpp>
 #include <pxp-agent/modules/ping.hpp>
 #include <pxp-agent/modules/status.hpp>
+#include <pxp-agent/util/logging.hpp>
+
+#ifndef _WIN32
+#include <pxp-agent/plugin_module.hpp>
+#include <pxp-agent/util/posix/process.hpp>
+#endif
 
 #include <leatherman/json_container/json_container.hpp>
 #include <leatherman/file_util/file.hpp>
@@ -13,6 +25,7 @@
 #include <leatherman/util/timer.hpp>
 
 #include <cpp-pcp-client/util/thread.hpp>
+#include <cpp-pcp-client/util/chrono.hpp>
 
 #define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.request_processor"
 #include <leatherman/logging/logging.hpp>
@@ -20,7 +33,9 @@
 #include <boost/filesystem/operations.hpp>
 
 #include <vector>
-#include <atomic>
+#include <algorithm>  // max()
+#include <cmath>  // ceil()
+#include <ctime>
 #include <functional>
 #include <stdexcept>  // out_of_range
 
@@ -32,99 +47,29 @@ namespace lth_file = leatherman::file_util;
 namespace lth_util = leatherman::util;
 
 //
-// Results Storage
+// Non-blocking action task
 //
 
-class ResultsStorage {
-  public:
-    struct Error : public std::runtime_error {
-        explicit Error(std::string const& msg) : std::runtime_error(msg) {}
-    };
-
-    // Throw a ResultsStorage::Error in case of failure while writing
-    // to any of result files
-    ResultsStorage(const ActionRequest& request, const std::string& results_dir)
-            : module { request.module() },
-              action { request.action() },
-              out_path { results_dir + "/stdout" },
-              err_path { results_dir + "/stderr" },
-              status_path { results_dir + "/status" },
-              action_status {} {
-        initialize(request, results_dir);
-    }
-
-    void write(const ActionOutcome& outcome, const std::string& exec_error,
-               const std::string& duration) {
-        action_status.set<std::string>("status", "completed");
-        action_status.set<std::string>("duration", duration);
-        action_status.set<int>("exitcode", outcome.exitcode);
-        lth_file::atomic_write_to_file(action_status.toString() + "\n", status_path);
-
-        if (exec_error.empty()) {
-            if (outcome.type == ActionOutcome::Type::External) {
-                lth_file::atomic_write_to_file(outcome.std_out + "\n", out_path);
-                if (!outcome.std_err.empty()) {
-                    lth_file::atomic_write_to_file(outcome.std_err + "\n", err_path);
-                }
-            } else {
-                // ActionOutcome::Type::Internal
-                lth_file::atomic_write_to_file(outcome.results.toString()
-                                               + "\n", out_path);
-            }
-        } else {
-            lth_file::atomic_write_to_file(exec_error, err_path);
-        }
-    }
-
-  private:
-    std::string module;
-    std::string action;
-    std::string out_path;
-    std::string err_path;
-    std::string status_path;
-    lth_jc::JsonContainer action_status;
-
-    void initialize(const ActionRequest& request, const std::string results_dir) {
-        if (!fs::exists(results_dir)) {
-            LOG_DEBUG("Creating results directory for '%1% %2%', transaction "
-                       "%3%, in '%4%'", request.module(), request.action(),
-                       request.transactionId(), results_dir);
-            try {
-                fs::create_directories(results_dir);
-            } catch (const fs::filesystem_error& e) {
-                std::string err_msg { "failed to create results directory: " };
-                throw Error { err_msg + e.what() };
-            }
-        }
-
-        action_status.set<std::string>("module", module);
-        action_status.set<std::string>("action", action);
-        action_status.set<std::string>("status", "running");
-        action_status.set<std::string>("duration", "0 s");
-        action_status.set<int>("exitcode", EXIT_SUCCESS);
-
-        if (!request.paramsTxt().empty()) {
-            action_status.set<std::string>("input", request.paramsTxt());
-        } else {
-            action_status.set<std::string>("input", "none");
-        }
-
-        lth_file::atomic_write_to_file("", out_path);
-        lth_file::atomic_write_to_file("", err_path);
-        lth_file::atomic_write_to_file(action_status.toString() + "\n", status_path);
+// Move the results of the completed job to the journal; in case of
+// failure, they're left in the results directory and moved when
+// pxp-agent restarts
+static void archiveJob(ResultsStorage& results_storage, JobJournal& journal) {
+    try {
+        results_storage.archive(journal);
+    } catch (const ResultsStorage::Error& e) {
+        LOG_ERROR("Failed to move the job results in %1% to the journal: %2%",
+                  results_storage.resultsDir(), e.what());
     }
-};
-
-//
-// Non-blocking action task
-//
+}
 
 void nonBlockingActionTask(std::shared_ptr<Module> module_ptr,
                            ActionRequest request,
                            std::string job_id,
                            ResultsStorage results_storage,
                            std::shared_ptr<PXPConnector> connector_ptr,
-                           std::shared_ptr<std::atomic<bool>> done) {
+                           size_t response_chunk_size,
+                           size_t spool_compression_threshold,
+                           std::shared_ptr<JobJournal> journal) {
     lth_util::Timer timer {};
     std::string exec_error {};
     ActionOutcome outcome {};
@@ -133,8 +78,21 @@ void nonBlockingActionTask(std::shared_ptr<Module> module_ptr,
         outcome = module_ptr->executeAction(request);
 
         if (request.parsedChunks().data.get<bool>("notify_outcome")) {
-            connector_ptr->sendNonBlockingResponse(request, outcome.results, job_id);
+            auto results_txt = outcome.results.toString();
+
+            if (response_chunk_size > 0 && results_txt.size() > response_chunk_size) {
+                connector_ptr->sendChunkedResponse(request, results_txt,
+                                                   response_chunk_size, job_id);
+            } else {
+                connector_ptr->sendNonBlockingResponse(request, outcome.results,
+                                                       job_id);
+            }
         }
+    } catch (Module::ResourceLimitError& e) {
+        results_storage.setLimitExceeded(e.limit);
+        connector_ptr->sendPXPError(request, e.what());
+        exec_error = "Failed to execute '" + request.module() + " "
+                     + request.action() + "': " + e.what() + "\n";
     } catch (Module::ProcessingError& e) {
         connector_ptr->sendPXPError(request, e.what());
         exec_error = "Failed to execute '" + request.module() + " "
@@ -149,10 +107,73 @@ void nonBlockingActionTask(std::shared_ptr<Module> module_ptr,
     auto duration = std::to_string(timer.elapsed_seconds()) + " s";
     results_storage.write(outcome, exec_error, duration);
 
-    // Flag end of processing
-    *done = true;
+    if (journal) {
+        archiveJob(results_storage, *journal);
+    } else if (spool_compression_threshold > 0) {
+        results_storage.compressOutput(spool_compression_threshold);
+    }
 }
 
+//
+// Orphaned jobs
+//
+
+// Interval between checks on the process of an orphaned job [ms]
+static const uint32_t ORPHANED_JOB_CHECK_INTERVAL_MS { 1000 };
+
+// Store the outcome of a job whose process was spawned by a previous
+// pxp-agent instance and is no longer executing. The duration is
+// estimated by the time of the last update of the status file,
+// which is written when the job starts. The results are then moved to
+// the journal, if used.
+void completeOrphanedJob(ResultsStorage& results_storage,
+                         const std::shared_ptr<JobJournal>& journal) {
+    auto& results_dir = results_storage.resultsDir();
+    int exitcode;
+
+    if (ResultsStorage::readExitcode(results_dir, exitcode)) {
+        auto start_time = fs::last_write_time(
+            results_dir + "/" + ResultsStorage::STATUS_FILE);
+        auto duration = std::to_string(std::time(nullptr) - start_time) + " s";
+        LOG_INFO("The orphaned job in %1% completed with exit code %2%",
+                 results_dir, exitcode);
+        results_storage.writeRecovered(exitcode, duration);
+    } else {
+        LOG_WARNING("The orphaned job in %1% is no longer executing and its "
+                    "exit code is unknown; flagging it as failed", results_dir);
+        results_storage.markFailed("pxp-agent was restarted while the job was "
+                                   "executing; the job outcome is unknown");
+    }
+
+    if (journal) {
+        archiveJob(results_storage, *journal);
+    }
+}
+
+#ifndef _WIN32
+
+// Wait for the termination of the process of an orphaned job (it's
+// not a child of this pxp-agent instance, so we poll) and then store
+// the job outcome
+void orphanedJobTask(ResultsStorage results_storage,
+                     int pid,
+                     std::string start_time,
+                     std::shared_ptr<JobJournal> journal) {
+    while (Util::isProcessExecuting(pid, start_time)) {
+        PCPClient::Util::this_thread::sleep_for(
+            PCPClient::Util::chrono::milliseconds(ORPHANED_JOB_CHECK_INTERVAL_MS));
+    }
+
+    try {
+        completeOrphanedJob(results_storage, journal);
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to store the outcome of the orphaned job in %1%: %2%",
+                  results_storage.resultsDir(), e.what());
+    }
+}
+
+#endif  // _WIN32
+
 //
 // Public interface
 //
@@ -162,31 +183,83 @@ RequestProcessor::RequestProcessor(std::shared_ptr<PXPConnector> connector_ptr,
         : thread_container_ { "Action Executer" },
           connector_ptr_ { connector_ptr },
           spool_dir_ { agent_configuration.spool_dir },
-          modules_ {},
+          journal_ {},
+          modules_ { new ModulesMap() },
+          modules_mutex_ {},
+          internal_modules_ {},
+          modules_dir_ { agent_configuration.modules_dir },
           modules_config_dir_ { agent_configuration.modules_config_dir },
-          modules_config_ {} {
+          file_transfer_dir_ { agent_configuration.file_transfer_dir },
+          modules_config_ {},
+          external_modules_state_ {},
+          reload_mutex_ {},
+          response_chunk_size_ { agent_configuration.response_chunk_size },
+          spool_compression_threshold_ { agent_configuration.spool_compression_threshold },
+          rate_limiter_ { agent_configuration.global_rate_limit / 60.0,
+                          agent_configuration.rate_limit / 60.0,
+                          static_cast<double>(agent_configuration.rate_limit_burst) },
+          max_request_size_ { agent_configuration.max_request_size } {
     assert(!spool_dir_.empty());
+    ResultsStorage::setSyncWrites(agent_configuration.spool_sync);
+
+    if (agent_configuration.spool_format == "journal") {
+        // NB: the completed jobs of the spool directory, e.g. stored
+        // before switching to the journal, are moved to it
+        journal_ = std::make_shared<JobJournal>(spool_dir_,
+                                                agent_configuration.spool_sync);
+        journal_->migrate();
+    }
 
     // NB: certificate paths have been validated by HW
 
-    loadModulesConfiguration();
     loadInternalModules();
+    loadModules();
 
-    if (!agent_configuration.modules_dir.empty()) {
-        loadExternalModulesFrom(agent_configuration.modules_dir);
-    } else {
-        LOG_WARNING("The modules directory was not provided; no external "
-                    "module will be loaded");
+    recoverOrphanedJobs();
+
+#ifndef _WIN32
+    try {
+        watcher_.reset(new Util::DirectoryWatcher(
+            { modules_dir_, modules_config_dir_ },
+            [this]() { reloadModules(); }));
+    } catch (const std::exception& e) {
+        LOG_WARNING("Failed to start watching the modules directories; "
+                    "modules won't be reloaded: %1%", e.what());
     }
+#endif
+}
+
+// Size of the request data [bytes]: its binary data plus the text of
+// its params, that the request serializes once and caches (the text
+// is also passed to external modules and stored with the metadata of
+// non-blocking jobs)
+static size_t getRequestSize(const ActionRequest& request) {
+    return request.binaryData().size() + request.paramsTxt().size();
+}
 
-    logLoadedModules();
+void RequestProcessor::checkRequestSize(size_t size) const {
+    if (max_request_size_ > 0 && size > max_request_size_) {
+        throw RequestProcessor::Error { "request data exceeds the maximum size "
+                                        "of " + std::to_string(max_request_size_)
+                                        + " bytes" };
+    }
 }
 
 void RequestProcessor::processRequest(const RequestType& request_type,
                                       const PCPClient::ParsedChunks& parsed_chunks) {
+    if (!preDispatch(request_type, parsed_chunks)) {
+        return;
+    }
+
     try {
         // Inspect and validate the request message format
         ActionRequest request { request_type, parsed_chunks };
+        Util::LogContextScope log_context { request.id(), request.transactionId(),
+                                            request.sender(), request.module(),
+                                            request.action() };
+        Util::LogEventScope log_event { LEATHERMAN_LOGGING_NAMESPACE,
+                                        "processed " + requestTypeNames[request_type]
+                                        + " request" };
 
         LOG_INFO("About to process %1% request %2% by %3%, transaction %4%",
                  requestTypeNames[request_type], request.id(), request.sender(),
@@ -194,7 +267,13 @@ void RequestProcessor::processRequest(const RequestType& request_type,
 
         try {
             // We can access the request content; validate it
-            validateRequestContent(request);
+            // NB: the entries of batch requests are validated one by
+            // one, so that an invalid entry does not prevent the
+            // execution of the others
+            if (request.type() != RequestType::Batch) {
+                checkRequestSize(getRequestSize(request));
+                validateRequestContent(request);
+            }
         } catch (RequestProcessor::Error& e) {
             // Invalid request; send *PXP error*
 
@@ -202,12 +281,15 @@ void RequestProcessor::processRequest(const RequestType& request_type,
                       requestTypeNames[request_type], request.id(),
                       request.sender(), request.transactionId(), e.what());
             connector_ptr_->sendPXPError(request, e.what());
+            log_event.fail();
             return;
         }
 
         try {
             if (request.type() == RequestType::Blocking) {
                 processBlockingRequest(request);
+            } else if (request.type() == RequestType::Batch) {
+                processBatchRequest(request);
             } else {
                 processNonBlockingRequest(request);
             }
@@ -217,6 +299,7 @@ void RequestProcessor::processRequest(const RequestType& request_type,
                       "%5%", requestTypeNames[request.type()], request.id(),
                       request.sender(), request.transactionId(), e.what());
             connector_ptr_->sendPXPError(request, e.what());
+            log_event.fail();
         }
     } catch (ActionRequest::Error& e) {
         // Failed to instantiate ActionRequest - bad message; send *PCP error*
@@ -229,19 +312,153 @@ void RequestProcessor::processRequest(const RequestType& request_type,
     }
 }
 
+void RequestProcessor::reloadModules() {
+    LOG_INFO("Reloading modules");
+    loadModules();
+}
+
 //
 // Private interface
 //
 
+// Retrieve the transaction_id, module, and action entries of the
+// request data or, for binary data, of its header line; the entries
+// that can't be retrieved are left empty
+static void peekRequest(const PCPClient::ParsedChunks& parsed_chunks,
+                        std::string& transaction_id,
+                        std::string& module_name,
+                        std::string& action_name) {
+    if (!parsed_chunks.has_data || parsed_chunks.invalid_data) {
+        return;
+    }
+
+    lth_jc::JsonContainer header {};
+    const lth_jc::JsonContainer* data = &parsed_chunks.data;
+
+    if (parsed_chunks.data_type != PCPClient::ContentType::Json) {
+        auto header_end = parsed_chunks.binary_data.find('\n');
+
+        if (header_end == std::string::npos) {
+            return;
+        }
+
+        try {
+            header = lth_jc::JsonContainer {
+                parsed_chunks.binary_data.substr(0, header_end) };
+        } catch (lth_jc::data_parse_error& e) {
+            return;
+        }
+
+        data = &header;
+    }
+
+    auto getEntry = [data](const std::string& key) -> std::string {
+        if (data->includes(key)
+                && data->type(key) == lth_jc::DataType::String) {
+            return data->get<std::string>(key);
+        }
+        return "";
+    };
+
+    transaction_id = getEntry("transaction_id");
+    module_name = getEntry("module");
+    action_name = getEntry("action");
+}
+
+bool RequestProcessor::preDispatch(const RequestType& request_type,
+                                   const PCPClient::ParsedChunks& parsed_chunks) {
+    auto id = parsed_chunks.envelope.get<std::string>("id");
+    auto sender = parsed_chunks.envelope.get<std::string>("sender");
+    std::string transaction_id {};
+    std::string module_name {};
+    std::string action_name {};
+
+    peekRequest(parsed_chunks, transaction_id, module_name, action_name);
+
+    auto reject = [&](const std::string& description, int retry_after) -> bool {
+        LOG_WARNING("Rejecting %1% request %2% by %3%, transaction %4%: %5%",
+                    requestTypeNames[request_type], id, sender, transaction_id,
+                    description);
+        connector_ptr_->sendPXPError(id, transaction_id, sender, description,
+                                     retry_after);
+        return false;
+    };
+
+    if (rate_limiter_.enabled()) {
+        // NB: a batch request takes a token for each of its actions,
+        // so that batching doesn't bypass the rate limits
+        unsigned int num_tokens { 1 };
+
+        if (request_type == RequestType::Batch && parsed_chunks.has_data
+                && !parsed_chunks.invalid_data
+                && parsed_chunks.data.includes("actions")
+                && parsed_chunks.data.type("actions") == lth_jc::DataType::Array) {
+            num_tokens = std::max(static_cast<unsigned int>(
+                                      parsed_chunks.data.size("actions")),
+                                  1u);
+        }
+
+        if (num_tokens > rate_limiter_.burst()) {
+            return reject("the batch contains " + std::to_string(num_tokens)
+                          + " actions; the rate limits accept at most "
+                          + std::to_string(static_cast<int>(rate_limiter_.burst()))
+                          + " at once",
+                          0);
+        }
+
+        auto wait_s = rate_limiter_.acquire(sender, num_tokens);
+
+        if (wait_s > 0) {
+            auto retry_after = static_cast<int>(std::ceil(wait_s));
+            return reject("rate limit exceeded; retry after "
+                          + std::to_string(retry_after) + " s",
+                          retry_after);
+        }
+    }
+
+    // NB: the entries of batch requests are validated one by one
+    if (request_type == RequestType::Batch || module_name.empty()) {
+        return true;
+    }
+
+    auto modules = getModules();
+    auto module_itr = modules->find(module_name);
+
+    if (module_itr == modules->end()) {
+        return reject("unknown module: " + module_name, 0);
+    }
+
+    if (!action_name.empty() && !module_itr->second->hasAction(action_name)) {
+        return reject("unknown action '" + action_name + "' for module "
+                      + module_name, 0);
+    }
+
+    return true;
+}
+
+std::shared_ptr<const RequestProcessor::ModulesMap> RequestProcessor::getModules() {
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { modules_mutex_ };
+    return modules_;
+}
+
+std::shared_ptr<Module> RequestProcessor::getModule(const std::string& module_name) {
+    auto modules = getModules();
+    auto module_itr = modules->find(module_name);
+
+    if (module_itr == modules->end()) {
+        throw RequestProcessor::Error { "unknown module: " + module_name };
+    }
+
+    return module_itr->second;
+}
+
 void RequestProcessor::validateRequestContent(const ActionRequest& request) {
     // Validate requested module and action
-    try {
-        if (!modules_.at(request.module())->hasAction(request.action())) {
-            throw RequestProcessor::Error { "unknown action '" + request.action()
-                                            + "' for module " + request.module() };
-        }
-    } catch (std::out_of_range& e) {
-        throw RequestProcessor::Error { "unknown module: " + request.module() };
+    auto module_ptr = getModule(request.module());
+
+    if (!module_ptr->hasAction(request.action())) {
+        throw RequestProcessor::Error { "unknown action '" + request.action()
+                                        + "' for module " + request.module() };
     }
 
     // Validate request input params
@@ -251,7 +468,7 @@ void RequestProcessor::validateRequestContent(const ActionRequest& request) {
                   request.id(), request.sender(), request.transactionId());
 
         // NB: the registred schemas have the same name as the action
-        auto& validator = modules_.at(request.module())->input_validator_;
+        auto& validator = module_ptr->input_validator_;
         validator.validate(request.params(), request.action());
     } catch (PCPClient::validation_error& e) {
         LOG_DEBUG("Invalid '%1% %2%' request %3%: %4%", request.module(),
@@ -263,11 +480,99 @@ void RequestProcessor::validateRequestContent(const ActionRequest& request) {
 
 void RequestProcessor::processBlockingRequest(const ActionRequest& request) {
     // Execute action; possible request errors will be propagated
-    auto outcome = modules_[request.module()]->executeAction(request);
+    auto outcome = getModule(request.module())->executeAction(request);
+
+    if (response_chunk_size_ > 0) {
+        auto results_txt = outcome.results.toString();
+
+        if (results_txt.size() > response_chunk_size_) {
+            connector_ptr_->sendChunkedResponse(request, results_txt,
+                                                response_chunk_size_);
+            return;
+        }
+    }
 
     connector_ptr_->sendBlockingResponse(request, outcome.results);
 }
 
+// Maximum number of actions of a batch request
+static const size_t MAX_BATCH_SIZE { 64 };
+
+void RequestProcessor::processBatchRequest(const ActionRequest& request) {
+    auto entries = request.batchEntries();
+
+    if (entries.size() > MAX_BATCH_SIZE) {
+        throw RequestProcessor::Error { "the batch contains "
+                                        + std::to_string(entries.size())
+                                        + " actions; the maximum is "
+                                        + std::to_string(MAX_BATCH_SIZE) };
+    }
+
+    size_t size { 0 };
+    for (const auto& entry : entries) {
+        size += getRequestSize(entry);
+    }
+    checkRequestSize(size);
+
+    auto& data = request.parsedChunks().data;
+    auto parallel = data.includes("parallel") && data.get<bool>("parallel");
+    std::vector<lth_jc::JsonContainer> results(entries.size());
+
+    LOG_DEBUG("Executing %1% actions of batch request %2% by %3%%4%",
+              entries.size(), request.id(), request.sender(),
+              (parallel ? " in parallel" : ""));
+
+    if (parallel && entries.size() > 1) {
+        std::vector<PCPClient::Util::thread> threads {};
+
+        for (size_t idx = 0; idx < entries.size(); idx++) {
+            try {
+                threads.push_back(PCPClient::Util::thread {
+                    [this, &entries, &results, idx]() {
+                        results[idx] = processBatchEntry(entries[idx]);
+                    } });
+            } catch (std::exception& e) {
+                LOG_WARNING("Failed to start a thread for action %1% of batch "
+                            "request %2%; executing it sequentially: %3%",
+                            idx, request.id(), e.what());
+                results[idx] = processBatchEntry(entries[idx]);
+            }
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    } else {
+        for (size_t idx = 0; idx < entries.size(); idx++) {
+            results[idx] = processBatchEntry(entries[idx]);
+        }
+    }
+
+    connector_ptr_->sendBatchResponse(request, results);
+}
+
+lth_jc::JsonContainer RequestProcessor::processBatchEntry(const ActionRequest& entry) {
+    lth_jc::JsonContainer result {};
+    result.set<std::string>("module", entry.module());
+    result.set<std::string>("action", entry.action());
+
+    try {
+        validateRequestContent(entry);
+        auto outcome = getModule(entry.module())->executeAction(entry);
+        result.set<lth_jc::JsonContainer>("results", outcome.results);
+    } catch (RequestProcessor::Error& e) {
+        LOG_ERROR("Invalid '%1% %2%' action of batch request %3%: %4%",
+                  entry.module(), entry.action(), entry.id(), e.what());
+        result.set<std::string>("error", e.what());
+    } catch (Module::ProcessingError& e) {
+        LOG_ERROR("Failed to execute '%1% %2%' action of batch request %3%: %4%",
+                  entry.module(), entry.action(), entry.id(), e.what());
+        result.set<std::string>("error", e.what());
+    }
+
+    return result;
+}
+
 void RequestProcessor::processNonBlockingRequest(const ActionRequest& request) {
     fs::path spool_path { spool_dir_ };
     std::string results_dir { (spool_path / request.transactionId()).string() };
@@ -278,17 +583,19 @@ void RequestProcessor::processNonBlockingRequest(const ActionRequest& request) {
               request.transactionId(), request.id(), request.sender());
 
     try {
-        // Flag to enable signaling from task to thread_container
-        auto done = std::make_shared<std::atomic<bool>>(false);
-
-        thread_container_.add(PCPClient::Util::thread(&nonBlockingActionTask,
-                                                      modules_[request.module()],
-                                                      request,
-                                                      request.transactionId(),
-                                                      ResultsStorage { request, results_dir },
-                                                      connector_ptr_,
-                                                      done),
-                              done);
+        // The module will store the action output in the results dir
+        ActionRequest job_request { request };
+        job_request.setResultsDir(results_dir);
+
+        thread_container_.add(std::bind(&nonBlockingActionTask,
+                                        getModule(request.module()),
+                                        job_request,
+                                        request.transactionId(),
+                                        ResultsStorage { request, results_dir },
+                                        connector_ptr_,
+                                        response_chunk_size_,
+                                        spool_compression_threshold_,
+                                        journal_));
     } catch (ResultsStorage::Error& e) {
         // Failed to instantiate ResultsStorage
         LOG_ERROR("Failed to initialize the result files for '%1% %2%' action "
@@ -309,9 +616,61 @@ void RequestProcessor::processNonBlockingRequest(const ActionRequest& request) {
     }
 }
 
+void RequestProcessor::recoverOrphanedJobs() {
+    if (!fs::is_directory(spool_dir_)) {
+        return;
+    }
+
+    fs::directory_iterator end;
+
+    for (auto d = fs::directory_iterator(spool_dir_); d != end; ++d) {
+        if (!fs::is_directory(d->status())
+                || d->path().filename().string() == JobJournal::DIRECTORY_NAME) {
+            continue;
+        }
+
+        auto results_dir = d->path().string();
+
+        try {
+            ResultsStorage results_storage { results_dir };
+
+            if (!results_storage.isRunning()) {
+                continue;
+            }
+
+#ifndef _WIN32
+            int pid;
+            std::string start_time;
+
+            if (ResultsStorage::readProcessInfo(results_dir, pid, start_time)
+                    && Util::isProcessExecuting(pid, start_time)) {
+                LOG_INFO("The job of transaction %1% is still executing with "
+                         "PID %2%; waiting for its completion",
+                         d->path().filename().string(), pid);
+                thread_container_.add(std::bind(&orphanedJobTask,
+                                                results_storage,
+                                                pid,
+                                                start_time,
+                                                journal_));
+                continue;
+            }
+#endif  // _WIN32
+
+            completeOrphanedJob(results_storage, journal_);
+        } catch (const ResultsStorage::Error& e) {
+            LOG_WARNING("Failed to inspect the job results in %1%: %2%",
+                        results_dir, e.what());
+        } catch (const std::exception& e) {
+            LOG_ERROR("Failed to recover the job in %1%: %2%",
+                      results_dir, e.what());
+        }
+    }
+}
+
 void RequestProcessor::loadModulesConfiguration() {
     LOG_INFO("Loading external modules configuration from %1%",
              modules_config_dir_);
+    modules_config_.clear();
 
     if (fs::is_directory(modules_config_dir_)) {
         lth_file::each_file(
@@ -344,13 +703,53 @@ void RequestProcessor::loadModulesConfiguration() {
 
 void RequestProcessor::loadInternalModules() {
     // HERE(ale): no external configuration for internal modules
-    modules_["echo"] = std::shared_ptr<Module>(new Modules::Echo);
-    modules_["ping"] = std::shared_ptr<Module>(new Modules::Ping);
-    modules_["status"] = std::shared_ptr<Module>(new Modules::Status);
+    internal_modules_["echo"] = std::shared_ptr<Module>(new Modules::Echo);
+    internal_modules_["file_transfer"] =
+        std::shared_ptr<Module>(new Modules::FileTransfer(file_transfer_dir_));
+    internal_modules_["ping"] = std::shared_ptr<Module>(new Modules::Ping);
+    internal_modules_["status"] = std::shared_ptr<Module>(new Modules::Status(journal_));
+}
+
+// Return the name of the module provided by the specified file;
+// plugins and scripts are named after the file stem
+static std::string getModuleName(const fs::path& file_path) {
+    auto suffix = file_path.extension().string();
+#ifndef _WIN32
+    if (suffix == PluginModule::PLUGIN_SUFFIX) {
+        return file_path.stem().string();
+    }
+#endif
+#ifdef PXP_AGENT_WITH_LUA
+    if (suffix == LuaModule::SCRIPT_SUFFIX) {
+        return file_path.stem().string();
+    }
+#endif
+    return file_path.filename().string();
 }
 
-void RequestProcessor::loadExternalModulesFrom(fs::path dir_path) {
+// Instantiate the module provided by the specified file, depending on
+// its type, with the specified configuration, if any
+static ExternalModule* createModule(const fs::path& file_path,
+                                    const lth_jc::JsonContainer* config) {
+    auto suffix = file_path.extension().string();
+    auto path = file_path.string();
+#ifndef _WIN32
+    if (suffix == PluginModule::PLUGIN_SUFFIX) {
+        return config ? new PluginModule(path, *config) : new PluginModule(path);
+    }
+#endif
+#ifdef PXP_AGENT_WITH_LUA
+    if (suffix == LuaModule::SCRIPT_SUFFIX) {
+        return config ? new LuaModule(path, *config) : new LuaModule(path);
+    }
+#endif
+    return config ? new ExternalModule(path, *config) : new ExternalModule(path);
+}
+
+void RequestProcessor::loadExternalModulesFrom(fs::path dir_path,
+                                               ModulesMap& modules) {
     LOG_INFO("Loading external modules from %1%", dir_path.string());
+    std::map<std::string, ExternalModuleState> modules_state {};
 
     if (fs::is_directory(dir_path)) {
         fs::directory_iterator end;
@@ -361,20 +760,39 @@ void RequestProcessor::loadExternalModulesFrom(fs::path dir_path) {
 
                 try {
                     ExternalModule* e_m;
-                    auto config_itr = modules_config_.find(
-                        fs::path(f_p).filename().string());
+                    auto module_name = getModuleName(f->path());
+                    auto config_itr = modules_config_.find(module_name);
+                    ExternalModuleState state {
+                        fs::last_write_time(f_p),
+                        (config_itr != modules_config_.end()
+                            ? config_itr->second.toString() : ""),
+                        nullptr };
+
+                    // Reuse the module if nothing changed
+                    auto state_itr = external_modules_state_.find(f_p);
+
+                    if (state_itr != external_modules_state_.end()
+                            && state_itr->second.mtime == state.mtime
+                            && state_itr->second.config_txt == state.config_txt) {
+                        auto& module_ptr = state_itr->second.module;
+                        modules[module_ptr->module_name] = module_ptr;
+                        modules_state[f_p] = state_itr->second;
+                        continue;
+                    }
 
                     if (config_itr != modules_config_.end()) {
-                        e_m = new ExternalModule(f_p, config_itr->second);
+                        e_m = createModule(f->path(), &config_itr->second);
                         e_m->validateConfiguration();
                         LOG_DEBUG("The '%1%' module configuration has been "
                                   "validated: %2%", e_m->module_name,
                                   config_itr->second.toString());
                     } else {
-                        e_m = new ExternalModule(f_p);
+                        e_m = createModule(f->path(), nullptr);
                     }
 
-                    modules_[e_m->module_name] = std::shared_ptr<Module>(e_m);
+                    state.module = std::shared_ptr<Module>(e_m);
+                    modules[e_m->module_name] = state.module;
+                    modules_state[f_p] = state;
                 } catch (Module::LoadingError& e) {
                     LOG_ERROR("Failed to load %1%; %2%", f_p, e.what());
                 } catch (PCPClient::validation_error& e) {
@@ -391,10 +809,33 @@ void RequestProcessor::loadExternalModulesFrom(fs::path dir_path) {
         LOG_WARNING("Failed to locate the modules directory; no external "
                     "module will be loaded");
     }
+
+    external_modules_state_ = std::move(modules_state);
+}
+
+void RequestProcessor::loadModules() {
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> reload_lock { reload_mutex_ };
+    std::shared_ptr<ModulesMap> modules { new ModulesMap(internal_modules_) };
+
+    loadModulesConfiguration();
+
+    if (!modules_dir_.empty()) {
+        loadExternalModulesFrom(modules_dir_, *modules);
+    } else {
+        LOG_WARNING("The modules directory was not provided; no external "
+                    "module will be loaded");
+    }
+
+    logLoadedModules(*modules);
+
+    // NB: the previous modules are destroyed once the requests that
+    // are using them are done
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { modules_mutex_ };
+    modules_ = modules;
 }
 
-void RequestProcessor::logLoadedModules() const {
-    for (auto& module : modules_) {
+void RequestProcessor::logLoadedModules(const ModulesMap& modules) const {
+    for (auto& module : modules) {
         std::string txt { "found no action" };
         std::string actions_list { "" };
 
@@ -0,0 +1,435 @@
+#include <pxp-agent/results_storage.hpp>
+#include <pxp-agent/job_journal.hpp>
+#include <pxp-agent/util/compression.hpp>
+
+#ifndef _WIN32
+#include <pxp-agent/util/posix/group_commit.hpp>
+#endif
+
+#include <leatherman/file_util/file.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.results_storage"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+#include <algorithm>
+#include <cstdlib>    // EXIT_SUCCESS
+#include <fstream>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_file = leatherman::file_util;
+
+const std::string ResultsStorage::STATUS_FILE { "status" };
+const std::string ResultsStorage::STDOUT_FILE { "stdout" };
+const std::string ResultsStorage::STDERR_FILE { "stderr" };
+const std::string ResultsStorage::EXITCODE_FILE { "exitcode" };
+const std::string ResultsStorage::PID_FILE { "pid" };
+const std::string ResultsStorage::RESOURCES_FILE { "resources" };
+const std::string ResultsStorage::PROGRESS_FILE { "progress" };
+
+const std::string ResultsStorage::COMPRESSED_SUFFIX { ".gz" };
+
+const std::string ResultsStorage::RUNNING { "running" };
+const std::string ResultsStorage::COMPLETED { "completed" };
+const std::string ResultsStorage::FAILED { "failed" };
+
+#ifndef _WIN32
+// Shared by all jobs, so that their syncs are group committed
+static Util::GroupCommitWriter& getWriter() {
+    static Util::GroupCommitWriter writer {};
+    return writer;
+}
+#endif
+
+// Replace the content of the specified files, in order, atomically.
+// Throw a ResultsStorage::Error in case of failure.
+static void writeFiles(const std::vector<std::pair<std::string, std::string>>& files) {
+#ifndef _WIN32
+    try {
+        getWriter().write(files);
+    } catch (const Util::commit_error& e) {
+        throw ResultsStorage::Error { e.what() };
+    }
+#else
+    for (const auto& file : files) {
+        lth_file::atomic_write_to_file(file.second, file.first);
+    }
+#endif
+}
+
+static void writeFile(const std::string& path, const std::string& content) {
+    writeFiles({ std::make_pair(path, content) });
+}
+
+//
+// Public interface
+//
+
+ResultsStorage::ResultsStorage(const ActionRequest& request,
+                               const std::string& results_dir)
+        : results_dir_ { results_dir },
+          out_path_ { results_dir + "/" + STDOUT_FILE },
+          err_path_ { results_dir + "/" + STDERR_FILE },
+          status_path_ { results_dir + "/" + STATUS_FILE },
+          action_status_ {} {
+    initialize(request);
+}
+
+ResultsStorage::ResultsStorage(const std::string& results_dir)
+        : results_dir_ { results_dir },
+          out_path_ { results_dir + "/" + STDOUT_FILE },
+          err_path_ { results_dir + "/" + STDERR_FILE },
+          status_path_ { results_dir + "/" + STATUS_FILE },
+          action_status_ {} {
+    std::string status_txt;
+
+    if (!lth_file::read(status_path_, status_txt)) {
+        throw Error { "failed to read " + status_path_ };
+    }
+
+    try {
+        action_status_ = lth_jc::JsonContainer { status_txt };
+    } catch (lth_jc::data_parse_error& e) {
+        throw Error { "invalid status file " + status_path_ + ": " + e.what() };
+    }
+}
+
+void ResultsStorage::write(const ActionOutcome& outcome,
+                           const std::string& exec_error,
+                           const std::string& duration) {
+    action_status_.set<std::string>("status", COMPLETED);
+    action_status_.set<std::string>("duration", duration);
+    action_status_.set<int>("exitcode", outcome.exitcode);
+    readResourceUsage();
+    std::vector<std::pair<std::string, std::string>> files {};
+
+    if (exec_error.empty()) {
+        // NB: the output of external modules is written directly to
+        // the results directory by the module process
+        if (outcome.type == ActionOutcome::Type::Internal) {
+            files.push_back(std::make_pair(out_path_,
+                                           outcome.results.toString() + "\n"));
+        }
+    } else {
+        files.push_back(std::make_pair(err_path_, exec_error));
+    }
+
+    files.push_back(std::make_pair(status_path_, action_status_.toString() + "\n"));
+    writeFiles(files);
+}
+
+void ResultsStorage::writeRecovered(int exitcode, const std::string& duration) {
+    action_status_.set<std::string>("status", COMPLETED);
+    action_status_.set<std::string>("duration", duration);
+    action_status_.set<int>("exitcode", exitcode);
+    writeStatus();
+}
+
+void ResultsStorage::markFailed(const std::string& reason) {
+    std::string err_txt;
+    lth_file::read(err_path_, err_txt);
+
+    action_status_.set<std::string>("status", FAILED);
+    action_status_.set<int>("exitcode", EXIT_FAILURE);
+    writeFiles({ std::make_pair(err_path_, err_txt + reason + "\n"),
+                 std::make_pair(status_path_, action_status_.toString() + "\n") });
+}
+
+void ResultsStorage::setLimitExceeded(const std::string& limit) {
+    action_status_.set<std::string>("limit_exceeded", limit);
+}
+
+void ResultsStorage::compressOutput(size_t threshold) {
+    compressFile(out_path_, threshold);
+    compressFile(err_path_, threshold);
+}
+
+void ResultsStorage::archive(JobJournal& journal) {
+    auto transaction_id = fs::path(results_dir_).filename().string();
+    auto status_txt = action_status_.toString() + "\n";
+
+    try {
+        // NB: the output files are copied to the journal as they are,
+        // unless they were compressed in directory format
+        if (isOutputCompressed(results_dir_, STDOUT_FILE)
+                || isOutputCompressed(results_dir_, STDERR_FILE)) {
+            journal.append(transaction_id,
+                           JobJournal::Record { status_txt,
+                                                readOutput(results_dir_, STDOUT_FILE),
+                                                readOutput(results_dir_, STDERR_FILE) });
+        } else {
+            journal.appendFiles(transaction_id, status_txt, out_path_, err_path_);
+        }
+    } catch (const JobJournal::Error& e) {
+        throw Error { std::string { "failed to append the job record to the "
+                                    "journal: " } + e.what() };
+    }
+
+    boost::system::error_code ec;
+    fs::remove_all(results_dir_, ec);
+
+    if (ec) {
+        LOG_WARNING("Failed to remove %1% after moving the job results to the "
+                    "journal: %2%", results_dir_, ec.message());
+    }
+}
+
+bool ResultsStorage::isRunning() const {
+    return action_status_.includes("status")
+           && action_status_.get<std::string>("status") == RUNNING;
+}
+
+const std::string& ResultsStorage::resultsDir() const {
+    return results_dir_;
+}
+
+void ResultsStorage::setSyncWrites(bool sync) {
+#ifndef _WIN32
+    getWriter().setSync(sync);
+#else
+    if (sync) {
+        LOG_WARNING("Syncing the spool files is not supported on Windows");
+    }
+#endif
+}
+
+void ResultsStorage::writeProcessInfo(const std::string& results_dir,
+                                      int pid,
+                                      const std::string& start_time) {
+    lth_jc::JsonContainer process_info {};
+    process_info.set<int>("pid", pid);
+    process_info.set<std::string>("start_time", start_time);
+    writeFile(results_dir + "/" + PID_FILE, process_info.toString() + "\n");
+}
+
+void ResultsStorage::writeResourceUsage(const std::string& results_dir,
+                                        const lth_jc::JsonContainer& usage) {
+    writeFile(results_dir + "/" + RESOURCES_FILE, usage.toString() + "\n");
+}
+
+bool ResultsStorage::readProcessInfo(const std::string& results_dir,
+                                     int& pid,
+                                     std::string& start_time) {
+    std::string info_txt;
+
+    if (!lth_file::read(results_dir + "/" + PID_FILE, info_txt)) {
+        return false;
+    }
+
+    try {
+        lth_jc::JsonContainer process_info { info_txt };
+        pid = process_info.get<int>("pid");
+        start_time = process_info.get<std::string>("start_time");
+    } catch (lth_jc::data_error& e) {
+        LOG_WARNING("Invalid process info file in %1%: %2%", results_dir, e.what());
+        return false;
+    }
+
+    return true;
+}
+
+bool ResultsStorage::readExitcode(const std::string& results_dir, int& exitcode) {
+    std::string exitcode_txt;
+
+    if (!lth_file::read(results_dir + "/" + EXITCODE_FILE, exitcode_txt)) {
+        return false;
+    }
+
+    boost::trim(exitcode_txt);
+
+    try {
+        exitcode = std::stoi(exitcode_txt);
+    } catch (const std::exception&) {
+        LOG_WARNING("Invalid exit code file in %1%: '%2%'", results_dir, exitcode_txt);
+        return false;
+    }
+
+    return true;
+}
+
+bool ResultsStorage::readProgress(const std::string& results_dir,
+                                  lth_jc::JsonContainer& progress) {
+    std::string progress_txt;
+
+    if (!lth_file::read(results_dir + "/" + PROGRESS_FILE, progress_txt)) {
+        return false;
+    }
+
+    try {
+        progress = lth_jc::JsonContainer { progress_txt };
+    } catch (lth_jc::data_parse_error& e) {
+        LOG_DEBUG("Invalid progress file in %1%: %2%", results_dir, e.what());
+        return false;
+    }
+
+    return true;
+}
+
+std::string ResultsStorage::readOutput(const std::string& results_dir,
+                                       const std::string& file_name) {
+    std::string output_txt;
+
+    if (isOutputCompressed(results_dir, file_name)) {
+        auto compressed_path = results_dir + "/" + file_name + COMPRESSED_SUFFIX;
+        std::ifstream compressed_file { compressed_path, std::ios::binary };
+        output_txt.assign(std::istreambuf_iterator<char>(compressed_file),
+                          std::istreambuf_iterator<char>());
+
+        try {
+            return Util::gzipDecompress(output_txt);
+        } catch (Util::compression_error& e) {
+            throw Error { "failed to decompress " + compressed_path + ": " + e.what() };
+        }
+    }
+
+    lth_file::read(results_dir + "/" + file_name, output_txt);
+    return output_txt;
+}
+
+std::string ResultsStorage::readOutputRange(const std::string& results_dir,
+                                            const std::string& file_name,
+                                            uint64_t offset,
+                                            int64_t length,
+                                            uint64_t& size) {
+    std::string range {};
+    size = 0;
+
+    if (isOutputCompressed(results_dir, file_name)) {
+        auto compressed_path = results_dir + "/" + file_name + COMPRESSED_SUFFIX;
+        std::ifstream compressed_file { compressed_path, std::ios::binary };
+
+        try {
+            size = Util::gzipDecompressedSize(compressed_file);
+            compressed_file.seekg(0);
+            return offset < size
+                   ? Util::gzipDecompressRange(compressed_file, offset, length)
+                   : range;
+        } catch (Util::compression_error& e) {
+            throw Error { "failed to decompress " + compressed_path + ": " + e.what() };
+        }
+    }
+
+    // NB: the output file is missing if the job produced no output
+    auto file_path = results_dir + "/" + file_name;
+    std::ifstream file { file_path, std::ios::binary };
+
+    if (!file || !file.seekg(0, std::ios::end)) {
+        return range;
+    }
+
+    size = static_cast<uint64_t>(file.tellg());
+
+    if (offset >= size || !file.seekg(offset)) {
+        return range;
+    }
+
+    auto range_size = size - offset;
+
+    if (length >= 0) {
+        range_size = std::min(range_size, static_cast<uint64_t>(length));
+    }
+
+    range.resize(range_size);
+    file.read(&range[0], range_size);
+    range.resize(file.gcount());
+    return range;
+}
+
+bool ResultsStorage::isOutputCompressed(const std::string& results_dir,
+                                        const std::string& file_name) {
+    return fs::exists(results_dir + "/" + file_name + COMPRESSED_SUFFIX);
+}
+
+//
+// Private interface
+//
+
+void ResultsStorage::initialize(const ActionRequest& request) {
+    // NB: create_directories() does nothing if the directory exists
+    LOG_DEBUG("Creating results directory for '%1% %2%', transaction "
+               "%3%, in '%4%'", request.module(), request.action(),
+               request.transactionId(), results_dir_);
+    try {
+        fs::create_directories(results_dir_);
+    } catch (const fs::filesystem_error& e) {
+        std::string err_msg { "failed to create results directory: " };
+        throw Error { err_msg + e.what() };
+    }
+
+    action_status_.set<std::string>("module", request.module());
+    action_status_.set<std::string>("action", request.action());
+    action_status_.set<std::string>("status", RUNNING);
+    action_status_.set<std::string>("duration", "0 s");
+    action_status_.set<int>("exitcode", EXIT_SUCCESS);
+
+    if (!request.paramsTxt().empty()) {
+        action_status_.set<std::string>("input", request.paramsTxt());
+    } else {
+        action_status_.set<std::string>("input", "none");
+    }
+
+    // NB: the output files are not created here, in order to write
+    // a single file when the job starts
+    writeStatus();
+}
+
+void ResultsStorage::readResourceUsage() {
+    std::string usage_txt;
+
+    if (!lth_file::read(results_dir_ + "/" + RESOURCES_FILE, usage_txt)) {
+        return;
+    }
+
+    try {
+        action_status_.set<lth_jc::JsonContainer>("resources",
+                                                  lth_jc::JsonContainer { usage_txt });
+    } catch (lth_jc::data_parse_error& e) {
+        LOG_WARNING("Invalid resource usage file in %1%: %2%", results_dir_, e.what());
+    }
+}
+
+void ResultsStorage::compressFile(const std::string& file_path, size_t threshold) {
+    try {
+        if (!fs::exists(file_path) || fs::file_size(file_path) <= threshold) {
+            return;
+        }
+
+        std::string file_txt;
+
+        if (!lth_file::read(file_path, file_txt)) {
+            LOG_WARNING("Failed to read %1%; it won't be compressed", file_path);
+            return;
+        }
+
+        // NB: write the compressed data in binary mode and then
+        // rename the file, so that it's never found incomplete
+        auto compressed_path = file_path + COMPRESSED_SUFFIX;
+        auto tmp_path = compressed_path + ".tmp";
+        {
+            std::ofstream compressed_file { tmp_path, std::ios::binary };
+            compressed_file << Util::gzipCompress(file_txt);
+
+            if (!compressed_file) {
+                throw Error { "failed to write " + tmp_path };
+            }
+        }
+        fs::rename(tmp_path, compressed_path);
+        fs::remove(file_path);
+        LOG_DEBUG("Compressed %1% (%2% bytes)", file_path, file_txt.size());
+    } catch (const std::exception& e) {
+        LOG_WARNING("Failed to compress %1%: %2%", file_path, e.what());
+    }
+}
+
+void ResultsStorage::writeStatus() {
+    writeFile(status_path_, action_status_.toString() + "\n");
+}
+
+}  // namespace PXPAgent
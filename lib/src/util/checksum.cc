@@ -0,0 +1,84 @@
+#include <pxp-agent/util/checksum.hpp>
+
+#include <openssl/evp.h>
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+
+// NB: EVP_MD_CTX_new/free were named create/destroy before OpenSSL 1.1
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define EVP_MD_CTX_new EVP_MD_CTX_create
+#define EVP_MD_CTX_free EVP_MD_CTX_destroy
+#endif
+
+namespace PXPAgent {
+namespace Util {
+
+// Size of the blocks read to compute the digest of a file
+static const size_t FILE_BLOCK_SIZE { 64 * 1024 };
+
+static std::string toHex(const unsigned char* digest, unsigned int size) {
+    std::ostringstream digest_hex {};
+    digest_hex << std::hex << std::setfill('0');
+
+    for (unsigned int i = 0; i < size; i++) {
+        digest_hex << std::setw(2) << static_cast<int>(digest[i]);
+    }
+
+    return digest_hex.str();
+}
+
+std::string getSha256(const std::string& data) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_size { 0 };
+
+    if (!EVP_Digest(data.data(), data.size(), digest, &digest_size,
+                    EVP_sha256(), nullptr)) {
+        throw std::runtime_error { "failed to compute the SHA-256 digest" };
+    }
+
+    return toHex(digest, digest_size);
+}
+
+std::string getFileSha256(const std::string& file_path) {
+    std::ifstream file_stream { file_path, std::ios::binary };
+
+    if (!file_stream) {
+        throw std::runtime_error { "failed to open " + file_path };
+    }
+
+    std::unique_ptr<EVP_MD_CTX, void (*)(EVP_MD_CTX*)> context {
+        EVP_MD_CTX_new(), EVP_MD_CTX_free };
+
+    if (!context || !EVP_DigestInit_ex(context.get(), EVP_sha256(), nullptr)) {
+        throw std::runtime_error { "failed to initialize the SHA-256 digest" };
+    }
+
+    char buffer[FILE_BLOCK_SIZE];
+
+    while (file_stream.read(buffer, FILE_BLOCK_SIZE) || file_stream.gcount() > 0) {
+        if (!EVP_DigestUpdate(context.get(), buffer, file_stream.gcount())) {
+            throw std::runtime_error { "failed to compute the SHA-256 digest of "
+                                       + file_path };
+        }
+    }
+
+    if (file_stream.bad()) {
+        throw std::runtime_error { "failed to read " + file_path };
+    }
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_size { 0 };
+
+    if (!EVP_DigestFinal_ex(context.get(), digest, &digest_size)) {
+        throw std::runtime_error { "failed to compute the SHA-256 digest of "
+                                   + file_path };
+    }
+
+    return toHex(digest, digest_size);
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,175 @@
+#include <pxp-agent/util/compression.hpp>
+
+#include <openssl/evp.h>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>  // memset
+#include <vector>
+
+namespace PXPAgent {
+namespace Util {
+
+// Adding 16 to the window bits makes zlib use the gzip format
+static const int GZIP_WINDOW_BITS { 15 + 16 };
+
+// Size of the buffer used to inflate the data
+static const size_t INFLATE_BUFFER_SIZE { 64 * 1024 };
+
+std::string gzipCompress(const std::string& data) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw compression_error { "failed to initialize zlib" };
+    }
+
+    std::string compressed(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_out = static_cast<uInt>(compressed.size());
+
+    // NB: the output buffer is large enough to deflate in one call
+    auto ret = deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    if (ret != Z_STREAM_END) {
+        throw compression_error { "failed to compress data" };
+    }
+
+    return compressed;
+}
+
+std::string gzipDecompress(const std::string& data) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    if (inflateInit2(&stream, GZIP_WINDOW_BITS) != Z_OK) {
+        throw compression_error { "failed to initialize zlib" };
+    }
+
+    std::string decompressed {};
+    char buffer[INFLATE_BUFFER_SIZE];
+    int ret;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+
+    do {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = INFLATE_BUFFER_SIZE;
+        ret = inflate(&stream, Z_NO_FLUSH);
+
+        if (ret != Z_OK && ret != Z_STREAM_END) {
+            inflateEnd(&stream);
+            throw compression_error { "invalid gzip data" };
+        }
+
+        decompressed.append(buffer, INFLATE_BUFFER_SIZE - stream.avail_out);
+    } while (ret != Z_STREAM_END && (stream.avail_in > 0 || stream.avail_out == 0));
+
+    inflateEnd(&stream);
+
+    if (ret != Z_STREAM_END) {
+        throw compression_error { "truncated gzip data" };
+    }
+
+    return decompressed;
+}
+
+std::string gzipDecompressRange(std::istream& input,
+                                uint64_t offset,
+                                int64_t length) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    if (inflateInit2(&stream, GZIP_WINDOW_BITS) != Z_OK) {
+        throw compression_error { "failed to initialize zlib" };
+    }
+
+    std::string range {};
+    std::vector<char> in_buffer(INFLATE_BUFFER_SIZE);
+    std::vector<char> out_buffer(INFLATE_BUFFER_SIZE);
+    // Number of decompressed bytes that precede out_buffer
+    uint64_t position { 0 };
+    int ret { Z_OK };
+    auto complete = [&]() {
+        return length >= 0 && range.size() >= static_cast<uint64_t>(length);
+    };
+
+    while (ret != Z_STREAM_END && !complete()) {
+        if (stream.avail_in == 0) {
+            input.read(in_buffer.data(), in_buffer.size());
+            stream.next_in = reinterpret_cast<Bytef*>(in_buffer.data());
+            stream.avail_in = static_cast<uInt>(input.gcount());
+
+            if (stream.avail_in == 0) {
+                break;
+            }
+        }
+
+        stream.next_out = reinterpret_cast<Bytef*>(out_buffer.data());
+        stream.avail_out = INFLATE_BUFFER_SIZE;
+        ret = inflate(&stream, Z_NO_FLUSH);
+
+        if (ret != Z_OK && ret != Z_STREAM_END) {
+            inflateEnd(&stream);
+            throw compression_error { "invalid gzip data" };
+        }
+
+        uint64_t produced { INFLATE_BUFFER_SIZE - stream.avail_out };
+
+        if (position + produced > offset) {
+            auto start = offset > position ? offset - position : 0;
+            auto count = produced - start;
+
+            if (length >= 0) {
+                count = std::min(count, static_cast<uint64_t>(length) - range.size());
+            }
+
+            range.append(out_buffer.data() + start, count);
+        }
+
+        position += produced;
+    }
+
+    inflateEnd(&stream);
+
+    if (ret != Z_STREAM_END && !complete()) {
+        throw compression_error { "truncated gzip data" };
+    }
+
+    return range;
+}
+
+uint64_t gzipDecompressedSize(std::istream& input) {
+    // NB: the trailer ends with ISIZE, little endian
+    unsigned char isize[4];
+
+    if (!input.seekg(-4, std::ios::end)
+            || !input.read(reinterpret_cast<char*>(isize), sizeof(isize))) {
+        throw compression_error { "truncated gzip data" };
+    }
+
+    return static_cast<uint64_t>(isize[0])
+           | static_cast<uint64_t>(isize[1]) << 8
+           | static_cast<uint64_t>(isize[2]) << 16
+           | static_cast<uint64_t>(isize[3]) << 24;
+}
+
+std::string encodeBase64(const std::string& data) {
+    // NB: EVP_EncodeBlock writes 4 characters for each 3 bytes block
+    // plus the terminating NUL
+    std::string encoded(4 * ((data.size() + 2) / 3) + 1, '\0');
+    auto size = EVP_EncodeBlock(reinterpret_cast<unsigned char*>(&encoded[0]),
+                                reinterpret_cast<const unsigned char*>(data.data()),
+                                static_cast<int>(data.size()));
+    encoded.resize(size);
+    return encoded;
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
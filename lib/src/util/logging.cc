@@ -0,0 +1,508 @@
+#include <pxp-agent/util/logging.hpp>
+
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.util.logging"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <cstdio>
+#include <ctime>
+
+namespace PXPAgent {
+namespace Util {
+
+namespace lth_jc = leatherman::json_container;
+namespace lth_log = leatherman::logging;
+
+const size_t MAX_LOGGED_PAYLOAD_SIZE { 4096 };
+
+std::string logPayload(const std::string& payload, size_t max_size) {
+    if (payload.size() <= max_size) {
+        return payload;
+    }
+
+    // Don't split a multi-byte UTF-8 character
+    auto size = max_size;
+    while (size > 0 && (payload[size] & 0xC0) == 0x80) {
+        size--;
+    }
+
+    return payload.substr(0, size) + "... ["
+           + std::to_string(payload.size() - size) + " bytes omitted]";
+}
+
+void rotateFiles(const std::string& path, unsigned int num_kept) {
+    namespace fs = boost::filesystem;
+    boost::system::error_code ec {};
+
+    if (num_kept == 0) {
+        fs::remove(path, ec);
+        return;
+    }
+
+    auto numbered = [&path](unsigned int n) {
+        return fs::path { path + "." + std::to_string(n) };
+    };
+
+    fs::remove(numbered(num_kept), ec);
+
+    for (auto n = num_kept - 1; n > 0; n--) {
+        if (fs::exists(numbered(n), ec)) {
+            fs::rename(numbered(n), numbered(n + 1), ec);
+        }
+    }
+
+    fs::rename(path, numbered(1), ec);
+}
+
+//
+// JSON logging
+//
+
+static std::atomic<bool> json_logging { false };
+static std::ostream* json_log_stream { nullptr };
+// Serializes the writes, unless the stream is an AsyncLogStream that
+// keeps the messages of each thread separate
+static bool json_log_stream_async { false };
+static PCPClient::Util::mutex json_log_mutex {};
+
+static thread_local LogContext log_context {};
+
+static std::string getTimestamp() {
+    auto now = std::chrono::system_clock::now();
+    auto time = std::chrono::system_clock::to_time_t(now);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        now.time_since_epoch()).count() % 1000000;
+    std::tm tm {};
+#ifdef _WIN32
+    gmtime_s(&tm, &time);
+#else
+    gmtime_r(&time, &tm);
+#endif
+    char buffer[32];
+    auto size = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &tm);
+    std::snprintf(buffer + size, sizeof(buffer) - size, ".%06dZ",
+                  static_cast<int>(us));
+    return buffer;
+}
+
+static const char* getLevelName(lth_log::log_level level) {
+    switch (level) {
+        case lth_log::log_level::trace: return "trace";
+        case lth_log::log_level::debug: return "debug";
+        case lth_log::log_level::info: return "info";
+        case lth_log::log_level::warning: return "warning";
+        case lth_log::log_level::error: return "error";
+        case lth_log::log_level::fatal: return "fatal";
+        default: return "none";
+    }
+}
+
+static void writeRecord(lth_log::log_level level,
+                        const std::string& log_namespace,
+                        const std::string& message,
+                        const lth_jc::JsonContainer& entries) {
+    lth_jc::JsonContainer record {};
+    record.set<std::string>("timestamp", getTimestamp());
+    record.set<std::string>("level", getLevelName(level));
+    if (!log_namespace.empty()) {
+        record.set<std::string>("namespace", log_namespace);
+    }
+    record.set<std::string>("message", message);
+
+    auto setContextEntry = [&record](const char* key, const std::string& value) {
+        if (!value.empty()) {
+            record.set<std::string>(key, value);
+        }
+    };
+    setContextEntry("request_id", log_context.request_id);
+    setContextEntry("transaction_id", log_context.transaction_id);
+    setContextEntry("sender", log_context.sender);
+    setContextEntry("module", log_context.module);
+    setContextEntry("action", log_context.action);
+
+    for (const auto& key : entries.keys()) {
+        record.set<lth_jc::JsonContainer>(key, entries.get<lth_jc::JsonContainer>(key));
+    }
+
+    auto line = record.toString() + "\n";
+
+    if (json_log_stream_async) {
+        json_log_stream->write(line.data(), line.size());
+        json_log_stream->flush();
+    } else {
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock {
+            json_log_mutex };
+        json_log_stream->write(line.data(), line.size());
+        json_log_stream->flush();
+    }
+}
+
+void setupJsonLogging(std::ostream& stream) {
+    json_log_stream = &stream;
+    json_log_stream_async = (dynamic_cast<AsyncLogStream*>(&stream) != nullptr);
+    json_logging = true;
+
+    lth_log::on_message([](lth_log::log_level level, const std::string& message) {
+        writeRecord(level, "", message, lth_jc::JsonContainer {});
+        // Don't write the message in text format
+        return false;
+    });
+}
+
+void resetJsonLogging() {
+    if (json_logging.exchange(false)) {
+        lth_log::on_message(nullptr);
+    }
+}
+
+bool jsonLoggingEnabled() {
+    return json_logging;
+}
+
+LogContextScope::LogContextScope(const std::string& request_id,
+                                 const std::string& transaction_id,
+                                 const std::string& sender,
+                                 const std::string& module,
+                                 const std::string& action)
+        : previous_context_(log_context) {
+    log_context = LogContext { request_id, transaction_id, sender, module, action };
+}
+
+LogContextScope::~LogContextScope() {
+    log_context = previous_context_;
+}
+
+void logEvent(const std::string& log_namespace,
+              const std::string& event,
+              const lth_jc::JsonContainer& entries) {
+    if (json_logging && lth_log::is_enabled(lth_log::log_level::info)) {
+        writeRecord(lth_log::log_level::info, log_namespace, event, entries);
+    }
+}
+
+LogEventScope::LogEventScope(const std::string& log_namespace,
+                             const std::string& event)
+        : log_namespace_ { log_namespace },
+          event_ { event },
+          start_ { std::chrono::steady_clock::now() },
+          failed_ { false } {
+}
+
+LogEventScope::~LogEventScope() {
+    if (!json_logging) {
+        return;
+    }
+
+    try {
+        lth_jc::JsonContainer entries {};
+        entries.set<int>("duration_ms", static_cast<int>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start_).count()));
+        if (failed_ || std::uncaught_exception()) {
+            entries.set<bool>("failed", true);
+        }
+        logEvent(log_namespace_, event_, entries);
+    } catch (...) {
+        // NB: destructors must not throw
+    }
+}
+
+//
+// AsyncLogStream
+//
+
+// Number of slots of the ring buffer; must be a power of 2
+static const size_t NUM_SLOTS { 8192 };
+
+const size_t AsyncLogStream::DEFAULT_CAPACITY { 4 * 1024 * 1024 };
+const std::chrono::milliseconds AsyncLogStream::FLUSH_INTERVAL { 100 };
+
+AsyncLogStream::AsyncLogStream(std::ostream& destination,
+                               std::function<void()> reopen,
+                               size_t capacity)
+        : std::ostream { nullptr },
+          buffer_ { destination, reopen, capacity } {
+    rdbuf(&buffer_);
+}
+
+AsyncLogStream::~AsyncLogStream() {
+    stop();
+}
+
+void AsyncLogStream::setRotation(std::function<void()> rotate,
+                                 size_t max_size,
+                                 std::chrono::seconds max_age,
+                                 size_t initial_size) {
+    buffer_.setRotation(rotate, max_size, max_age, initial_size);
+}
+
+void AsyncLogStream::start() {
+    buffer_.start();
+}
+
+void AsyncLogStream::stop() {
+    flush();
+    buffer_.stop();
+}
+
+void AsyncLogStream::reopen() {
+    buffer_.reopen();
+}
+
+AsyncLogStream::Buffer::Buffer(std::ostream& destination,
+                               std::function<void()> reopen,
+                               size_t capacity)
+        : destination_(destination),
+          reopen_function_ { reopen },
+          capacity_ { capacity },
+          slots_ { new Slot[NUM_SLOTS] },
+          slots_mask_ { NUM_SLOTS - 1 },
+          enqueue_position_ { 0 },
+          dequeue_position_ { 0 },
+          queued_size_ { 0 },
+          num_dropped_ { 0 },
+          num_producers_ { 0 },
+          running_ { false },
+          stopping_ { false },
+          reopen_requested_ { false },
+          rotate_function_ {},
+          rotation_size_ { 0 },
+          rotation_age_ { 0 },
+          written_size_ { 0 },
+          rotation_time_ { Clock::now() },
+          destination_mutex_ {},
+          wakeup_mutex_ {},
+          cond_var_ {},
+          writer_ {} {
+    for (size_t i = 0; i < NUM_SLOTS; i++) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+void AsyncLogStream::Buffer::setRotation(std::function<void()> rotate,
+                                         size_t max_size,
+                                         std::chrono::seconds max_age,
+                                         size_t initial_size) {
+    rotate_function_ = rotate;
+    rotation_size_ = max_size;
+    rotation_age_ = max_age;
+    written_size_ = initial_size;
+    rotation_time_ = Clock::now();
+}
+
+void AsyncLogStream::Buffer::start() {
+    if (running_) {
+        return;
+    }
+
+    stopping_ = false;
+    writer_ = PCPClient::Util::thread { &AsyncLogStream::Buffer::write, this };
+    running_ = true;
+}
+
+void AsyncLogStream::Buffer::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    // Wait for the threads that are queueing entries, so that the
+    // writer thread finds all of them; from now on, entries are
+    // written synchronously
+    while (num_producers_ > 0) {
+        PCPClient::Util::this_thread::yield();
+    }
+
+    stopping_ = true;
+    cond_var_.notify_one();
+    writer_.join();
+}
+
+void AsyncLogStream::Buffer::reopen() {
+    if (running_) {
+        reopen_requested_ = true;
+    } else if (reopen_function_) {
+        reopen_function_();
+    }
+}
+
+std::string& AsyncLogStream::Buffer::pendingEntry() {
+    // NB: entries are accumulated by each thread, so that the
+    // messages of concurrent threads are not interleaved
+    static thread_local const Buffer* owner { nullptr };
+    static thread_local std::string entry {};
+
+    if (owner != this) {
+        owner = this;
+        entry.clear();
+    }
+
+    return entry;
+}
+
+AsyncLogStream::Buffer::int_type AsyncLogStream::Buffer::overflow(int_type c) {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+
+    pendingEntry().push_back(traits_type::to_char_type(c));
+    return c;
+}
+
+std::streamsize AsyncLogStream::Buffer::xsputn(const char* s, std::streamsize n) {
+    pendingEntry().append(s, static_cast<size_t>(n));
+    return n;
+}
+
+int AsyncLogStream::Buffer::sync() {
+    auto& entry = pendingEntry();
+
+    if (entry.empty()) {
+        return 0;
+    }
+
+    num_producers_++;
+
+    if (!running_) {
+        num_producers_--;
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock {
+            destination_mutex_ };
+        destination_ << entry;
+        destination_.flush();
+        entry.clear();
+        return 0;
+    }
+
+    auto size = entry.size();
+
+    if (queued_size_.fetch_add(size) + size > capacity_ || !push(entry)) {
+        queued_size_ -= size;
+        num_dropped_++;
+        entry.clear();
+    }
+
+    num_producers_--;
+
+    if (queued_size_ > capacity_ / 2) {
+        cond_var_.notify_one();
+    }
+
+    return 0;
+}
+
+bool AsyncLogStream::Buffer::push(std::string& entry) {
+    auto position = enqueue_position_.load(std::memory_order_relaxed);
+
+    for (;;) {
+        auto& slot = slots_[position & slots_mask_];
+        auto sequence = slot.sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<long long>(sequence)
+                    - static_cast<long long>(position);
+
+        if (diff == 0) {
+            if (enqueue_position_.compare_exchange_weak(
+                    position, position + 1, std::memory_order_relaxed)) {
+                // NB: the entry gets the storage of the slot, to be
+                // reused for the next entry of the thread
+                slot.entry.swap(entry);
+                entry.clear();
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            // The writer hasn't freed the slot yet
+            return false;
+        } else {
+            position = enqueue_position_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool AsyncLogStream::Buffer::pop(std::string& entry) {
+    auto& slot = slots_[dequeue_position_ & slots_mask_];
+
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_position_ + 1) {
+        return false;
+    }
+
+    entry.swap(slot.entry);
+    slot.sequence.store(dequeue_position_ + NUM_SLOTS, std::memory_order_release);
+    dequeue_position_++;
+    return true;
+}
+
+void AsyncLogStream::Buffer::write() {
+    for (;;) {
+        {
+            PCPClient::Util::unique_lock<PCPClient::Util::mutex> the_lock {
+                wakeup_mutex_ };
+            // NB: producers and signal handlers don't lock the mutex,
+            // so a notification may be missed; FLUSH_INTERVAL bounds
+            // the delay
+            cond_var_.wait_for(the_lock, FLUSH_INTERVAL, [this]() {
+                return stopping_ || reopen_requested_
+                       || queued_size_ > capacity_ / 2;
+            });
+        }
+
+        auto stopping = stopping_.load();
+        writeQueued();
+
+        // NB: stop() waits for the producers before setting the flag,
+        // so the queue now holds only the entries logged while writing
+        if (stopping) {
+            if (queued_size_ > 0) {
+                writeQueued();
+            }
+            break;
+        }
+    }
+}
+
+void AsyncLogStream::Buffer::writeQueued() {
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock {
+        destination_mutex_ };
+    std::string entry {};
+    size_t size { 0 };
+
+    while (pop(entry)) {
+        destination_ << entry;
+        size += entry.size();
+        queued_size_ -= entry.size();
+    }
+
+    auto num_dropped = num_dropped_.exchange(0);
+
+    if (num_dropped > 0) {
+        destination_ << num_dropped << " log messages were dropped as the "
+                     << "log queue was full\n";
+    }
+
+    if (size > 0 || num_dropped > 0) {
+        destination_.flush();
+    }
+
+    written_size_ += size;
+    auto now = Clock::now();
+
+    if (reopen_requested_.exchange(false) && reopen_function_) {
+        reopen_function_();
+        written_size_ = 0;
+        rotation_time_ = now;
+    }
+
+    if (rotate_function_
+            && ((rotation_size_ > 0 && written_size_ >= rotation_size_)
+                || (rotation_age_.count() > 0
+                    && now - rotation_time_ >= rotation_age_))) {
+        rotate_function_();
+        written_size_ = 0;
+        rotation_time_ = now;
+    }
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
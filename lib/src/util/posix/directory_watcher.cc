@@ -0,0 +1,144 @@
+#include <pxp-agent/util/posix/directory_watcher.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.util.posix.directory_watcher"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>         // read(), close()
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include <cerrno>
+#include <cstring>          // strerror()
+
+namespace PXPAgent {
+namespace Util {
+
+const int DirectoryWatcher::DEBOUNCE_MS { 500 };
+
+// Interval between checks of the stop and SIGHUP flags [ms]
+static const int CHECK_INTERVAL_MS { 1000 };
+
+// Set by the SIGHUP handler
+static volatile sig_atomic_t sighup_received { 0 };
+
+static struct sigaction previous_sighup_action;
+
+static void sighupHandler(int) {
+    sighup_received = 1;
+}
+
+DirectoryWatcher::DirectoryWatcher(const std::vector<std::string>& dir_paths,
+                                   std::function<void()> on_change)
+        : on_change_ { std::move(on_change) },
+          inotify_fd_ { -1 },
+          stop_ { false },
+          thread_ {} {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sighupHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+
+    if (sigaction(SIGHUP, &sa, &previous_sighup_action) == -1) {
+        LOG_WARNING("Failed to set the SIGHUP disposition: %1%", strerror(errno));
+    }
+
+#ifdef __linux__
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (inotify_fd_ == -1) {
+        LOG_WARNING("Failed to initialize inotify (%1%); changes will be "
+                    "applied on SIGHUP only", strerror(errno));
+    } else {
+        for (auto& dir_path : dir_paths) {
+            if (dir_path.empty() || !boost::filesystem::is_directory(dir_path)) {
+                continue;
+            }
+
+            if (inotify_add_watch(inotify_fd_, dir_path.c_str(),
+                                  IN_CLOSE_WRITE | IN_CREATE | IN_DELETE
+                                  | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB) == -1) {
+                LOG_WARNING("Failed to watch %1%: %2%", dir_path, strerror(errno));
+            } else {
+                LOG_DEBUG("Watching %1% for changes", dir_path);
+            }
+        }
+    }
+#endif
+
+    thread_ = PCPClient::Util::thread(&DirectoryWatcher::watch, this);
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+    stop_ = true;
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    if (inotify_fd_ != -1) {
+        close(inotify_fd_);
+    }
+
+    sigaction(SIGHUP, &previous_sighup_action, nullptr);
+}
+
+void DirectoryWatcher::watch() {
+    while (!stop_) {
+        if (!waitForChanges(CHECK_INTERVAL_MS)) {
+            continue;
+        }
+
+        // Wait for the changes to settle
+        while (!stop_ && waitForChanges(DEBOUNCE_MS)) {}
+
+        if (stop_) {
+            break;
+        }
+
+        try {
+            on_change_();
+        } catch (const std::exception& e) {
+            LOG_ERROR("Failed to process the changes of the watched "
+                      "directories: %1%", e.what());
+        }
+    }
+}
+
+bool DirectoryWatcher::waitForChanges(int timeout_ms) {
+    auto changed = false;
+
+    if (inotify_fd_ != -1) {
+        pollfd pfd { inotify_fd_, POLLIN, 0 };
+
+        if (poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN)) {
+            // Consume the notifications; their content is irrelevant,
+            // as all the watched directories are rescanned
+            char buffer[4096];
+            while (read(inotify_fd_, buffer, sizeof(buffer)) > 0) {}
+            changed = true;
+        }
+    } else {
+        PCPClient::Util::this_thread::sleep_for(
+            PCPClient::Util::chrono::milliseconds(timeout_ms));
+    }
+
+    if (sighup_received) {
+        sighup_received = 0;
+        LOG_INFO("Caught SIGHUP");
+        changed = true;
+    }
+
+    return changed;
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
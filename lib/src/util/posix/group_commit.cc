@@ -0,0 +1,250 @@
+#include <pxp-agent/util/posix/group_commit.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.util.posix.group_commit"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/path.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>       // rename()
+
+#include <sys/stat.h>
+#include <fcntl.h>      // open() flags
+#include <unistd.h>     // write(), fsync(), fdatasync(), close()
+
+namespace PXPAgent {
+namespace Util {
+
+namespace lth_util = PCPClient::Util;
+
+// NB: concurrent writes of the same file must be serialized by the
+// caller, as they would share the temporary file
+static const std::string TMP_SUFFIX { ".tmp" };
+
+static std::string errnoMessage(const std::string& operation,
+                                const std::string& path) {
+    return "failed to " + operation + " '" + path + "'; errno="
+           + std::to_string(errno);
+}
+
+static void writeFile(const std::string& path, const std::string& content) {
+    auto fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+
+    if (fd == -1) {
+        throw commit_error { errnoMessage("open", path) };
+    }
+
+    size_t written { 0 };
+
+    while (written < content.size()) {
+        auto result = ::write(fd, content.data() + written, content.size() - written);
+
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            auto msg = errnoMessage("write", path);
+            close(fd);
+            throw commit_error { msg };
+        }
+
+        written += static_cast<size_t>(result);
+    }
+
+    if (close(fd) == -1) {
+        throw commit_error { errnoMessage("close", path) };
+    }
+}
+
+// Sync the file or directory; regular files are synced with
+// fdatasync() on Linux, as their metadata other than the size is not
+// needed to retrieve them. Return the error message, if any
+static std::string getSyncError(const std::string& path) {
+    auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1) {
+        return errnoMessage("open", path);
+    }
+
+    std::string error {};
+#ifdef __linux__
+    struct stat file_stat;
+
+    if (fstat(fd, &file_stat) == -1) {
+        error = errnoMessage("stat", path);
+    } else if ((S_ISDIR(file_stat.st_mode) ? fsync(fd) : fdatasync(fd)) == -1) {
+        error = errnoMessage("sync", path);
+    }
+#else
+    if (fsync(fd) == -1) {
+        error = errnoMessage("sync", path);
+    }
+#endif
+
+    close(fd);
+    return error;
+}
+
+// Sync each file once, stopping at the first failure; return the
+// error message, if any
+static std::string getSyncError(const std::vector<std::string>& paths) {
+    std::vector<std::string> synced_paths {};
+
+    for (const auto& path : paths) {
+        if (std::find(synced_paths.begin(), synced_paths.end(), path)
+                != synced_paths.end()) {
+            continue;
+        }
+
+        auto error = getSyncError(path);
+
+        if (!error.empty()) {
+            return error;
+        }
+
+        synced_paths.push_back(path);
+    }
+
+    return "";
+}
+
+void syncFiles(const std::vector<std::string>& paths) {
+    auto error = getSyncError(paths);
+
+    if (!error.empty()) {
+        throw commit_error { error };
+    }
+}
+
+GroupCommitWriter::GroupCommitWriter(bool sync)
+        : sync_ { sync },
+          pending_ {},
+          committing_ { false },
+          mutex_ {},
+          cond_var_ {} {
+}
+
+void GroupCommitWriter::setSync(bool sync) {
+    sync_ = sync;
+}
+
+bool GroupCommitWriter::isSyncing() const {
+    return sync_;
+}
+
+void GroupCommitWriter::write(const std::string& path, const std::string& content) {
+    write(Files { std::make_pair(path, content) });
+}
+
+void GroupCommitWriter::write(const Files& files) {
+    auto commit = std::make_shared<Commit>();
+    commit->done = false;
+
+    for (const auto& file : files) {
+        writeFile(file.first + TMP_SUFFIX, file.second);
+        commit->paths.push_back(file.first);
+    }
+
+    if (!sync_) {
+        for (const auto& path : commit->paths) {
+            if (std::rename((path + TMP_SUFFIX).c_str(), path.c_str()) == -1) {
+                throw commit_error { errnoMessage("rename the temporary file of",
+                                                  path) };
+            }
+        }
+
+        return;
+    }
+
+    lth_util::unique_lock<lth_util::mutex> the_lock { mutex_ };
+    pending_.push_back(commit);
+
+    while (!commit->done) {
+        if (committing_) {
+            // The current batch was collected before this commit was
+            // queued; wait for it, then commit the next one
+            cond_var_.wait(the_lock);
+            continue;
+        }
+
+        std::vector<std::shared_ptr<Commit>> batch {};
+        batch.swap(pending_);
+        committing_ = true;
+        the_lock.unlock();
+
+        commitBatch(batch);
+
+        the_lock.lock();
+        committing_ = false;
+
+        for (auto& batch_commit : batch) {
+            batch_commit->done = true;
+        }
+
+        cond_var_.notify_all();
+    }
+
+    if (!commit->error.empty()) {
+        throw commit_error { commit->error };
+    }
+}
+
+void GroupCommitWriter::commitBatch(const std::vector<std::shared_ptr<Commit>>& batch) {
+    std::vector<std::string> tmp_paths {};
+
+    for (const auto& commit : batch) {
+        for (const auto& path : commit->paths) {
+            tmp_paths.push_back(path + TMP_SUFFIX);
+        }
+    }
+
+    LOG_TRACE("Committing %1% files of %2% writers", tmp_paths.size(), batch.size());
+    auto error = getSyncError(tmp_paths);
+
+    if (!error.empty()) {
+        for (auto& commit : batch) {
+            commit->error = error;
+        }
+
+        return;
+    }
+
+    // NB: a failed rename stops the rename of the following files of
+    // the same commit, so that they're never renamed out of order
+    std::vector<std::string> dir_paths {};
+
+    for (auto& commit : batch) {
+        for (const auto& path : commit->paths) {
+            if (std::rename((path + TMP_SUFFIX).c_str(), path.c_str()) == -1) {
+                commit->error = errnoMessage("rename the temporary file of", path);
+                break;
+            }
+
+            auto dir_path = boost::filesystem::path(path).parent_path().string();
+
+            if (dir_path.empty()) {
+                dir_path = ".";
+            }
+
+            if (std::find(dir_paths.begin(), dir_paths.end(), dir_path)
+                    == dir_paths.end()) {
+                dir_paths.push_back(dir_path);
+            }
+        }
+    }
+
+    error = getSyncError(dir_paths);
+
+    if (!error.empty()) {
+        for (auto& commit : batch) {
+            if (commit->error.empty()) {
+                commit->error = error;
+            }
+        }
+    }
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,1550 @@
+#include <pxp-agent/util/posix/process.hpp>
+#include <pxp-agent/util/posix/pid_file.hpp>
+
+#include <leatherman/file_util/file.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.util.posix.process"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // memcpy(), strlen()
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <fcntl.h>          // open() and fcntl() flags
+#include <poll.h>           // poll()
+#include <signal.h>         // sigprocmask(), sigwait(), sigaction()
+#include <sys/resource.h>   // setrlimit(), setpriority()
+#include <sys/socket.h>     // socketpair(), sendmsg(), recvmsg()
+#include <sys/wait.h>       // waitpid(), wait4()
+#include <unistd.h>         // vfork(), fork(), execve(), dup2(), pipe()
+
+#ifdef __linux__
+#include <sys/syscall.h>    // SYS_ioprio_set
+#endif
+
+extern char** environ;
+
+namespace PXPAgent {
+namespace Util {
+
+namespace lth_file = leatherman::file_util;
+
+const std::string CPU_TIME_LIMIT { "cpu_time" };
+const std::string MEMORY_LIMIT { "memory" };
+const std::string OUTPUT_SIZE_LIMIT { "output_size" };
+
+static const std::string SHELL_PATH { "/bin/sh" };
+static const std::string WRAPPER_NAME { "pxp-action-wrapper" };
+
+// The first positional parameter is the exit code file; the others
+// are the command to be executed. The exit code is first written to
+// a temporary file and then moved, so that readers never see a
+// partially written file.
+static const std::string WRAPPER_SCRIPT {
+    "f=$1; shift; \"$@\"; c=$?; "
+    "echo $c > \"$f.tmp\" && mv -f \"$f.tmp\" \"$f\"; exit $c" };
+
+static const std::string PUMP_NAME { "pxp-output-pump" };
+
+// Copy the first $1 bytes of the standard input to the standard
+// output, then read and discard the rest, so that the writer is never
+// blocked nor broken by the limit.
+static const std::string PUMP_SCRIPT {
+    "head -c \"$1\"; exec cat > /dev/null" };
+
+// Position of the process start time in /proc/<pid>/stat, counting
+// from the process state field (the first one after the command name)
+static const size_t PROC_STAT_STARTTIME_IDX { 19 };
+
+// Exit code of a child that failed to apply its limits (as a shell
+// does for commands that cannot be executed)
+static const int LIMITS_FAILURE_EXITCODE { 126 };
+
+// Seconds of CPU time granted after SIGXCPU before the process is
+// killed by the hard limit
+static const rlim_t CPU_HARD_LIMIT_GRACE_S { 5 };
+
+static const int IOPRIO_WHO_PROCESS { 1 };
+static const int IOPRIO_CLASS_SHIFT { 13 };
+
+static const size_t READ_BUFFER_SIZE { 4096 };
+
+bool ProcessLimits::empty() const {
+    return cpu_seconds <= 0 && memory_mb <= 0 && open_files <= 0
+           && nice == 0 && ionice_class <= 0 && cgroup.empty();
+}
+
+Environment::Environment(std::vector<std::string> entries)
+        : entries_ { std::move(entries) },
+          envp_ {} {
+    setPointers();
+}
+
+Environment::Environment(const Environment& other)
+        : entries_ { other.entries_ },
+          envp_ {} {
+    setPointers();
+}
+
+Environment& Environment::operator=(const Environment& other) {
+    entries_ = other.entries_;
+    setPointers();
+    return *this;
+}
+
+void Environment::setPointers() {
+    envp_.clear();
+    for (auto& entry : entries_) {
+        envp_.push_back(const_cast<char*>(entry.c_str()));
+    }
+    envp_.push_back(nullptr);
+}
+
+Environment Environment::build(const std::map<std::string, std::string>& variables,
+                               bool inherit) {
+    std::vector<std::string> entries {};
+
+    if (inherit) {
+        for (auto entry = environ; *entry != nullptr; ++entry) {
+            std::string entry_txt { *entry };
+            auto name = entry_txt.substr(0, entry_txt.find('='));
+
+            if (variables.find(name) == variables.end()) {
+                entries.push_back(std::move(entry_txt));
+            }
+        }
+    }
+
+    for (auto& variable : variables) {
+        entries.push_back(variable.first + "=" + variable.second);
+    }
+
+    return Environment { std::move(entries) };
+}
+
+static void setCloseOnExec(int fd) {
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+static int openOutputFile(const std::string& path) {
+    auto fd = open(path.data(), O_WRONLY | O_CREAT | O_TRUNC, 0640);
+
+    if (fd == -1) {
+        throw process_error { "failed to open '" + path + "'; errno="
+                              + std::to_string(errno) };
+    }
+
+    setCloseOnExec(fd);
+    return fd;
+}
+
+static void createPipe(int fds[2], const std::string& name) {
+    if (pipe(fds) == -1) {
+        throw process_error { "failed to create the " + name + " pipe; errno="
+                              + std::to_string(errno) };
+    }
+
+    setCloseOnExec(fds[0]);
+    setCloseOnExec(fds[1]);
+}
+
+static void closeFds(std::initializer_list<int> fds) {
+    for (auto fd : fds) {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+}
+
+//
+// Child process helpers; they must be async-signal-safe
+//
+
+static void writeChildError(const char* msg) {
+    size_t len { 0 };
+    while (msg[len] != '\0') {
+        len++;
+    }
+
+    while (write(STDERR_FILENO, msg, len) == -1 && errno == EINTR) {}
+}
+
+// Lower the soft and hard values of the specified resource limit;
+// the current hard value can't be exceeded by unprivileged processes
+static bool lowerRLimit(int resource, rlim_t soft, rlim_t hard) {
+    struct rlimit current;
+
+    if (getrlimit(resource, &current) == -1) {
+        return false;
+    }
+
+    if (current.rlim_max != RLIM_INFINITY) {
+        soft = std::min(soft, current.rlim_max);
+        hard = std::min(hard, current.rlim_max);
+    }
+
+    struct rlimit limit { soft, hard };
+    return setrlimit(resource, &limit) == 0;
+}
+
+static bool applyLimits(const ProcessLimits& limits, const char* cgroup_procs_path) {
+    if (cgroup_procs_path != nullptr) {
+        auto fd = open(cgroup_procs_path, O_WRONLY);
+        // NB: writing "0" moves the calling process
+        if (fd == -1 || write(fd, "0", 1) != 1) {
+            writeChildError("pxp-agent: failed to join the cgroup\n");
+            return false;
+        }
+        close(fd);
+    }
+
+    if (limits.cpu_seconds > 0) {
+        rlim_t cpu_s = limits.cpu_seconds;
+        if (!lowerRLimit(RLIMIT_CPU, cpu_s, cpu_s + CPU_HARD_LIMIT_GRACE_S)) {
+            writeChildError("pxp-agent: failed to set the cpu_seconds limit\n");
+            return false;
+        }
+    }
+
+    if (limits.memory_mb > 0) {
+        rlim_t bytes = static_cast<rlim_t>(limits.memory_mb) * 1024 * 1024;
+        if (!lowerRLimit(RLIMIT_AS, bytes, bytes)) {
+            writeChildError("pxp-agent: failed to set the memory_mb limit\n");
+            return false;
+        }
+    }
+
+    if (limits.open_files > 0) {
+        rlim_t num_files = limits.open_files;
+        if (!lowerRLimit(RLIMIT_NOFILE, num_files, num_files)) {
+            writeChildError("pxp-agent: failed to set the open_files limit\n");
+            return false;
+        }
+    }
+
+    if (limits.nice != 0 && setpriority(PRIO_PROCESS, 0, limits.nice) == -1) {
+        writeChildError("pxp-agent: failed to set the nice level\n");
+        return false;
+    }
+
+#ifdef __linux__
+    if (limits.ionice_class > 0) {
+        int ioprio = (limits.ionice_class << IOPRIO_CLASS_SHIFT) | limits.ionice_level;
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, ioprio) == -1) {
+            writeChildError("pxp-agent: failed to set the I/O priority\n");
+            return false;
+        }
+    }
+#endif
+
+    return true;
+}
+
+// Close all file descriptors starting from first_fd
+static void closeInheritedFds(int first_fd, long max_fd) {
+#if defined(__linux__) && defined(SYS_close_range)
+    if (syscall(SYS_close_range, first_fd, ~0U, 0) == 0) {
+        return;
+    }
+#endif
+    for (int fd = first_fd; fd < max_fd; fd++) {
+        close(fd);
+    }
+}
+
+// Restore the default disposition of the signals handled by the
+// agent, so that no agent handler runs in the child before exec
+static void resetSignalHandlers() {
+    for (int sig = 1; sig < NSIG; sig++) {
+        struct sigaction action;
+
+        if (sigaction(sig, nullptr, &action) == 0
+                && action.sa_handler != SIG_DFL
+                && action.sa_handler != SIG_IGN) {
+            action.sa_handler = SIG_DFL;
+            sigaction(sig, &action, nullptr);
+        }
+    }
+}
+
+// Create a child of the agent that redirects its standard streams to
+// the specified file descriptors, applies the limits, and executes
+// argv[0] with the specified environment (the agent one, if null).
+// Return the PID of the child; throw a process_error if the child
+// can't be created.
+// On Linux the child is created with vfork(): it shares the agent
+// memory until exec, so its creation cost doesn't depend on the agent
+// size, as it does for fork() that copies the page tables. The child
+// only performs system calls on memory prepared by the suspended
+// caller; all signals are blocked until the child resets the agent
+// handlers, so that none can run in the shared address space.
+static pid_t forkChild(std::vector<char*>& argv,
+                       int in_fd, int out_fd, int err_fd,
+                       const ProcessLimits& limits,
+                       const Environment* environment) {
+    auto envp = environment != nullptr ? environment->envp() : environ;
+
+    // Prepare everything before creating the child; after that, the
+    // child can only call async-signal-safe functions
+    auto max_fd = sysconf(_SC_OPEN_MAX);
+    if (max_fd < 0) {
+        max_fd = 1024;
+    }
+
+    std::string cgroup_procs_path {};
+    if (!limits.cgroup.empty()) {
+        cgroup_procs_path = limits.cgroup + "/cgroup.procs";
+    }
+
+    auto cgroup_procs = cgroup_procs_path.empty() ? nullptr
+                                                  : cgroup_procs_path.data();
+
+    sigset_t all_mask;
+    sigset_t orig_mask;
+    sigfillset(&all_mask);
+    pthread_sigmask(SIG_SETMASK, &all_mask, &orig_mask);
+
+#ifdef __linux__
+    auto pid = vfork();
+#else
+    auto pid = fork();
+#endif
+
+    if (pid == 0) {
+        // CHILD
+        resetSignalHandlers();
+        sigprocmask(SIG_SETMASK, &orig_mask, nullptr);
+
+        if (dup2(in_fd, STDIN_FILENO) == -1
+                || dup2(out_fd, STDOUT_FILENO) == -1
+                || dup2(err_fd, STDERR_FILENO) == -1) {
+            _exit(127);
+        }
+
+        // Fail closed: never execute the command without its limits
+        if (!applyLimits(limits, cgroup_procs)) {
+            _exit(LIMITS_FAILURE_EXITCODE);
+        }
+
+        closeInheritedFds(3, max_fd);
+        execve(argv[0], argv.data(), envp);
+        _exit(127);
+    }
+
+    auto spawn_errno = errno;
+    pthread_sigmask(SIG_SETMASK, &orig_mask, nullptr);
+
+    if (pid == -1) {
+        throw process_error { "failed to create the child process; errno="
+                              + std::to_string(spawn_errno) };
+    }
+
+    return pid;
+}
+
+static bool spawnWithForkServer(std::vector<char*>& argv,
+                                int in_fd, int out_fd, int err_fd,
+                                const ProcessLimits& limits,
+                                const Environment* environment,
+                                pid_t& pid);
+
+// Create the child as forkChild() does, through the fork server if
+// running; its outcome must then be collected by waitForProcess()
+static pid_t spawnChild(std::vector<char*>& argv,
+                        int in_fd, int out_fd, int err_fd,
+                        const ProcessLimits& limits,
+                        const Environment* environment) {
+    pid_t server_child_pid;
+    if (spawnWithForkServer(argv, in_fd, out_fd, err_fd, limits, environment,
+                            server_child_pid)) {
+        return server_child_pid;
+    }
+
+    return forkChild(argv, in_fd, out_fd, err_fd, limits, environment);
+}
+
+static std::vector<char*> getArgv(std::vector<std::string>& argv_strings) {
+    std::vector<char*> argv {};
+    for (auto& arg : argv_strings) {
+        argv.push_back(const_cast<char*>(arg.data()));
+    }
+    argv.push_back(nullptr);
+    return argv;
+}
+
+// Block SIGPIPE for the calling thread, so that a child that exits
+// without consuming its input does not terminate the agent; the
+// original signal mask is restored on destruction, after consuming
+// a possible pending SIGPIPE.
+class SigpipeGuard {
+  public:
+    SigpipeGuard() {
+        sigemptyset(&pipe_mask_);
+        sigaddset(&pipe_mask_, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipe_mask_, &orig_mask_);
+    }
+
+    ~SigpipeGuard() {
+        sigset_t pending_mask;
+        sigemptyset(&pending_mask);
+        if (sigpending(&pending_mask) == 0 && sigismember(&pending_mask, SIGPIPE)) {
+            int sig;
+            sigwait(&pipe_mask_, &sig);
+        }
+
+        pthread_sigmask(SIG_SETMASK, &orig_mask_, nullptr);
+    }
+
+  private:
+    sigset_t pipe_mask_;
+    sigset_t orig_mask_;
+};
+
+// Write the input text to the pipe
+static void writeInput(int fd, const std::string& input) {
+    SigpipeGuard sigpipe_guard {};
+    size_t written { 0 };
+
+    while (written < input.size()) {
+        auto n = write(fd, input.data() + written, input.size() - written);
+
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            LOG_DEBUG("Failed to write the process input; errno=%1%", errno);
+            break;
+        }
+
+        written += n;
+    }
+}
+
+// Read the available data from the specified pipe into the buffer;
+// once the buffer reaches max_size (if not zero), the data is read
+// and discarded, so that the child does not block on a full pipe.
+// Return false once the pipe is exhausted or broken.
+static bool readChunk(int fd, std::string& buffer, size_t max_size) {
+    char chunk[READ_BUFFER_SIZE];
+    auto n = read(fd, chunk, sizeof(chunk));
+
+    if (n > 0) {
+        size_t size = n;
+
+        if (max_size > 0) {
+            size = std::min(size, max_size - std::min(max_size, buffer.size()));
+        }
+
+        buffer.append(chunk, size);
+        return true;
+    }
+
+    return n == -1 && (errno == EINTR || errno == EAGAIN);
+}
+
+// Write the input to in_fd while reading out_fd and err_fd, until
+// the child closes its output pipes; multiplexing avoids deadlocks
+// when the child fills an output pipe before consuming its input.
+// At most max_output_size and max_error_size bytes are collected
+// (zero means no limit). All file descriptors are closed on return.
+static void communicate(int in_fd, int out_fd, int err_fd,
+                        const std::string& input,
+                        std::string& output,
+                        std::string& error,
+                        size_t max_output_size,
+                        size_t max_error_size) {
+    SigpipeGuard sigpipe_guard {};
+    size_t written { 0 };
+
+    if (input.empty()) {
+        close(in_fd);
+        in_fd = -1;
+    } else {
+        fcntl(in_fd, F_SETFL, fcntl(in_fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    while (in_fd != -1 || out_fd != -1 || err_fd != -1) {
+        // NB: negative fds are ignored by poll()
+        struct pollfd fds[3] = { { in_fd, POLLOUT, 0 },
+                                 { out_fd, POLLIN, 0 },
+                                 { err_fd, POLLIN, 0 } };
+
+        if (poll(fds, 3, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            LOG_DEBUG("Failed to poll the process pipes; errno=%1%", errno);
+            break;
+        }
+
+        if (in_fd != -1 && fds[0].revents != 0) {
+            auto n = write(in_fd, input.data() + written, input.size() - written);
+
+            if (n > 0) {
+                written += n;
+            } else if (n == -1 && errno != EINTR && errno != EAGAIN) {
+                LOG_DEBUG("Failed to write the process input; errno=%1%", errno);
+                written = input.size();
+            }
+
+            if (written == input.size()) {
+                close(in_fd);
+                in_fd = -1;
+            }
+        }
+
+        if (out_fd != -1 && fds[1].revents != 0 && !readChunk(out_fd, output, max_output_size)) {
+            close(out_fd);
+            out_fd = -1;
+        }
+
+        if (err_fd != -1 && fds[2].revents != 0 && !readChunk(err_fd, error, max_error_size)) {
+            close(err_fd);
+            err_fd = -1;
+        }
+    }
+
+    closeFds({ in_fd, out_fd, err_fd });
+}
+
+//
+// Fork server
+//
+
+// A spawn request is a single message made of the header, followed by
+// the NUL-terminated cgroup path, arguments, and environment entries;
+// it carries the child standard streams and the socket its outcome is
+// reported to
+struct SpawnRequestHeader {
+    int cpu_seconds;
+    int memory_mb;
+    int open_files;
+    int nice;
+    int ionice_class;
+    int ionice_level;
+    int argc;
+    // -1 if the child inherits the server environment
+    int envc;
+};
+
+// Reported on the status socket, after the PID of the child, once the
+// child terminates
+struct SpawnOutcome {
+    int exitcode;
+    double user_cpu_s;
+    double system_cpu_s;
+    long max_rss_kb;
+    long read_blocks;
+    long written_blocks;
+};
+
+static const size_t MAX_SPAWN_REQUEST_SIZE { 64 * 1024 };
+static const int NUM_SPAWN_FDS { 4 };
+static const int FORK_SERVER_CONTROL_FD { 3 };
+
+// Agent end of the fork server socket (-1 if not running) and PID of
+// the fork server
+static std::atomic<int> fork_server_fd { -1 };
+static pid_t fork_server_pid { -1 };
+
+// Children created by the fork server or by a preloader, which can't
+// be waited for by the agent, with the socket their outcome is
+// reported to
+struct RemoteChild {
+    int status_fd;
+    // The outcome of preloaded children is reported as text
+    bool preloaded;
+};
+
+static PCPClient::Util::mutex remote_children_mutex;
+static std::map<pid_t, RemoteChild> remote_children;
+
+static void addRemoteChild(pid_t pid, int status_fd, bool preloaded) {
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock {
+        remote_children_mutex };
+    remote_children[pid] = RemoteChild { status_fd, preloaded };
+}
+
+static bool readFully(int fd, void* buffer, size_t size) {
+    auto data = static_cast<char*>(buffer);
+
+    while (size > 0) {
+        auto n = read(fd, data, size);
+
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            return false;
+        }
+
+        data += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static bool writeFully(int fd, const void* buffer, size_t size) {
+    auto data = static_cast<const char*>(buffer);
+
+    while (size > 0) {
+        auto n = write(fd, data, size);
+
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            return false;
+        }
+
+        data += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+// Read a "<number>\n" line, as written by preloaders
+static bool readStatusLine(int fd, long& value) {
+    std::string line {};
+    char c;
+
+    while (line.size() < 32) {
+        if (!readFully(fd, &c, 1)) {
+            return false;
+        }
+
+        if (c == '\n') {
+            try {
+                value = std::stol(line);
+                return true;
+            } catch (const std::exception&) {
+                return false;
+            }
+        }
+
+        line.push_back(c);
+    }
+
+    return false;
+}
+
+// Send the payload with the specified descriptors as a single message;
+// return false and set errno in case of failure
+static bool sendWithFds(int socket_fd,
+                        const std::string& payload,
+                        const int fds[],
+                        int num_fds) {
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int) * NUM_SPAWN_FDS)];
+    } control;
+    std::memset(&control, 0, sizeof(control));
+    struct iovec iov { const_cast<char*>(payload.data()), payload.size() };
+    struct msghdr msg {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
+
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * num_fds);
+
+    while (sendmsg(socket_fd, &msg, MSG_NOSIGNAL) == -1) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Executed by the monitor process that the fork server creates for
+// each request: spawn the child, report its PID, wait for it, and
+// report its outcome. Never returns.
+static void runMonitor(const char* request, size_t size, const int fds[]) {
+    signal(SIGCHLD, SIG_DFL);
+    close(FORK_SERVER_CONTROL_FD);
+
+    SpawnRequestHeader header;
+    std::memcpy(&header, request, sizeof(header));
+
+    ProcessLimits limits {};
+    limits.cpu_seconds = header.cpu_seconds;
+    limits.memory_mb = header.memory_mb;
+    limits.open_files = header.open_files;
+    limits.nice = header.nice;
+    limits.ionice_class = header.ionice_class;
+    limits.ionice_level = header.ionice_level;
+
+    // NB: the request was NUL-terminated by the server
+    auto txt = request + sizeof(header);
+    limits.cgroup = txt;
+    txt += limits.cgroup.size() + 1;
+
+    std::vector<std::string> argv_strings {};
+    for (int i = 0; i < header.argc && txt < request + size; i++) {
+        argv_strings.push_back(txt);
+        txt += argv_strings.back().size() + 1;
+    }
+
+    std::vector<std::string> env_entries {};
+    for (int i = 0; i < header.envc && txt < request + size; i++) {
+        env_entries.push_back(txt);
+        txt += env_entries.back().size() + 1;
+    }
+
+    auto argv = getArgv(argv_strings);
+    Environment environment { std::move(env_entries) };
+    auto status_fd = fds[3];
+    pid_t pid { -1 };
+
+    try {
+        if (!argv_strings.empty()) {
+            pid = spawnChild(argv, fds[0], fds[1], fds[2], limits,
+                             (header.envc >= 0 ? &environment : nullptr));
+        }
+    } catch (const process_error&) {
+    }
+
+    // The child holds the standard streams; the agent must see EOF
+    // on its pipes once the child terminates
+    closeFds({ fds[0], fds[1], fds[2] });
+
+    int reported_pid = pid;
+    if (!writeFully(status_fd, &reported_pid, sizeof(reported_pid)) || pid == -1) {
+        _exit(EXIT_FAILURE);
+    }
+
+    try {
+        ResourceUsage usage {};
+        SpawnOutcome outcome {};
+        outcome.exitcode = waitForProcess(pid, usage);
+        outcome.user_cpu_s = usage.user_cpu_s;
+        outcome.system_cpu_s = usage.system_cpu_s;
+        outcome.max_rss_kb = usage.max_rss_kb;
+        outcome.read_blocks = usage.read_blocks;
+        outcome.written_blocks = usage.written_blocks;
+        writeFully(status_fd, &outcome, sizeof(outcome));
+    } catch (const process_error&) {
+        _exit(EXIT_FAILURE);
+    }
+
+    _exit(EXIT_SUCCESS);
+}
+
+// Main loop of the fork server; it terminates once the agent closes
+// its end of the control socket. Never returns.
+static void runForkServer(int control_fd) {
+    // The server is single-threaded and must not run agent code
+    fork_server_fd = -1;
+    resetSignalHandlers();
+    signal(SIGHUP, SIG_IGN);
+    // Monitors are reaped automatically
+    signal(SIGCHLD, SIG_IGN);
+
+    sigset_t empty_mask;
+    sigemptyset(&empty_mask);
+    sigprocmask(SIG_SETMASK, &empty_mask, nullptr);
+
+    // Release the agent descriptors (e.g. the PID file lock)
+    if (control_fd != FORK_SERVER_CONTROL_FD) {
+        dup2(control_fd, FORK_SERVER_CONTROL_FD);
+    }
+    auto max_fd = sysconf(_SC_OPEN_MAX);
+    closeInheritedFds(FORK_SERVER_CONTROL_FD + 1, (max_fd < 0 ? 1024 : max_fd));
+
+    std::vector<char> request(MAX_SPAWN_REQUEST_SIZE + 1);
+
+    for (;;) {
+        union {
+            struct cmsghdr align;
+            char buffer[CMSG_SPACE(sizeof(int) * NUM_SPAWN_FDS)];
+        } control;
+        struct iovec iov { request.data(), MAX_SPAWN_REQUEST_SIZE };
+        struct msghdr msg {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+
+        auto n = recvmsg(FORK_SERVER_CONTROL_FD, &msg, 0);
+
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            _exit(n == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+
+        int fds[NUM_SPAWN_FDS] { -1, -1, -1, -1 };
+        auto cmsg = CMSG_FIRSTHDR(&msg);
+        auto valid = cmsg != nullptr
+                     && cmsg->cmsg_level == SOL_SOCKET
+                     && cmsg->cmsg_type == SCM_RIGHTS
+                     && cmsg->cmsg_len == CMSG_LEN(sizeof(fds))
+                     && !(msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+                     && static_cast<size_t>(n) > sizeof(SpawnRequestHeader);
+
+        if (cmsg != nullptr && cmsg->cmsg_type == SCM_RIGHTS) {
+            auto num_fds = std::min((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int),
+                                    static_cast<size_t>(NUM_SPAWN_FDS));
+            std::memcpy(fds, CMSG_DATA(cmsg), num_fds * sizeof(int));
+        }
+
+        if (valid) {
+            request[n] = '\0';
+            // NB: a monitor whose creation fails closes the status
+            // socket, so the agent gets EOF instead of the PID
+            if (fork() == 0) {
+                runMonitor(request.data(), n, fds);
+            }
+        }
+
+        closeFds({ fds[0], fds[1], fds[2], fds[3] });
+    }
+}
+
+// Send the spawn request to the fork server; return false in case the
+// server is not running or is not reachable
+static bool sendSpawnRequest(int control_fd,
+                             std::vector<char*>& argv,
+                             const ProcessLimits& limits,
+                             const Environment* environment,
+                             const int fds[]) {
+    SpawnRequestHeader header { limits.cpu_seconds, limits.memory_mb,
+                                limits.open_files, limits.nice,
+                                limits.ionice_class, limits.ionice_level, 0, -1 };
+    std::string payload {};
+    payload.append(limits.cgroup.c_str(), limits.cgroup.size() + 1);
+
+    for (auto arg : argv) {
+        if (arg != nullptr) {
+            payload.append(arg, std::strlen(arg) + 1);
+            header.argc++;
+        }
+    }
+
+    if (environment != nullptr) {
+        header.envc = environment->entries().size();
+        for (auto& entry : environment->entries()) {
+            payload.append(entry.c_str(), entry.size() + 1);
+        }
+    }
+
+    payload.insert(0, reinterpret_cast<const char*>(&header), sizeof(header));
+
+    if (payload.size() > MAX_SPAWN_REQUEST_SIZE) {
+        LOG_DEBUG("The spawn request exceeds %1% bytes; the process will be "
+                  "spawned by the agent", MAX_SPAWN_REQUEST_SIZE);
+        return false;
+    }
+
+    if (!sendWithFds(control_fd, payload, fds, NUM_SPAWN_FDS)) {
+        LOG_WARNING("The fork server is not reachable (errno=%1%); "
+                    "processes will be spawned by the agent", errno);
+        stopForkServer();
+        return false;
+    }
+
+    return true;
+}
+
+// Spawn the child through the fork server; return false, without
+// spawning it, in case the server is not available.
+// Throw a process_error in case the server fails to spawn it.
+static bool spawnWithForkServer(std::vector<char*>& argv,
+                                int in_fd, int out_fd, int err_fd,
+                                const ProcessLimits& limits,
+                                const Environment* environment,
+                                pid_t& pid) {
+    auto control_fd = fork_server_fd.load();
+
+    if (control_fd == -1) {
+        return false;
+    }
+
+    int status_fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, status_fds) == -1) {
+        return false;
+    }
+
+    setCloseOnExec(status_fds[0]);
+    setCloseOnExec(status_fds[1]);
+
+    int fds[NUM_SPAWN_FDS] { in_fd, out_fd, err_fd, status_fds[1] };
+    auto sent = sendSpawnRequest(control_fd, argv, limits, environment, fds);
+    close(status_fds[1]);
+
+    if (!sent) {
+        close(status_fds[0]);
+        return false;
+    }
+
+    int child_pid;
+
+    if (!readFully(status_fds[0], &child_pid, sizeof(child_pid))) {
+        close(status_fds[0]);
+        throw process_error { "the fork server failed to create the process" };
+    }
+
+    addRemoteChild(child_pid, status_fds[0], false);
+    pid = child_pid;
+    return true;
+}
+
+// Wait for the outcome of a child created by a preloader; its resource
+// usage is not known
+static int waitForPreloadedChild(pid_t pid, int status_fd) {
+    long exitcode;
+    auto received = readStatusLine(status_fd, exitcode);
+    close(status_fd);
+
+    if (!received) {
+        throw process_error { "lost the outcome of process "
+                              + std::to_string(pid) + "; the preloader "
+                              "terminated" };
+    }
+
+    return static_cast<int>(exitcode);
+}
+
+// Wait for the outcome of a child created by the fork server
+static int waitForServerChild(pid_t pid, int status_fd, ResourceUsage& usage) {
+    SpawnOutcome outcome;
+    auto received = readFully(status_fd, &outcome, sizeof(outcome));
+    close(status_fd);
+
+    if (!received) {
+        throw process_error { "lost the outcome of process "
+                              + std::to_string(pid) + "; the fork server "
+                              "monitor terminated" };
+    }
+
+    usage.user_cpu_s = outcome.user_cpu_s;
+    usage.system_cpu_s = outcome.system_cpu_s;
+    usage.max_rss_kb = outcome.max_rss_kb;
+    usage.read_blocks = outcome.read_blocks;
+    usage.written_blocks = outcome.written_blocks;
+    return outcome.exitcode;
+}
+
+//
+// Public interface
+//
+
+void startForkServer() {
+    if (fork_server_fd != -1) {
+        return;
+    }
+
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == -1) {
+        throw process_error { "failed to create the fork server socket; errno="
+                              + std::to_string(errno) };
+    }
+
+    auto pid = fork();
+
+    if (pid == 0) {
+        close(fds[0]);
+        runForkServer(fds[1]);
+    }
+
+    close(fds[1]);
+
+    if (pid == -1) {
+        close(fds[0]);
+        throw process_error { "failed to fork the fork server; errno="
+                              + std::to_string(errno) };
+    }
+
+    setCloseOnExec(fds[0]);
+    fork_server_pid = pid;
+    fork_server_fd = fds[0];
+    LOG_INFO("Started the fork server with PID %1%", pid);
+}
+
+void stopForkServer() {
+    auto control_fd = fork_server_fd.exchange(-1);
+
+    if (control_fd == -1) {
+        return;
+    }
+
+    // The server terminates once the socket is closed; the monitors
+    // of the executing processes keep running
+    close(control_fd);
+    while (waitpid(fork_server_pid, nullptr, 0) == -1 && errno == EINTR) {}
+    LOG_INFO("Stopped the fork server");
+}
+
+static const std::string PRELOADER_READY_MESSAGE { "ready" };
+
+// Children of the agent to be reaped once terminated, e.g. preloaders
+// that were stopped; a single thread reaps them and exits once none is
+// left
+struct Reaper {
+    PCPClient::Util::mutex mutex;
+    PCPClient::Util::condition_variable cond_var;
+    std::vector<pid_t> pids;
+    bool running;
+};
+
+// NB: the reaper is never destroyed, as its thread may outlive the
+// static objects at exit
+static Reaper& getReaper() {
+    static auto reaper = new Reaper {};
+    return *reaper;
+}
+
+// Interval between the checks of the processes to be reaped
+static const std::chrono::milliseconds REAPER_INTERVAL { 200 };
+
+static void runReaper() {
+    auto& reaper = getReaper();
+    PCPClient::Util::unique_lock<PCPClient::Util::mutex> the_lock { reaper.mutex };
+
+    while (!reaper.pids.empty()) {
+        auto pid_itr = reaper.pids.begin();
+
+        while (pid_itr != reaper.pids.end()) {
+            auto result = waitpid(*pid_itr, nullptr, WNOHANG);
+
+            if (result == 0 || (result == -1 && errno == EINTR)) {
+                ++pid_itr;
+            } else {
+                pid_itr = reaper.pids.erase(pid_itr);
+            }
+        }
+
+        if (!reaper.pids.empty()) {
+            reaper.cond_var.wait_for(the_lock, REAPER_INTERVAL);
+        }
+    }
+
+    reaper.running = false;
+}
+
+// Reap the process without blocking the caller
+static void waitAsync(pid_t pid) {
+    auto& reaper = getReaper();
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { reaper.mutex };
+    reaper.pids.push_back(pid);
+
+    if (!reaper.running) {
+        reaper.running = true;
+        PCPClient::Util::thread { runReaper }.detach();
+    }
+}
+
+Preloader::Preloader(const std::string& file,
+                     const std::vector<std::string>& arguments,
+                     const ProcessLimits& limits,
+                     const Environment* environment,
+                     int ready_timeout_s)
+        : pid_ { -1 },
+          control_fd_ { -1 },
+          limits_ { limits } {
+    std::vector<std::string> argv_strings { file };
+    argv_strings.insert(argv_strings.end(), arguments.begin(), arguments.end());
+    auto argv = getArgv(argv_strings);
+
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == -1) {
+        throw process_error { "failed to create the preloader socket; errno="
+                              + std::to_string(errno) };
+    }
+
+    setCloseOnExec(fds[0]);
+    setCloseOnExec(fds[1]);
+    auto null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+
+    try {
+        if (null_fd == -1) {
+            throw process_error { "failed to open /dev/null; errno="
+                                  + std::to_string(errno) };
+        }
+
+        // NB: the preloader errors go to the agent stderr; it's not
+        // created by the fork server, as it's reaped by waitAsync()
+        pid_ = forkChild(argv, fds[1], null_fd, STDERR_FILENO, limits, environment);
+    } catch (const process_error&) {
+        closeFds({ fds[0], fds[1], null_fd });
+        throw;
+    }
+
+    closeFds({ fds[1], null_fd });
+    control_fd_ = fds[0];
+
+    struct pollfd poll_fd { control_fd_, POLLIN, 0 };
+    auto deadline = std::chrono::steady_clock::now()
+                    + std::chrono::seconds(ready_timeout_s);
+    int ready { 0 };
+
+    do {
+        auto remaining_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        ready = poll(&poll_fd, 1,
+                     static_cast<int>(std::max<long long>(remaining_ms, 0)));
+    } while (ready == -1 && errno == EINTR);
+
+    char message[16];
+    auto n = ready == 1 ? recv(control_fd_, message, sizeof(message), 0) : -1;
+
+    if (n <= 0 || std::string(message, n) != PRELOADER_READY_MESSAGE) {
+        // The preloader exits once the socket is closed
+        close(control_fd_);
+        waitAsync(pid_);
+        throw process_error { "the preloader '" + file + "' "
+                              + (ready == 0 ? "did not get ready in time"
+                                            : "failed to start") };
+    }
+
+    LOG_DEBUG("The preloader '%1%' is ready with PID %2%", file, pid_);
+}
+
+Preloader::~Preloader() {
+    close(control_fd_);
+    waitAsync(pid_);
+}
+
+bool Preloader::running() const {
+    struct pollfd poll_fd { control_fd_, POLLOUT, 0 };
+    return poll(&poll_fd, 1, 0) == 1
+           && !(poll_fd.revents & (POLLHUP | POLLERR));
+}
+
+pid_t Preloader::spawn(const std::string& action,
+                       int in_fd, int out_fd, int err_fd,
+                       const std::string& exitcode_path) {
+    int status_fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, status_fds) == -1) {
+        throw process_error { "failed to create the status socket; errno="
+                              + std::to_string(errno) };
+    }
+
+    setCloseOnExec(status_fds[0]);
+    setCloseOnExec(status_fds[1]);
+
+    std::string payload { action };
+    payload.push_back('\0');
+    payload += exitcode_path;
+
+    int fds[NUM_SPAWN_FDS] { in_fd, out_fd, err_fd, status_fds[1] };
+    auto sent = sendWithFds(control_fd_, payload, fds, NUM_SPAWN_FDS);
+    auto send_errno = errno;
+    close(status_fds[1]);
+
+    if (!sent) {
+        close(status_fds[0]);
+        throw process_error { "the preloader is not reachable; errno="
+                              + std::to_string(send_errno) };
+    }
+
+    long child_pid;
+
+    if (!readStatusLine(status_fds[0], child_pid) || child_pid <= 0) {
+        close(status_fds[0]);
+        throw process_error { "the preloader failed to create the process" };
+    }
+
+    addRemoteChild(child_pid, status_fds[0], true);
+    return child_pid;
+}
+
+// Pumps that copy the output of the wrapped processes to their files,
+// by wrapped process PID; they are waited for by waitForProcess()
+static PCPClient::Util::mutex output_pumps_mutex;
+static std::map<pid_t, std::vector<pid_t>> output_pumps;
+
+// Open the specified output file and return the file descriptor the
+// process must write to; in case max_size is not zero, that's a pipe
+// read by a pump process that stores no more than max_size bytes in
+// the file, whose PID is appended to pump_pids.
+static int openOutput(const std::string& path,
+                      size_t max_size,
+                      std::vector<pid_t>& pump_pids) {
+    auto file_fd = openOutputFile(path);
+
+    if (max_size == 0) {
+        return file_fd;
+    }
+
+    int pump_pipe[2] { -1, -1 };
+    std::vector<std::string> argv_strings { SHELL_PATH, "-c", PUMP_SCRIPT,
+                                            PUMP_NAME, std::to_string(max_size) };
+    auto argv = getArgv(argv_strings);
+
+    try {
+        createPipe(pump_pipe, "output");
+        // NB: the pump errors go to the agent stderr
+        pump_pids.push_back(forkChild(argv, pump_pipe[0], file_fd, STDERR_FILENO,
+                                      ProcessLimits {}, nullptr));
+    } catch (const process_error&) {
+        closeFds({ file_fd, pump_pipe[0], pump_pipe[1] });
+        throw;
+    }
+
+    closeFds({ file_fd, pump_pipe[0] });
+    return pump_pipe[1];
+}
+
+// Creates a child with the specified standard streams
+using Spawner = std::function<pid_t(int in_fd, int out_fd, int err_fd)>;
+
+static pid_t spawnWithFiles(const Spawner& spawner,
+                            const std::string& file,
+                            const std::string& input,
+                            const std::string& stdout_path,
+                            const std::string& stderr_path,
+                            size_t max_output_size,
+                            size_t max_error_size) {
+    std::vector<pid_t> pump_pids {};
+    auto out_fd = openOutput(stdout_path, max_output_size, pump_pids);
+    int err_fd { -1 };
+    int in_pipe[2] { -1, -1 };
+    pid_t pid;
+
+    try {
+        err_fd = openOutput(stderr_path, max_error_size, pump_pids);
+        createPipe(in_pipe, "input");
+        pid = spawner(in_pipe[0], out_fd, err_fd);
+    } catch (const process_error&) {
+        // NB: the pumps exit once their pipes are closed
+        closeFds({ out_fd, err_fd, in_pipe[0], in_pipe[1] });
+        for (auto pump_pid : pump_pids) {
+            waitAsync(pump_pid);
+        }
+        throw;
+    }
+
+    closeFds({ in_pipe[0], out_fd, err_fd });
+    LOG_DEBUG("Spawned '%1%' with PID %2%", file, pid);
+
+    if (!pump_pids.empty()) {
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock {
+            output_pumps_mutex };
+        output_pumps[pid] = std::move(pump_pids);
+    }
+
+    if (!input.empty()) {
+        writeInput(in_pipe[1], input);
+    }
+
+    close(in_pipe[1]);
+    return pid;
+}
+
+pid_t spawnWrapped(const std::string& file,
+                   const std::vector<std::string>& arguments,
+                   const std::string& input,
+                   const std::string& stdout_path,
+                   const std::string& stderr_path,
+                   const std::string& exitcode_path,
+                   const ProcessLimits& limits,
+                   const Environment* environment,
+                   size_t max_output_size,
+                   size_t max_error_size) {
+    std::vector<std::string> argv_strings { SHELL_PATH, "-c", WRAPPER_SCRIPT,
+                                            WRAPPER_NAME, exitcode_path, file };
+    argv_strings.insert(argv_strings.end(), arguments.begin(), arguments.end());
+    auto argv = getArgv(argv_strings);
+
+    return spawnWithFiles(
+        [&](int in_fd, int out_fd, int err_fd) {
+            return spawnChild(argv, in_fd, out_fd, err_fd, limits, environment);
+        },
+        file, input, stdout_path, stderr_path, max_output_size, max_error_size);
+}
+
+pid_t spawnWrapped(Preloader& preloader,
+                   const std::string& action,
+                   const std::string& input,
+                   const std::string& stdout_path,
+                   const std::string& stderr_path,
+                   const std::string& exitcode_path,
+                   size_t max_output_size,
+                   size_t max_error_size) {
+    return spawnWithFiles(
+        [&](int in_fd, int out_fd, int err_fd) {
+            return preloader.spawn(action, in_fd, out_fd, err_fd, exitcode_path);
+        },
+        action, input, stdout_path, stderr_path, max_output_size, max_error_size);
+}
+
+static ExecutionResult executeWith(const Spawner& spawner,
+                                   const std::string& file,
+                                   const std::string& input,
+                                   const ProcessLimits& limits,
+                                   size_t max_output_size,
+                                   size_t max_error_size) {
+    int in_pipe[2] { -1, -1 };
+    int out_pipe[2] { -1, -1 };
+    int err_pipe[2] { -1, -1 };
+    auto oom_kills_before = getCgroupOOMKills(limits.cgroup);
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid;
+
+    try {
+        createPipe(in_pipe, "input");
+        createPipe(out_pipe, "output");
+        createPipe(err_pipe, "error");
+        pid = spawner(in_pipe[0], out_pipe[1], err_pipe[1]);
+    } catch (const process_error&) {
+        closeFds({ in_pipe[0], in_pipe[1], out_pipe[0], out_pipe[1],
+                   err_pipe[0], err_pipe[1] });
+        throw;
+    }
+
+    closeFds({ in_pipe[0], out_pipe[1], err_pipe[1] });
+    LOG_DEBUG("Executing '%1%' with PID %2%", file, pid);
+
+    ExecutionResult result { EXIT_FAILURE, "", "", "", ResourceUsage {} };
+    communicate(in_pipe[1], out_pipe[0], err_pipe[0], input,
+                result.output, result.error, max_output_size, max_error_size);
+    result.exitcode = waitForProcess(pid, result.usage);
+    result.usage.wall_time_s = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    result.limit_exceeded = getExceededLimit(limits, result.exitcode,
+                                             oom_kills_before);
+
+    return result;
+}
+
+ExecutionResult execute(const std::string& file,
+                        const std::vector<std::string>& arguments,
+                        const std::string& input,
+                        const ProcessLimits& limits,
+                        size_t max_output_size,
+                        size_t max_error_size,
+                        const Environment* environment) {
+    std::vector<std::string> argv_strings { file };
+    argv_strings.insert(argv_strings.end(), arguments.begin(), arguments.end());
+    auto argv = getArgv(argv_strings);
+
+    return executeWith(
+        [&](int in_fd, int out_fd, int err_fd) {
+            return spawnChild(argv, in_fd, out_fd, err_fd, limits, environment);
+        },
+        file, input, limits, max_output_size, max_error_size);
+}
+
+ExecutionResult execute(Preloader& preloader,
+                        const std::string& action,
+                        const std::string& input,
+                        size_t max_output_size,
+                        size_t max_error_size) {
+    return executeWith(
+        [&](int in_fd, int out_fd, int err_fd) {
+            return preloader.spawn(action, in_fd, out_fd, err_fd);
+        },
+        action, input, preloader.limits(), max_output_size, max_error_size);
+}
+
+int waitForProcess(pid_t pid) {
+    ResourceUsage usage {};
+    return waitForProcess(pid, usage);
+}
+
+static double toSeconds(const struct timeval& time) {
+    return time.tv_sec + time.tv_usec / 1e6;
+}
+
+// Wait for the output pumps of the specified process, if any, so that
+// its output files are complete; in case the process outcome can't be
+// retrieved, the pumps are reaped asynchronously instead
+static void waitForPumps(pid_t pid, bool async) {
+    std::vector<pid_t> pump_pids {};
+
+    {
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock {
+            output_pumps_mutex };
+        auto pumps_itr = output_pumps.find(pid);
+
+        if (pumps_itr == output_pumps.end()) {
+            return;
+        }
+
+        pump_pids = std::move(pumps_itr->second);
+        output_pumps.erase(pumps_itr);
+    }
+
+    for (auto pump_pid : pump_pids) {
+        if (async) {
+            waitAsync(pump_pid);
+        } else {
+            while (waitpid(pump_pid, nullptr, 0) == -1 && errno == EINTR) {}
+        }
+    }
+}
+
+static int waitForChild(pid_t pid, ResourceUsage& usage);
+
+int waitForProcess(pid_t pid, ResourceUsage& usage) {
+    int exitcode;
+
+    try {
+        exitcode = waitForChild(pid, usage);
+    } catch (const process_error&) {
+        waitForPumps(pid, true);
+        throw;
+    }
+
+    waitForPumps(pid, false);
+    return exitcode;
+}
+
+static int waitForChild(pid_t pid, ResourceUsage& usage) {
+    RemoteChild remote_child { -1, false };
+
+    {
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock {
+            remote_children_mutex };
+        auto child_itr = remote_children.find(pid);
+
+        if (child_itr != remote_children.end()) {
+            remote_child = child_itr->second;
+            remote_children.erase(child_itr);
+        }
+    }
+
+    if (remote_child.preloaded) {
+        return waitForPreloadedChild(pid, remote_child.status_fd);
+    }
+
+    if (remote_child.status_fd != -1) {
+        return waitForServerChild(pid, remote_child.status_fd, usage);
+    }
+
+    int status;
+    struct rusage rusage {};
+
+    while (wait4(pid, &status, 0, &rusage) == -1) {
+        if (errno != EINTR) {
+            throw process_error { "failed to wait for process "
+                                  + std::to_string(pid) + "; errno="
+                                  + std::to_string(errno) };
+        }
+    }
+
+    usage.user_cpu_s = toSeconds(rusage.ru_utime);
+    usage.system_cpu_s = toSeconds(rusage.ru_stime);
+#ifdef __APPLE__
+    // Reported in bytes
+    usage.max_rss_kb = rusage.ru_maxrss / 1024;
+#else
+    usage.max_rss_kb = rusage.ru_maxrss;
+#endif
+    usage.read_blocks = rusage.ru_inblock;
+    usage.written_blocks = rusage.ru_oublock;
+
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+
+    return WEXITSTATUS(status);
+}
+
+unsigned long getCgroupOOMKills(const std::string& cgroup) {
+    std::string events_txt;
+
+    if (cgroup.empty() || !lth_file::read(cgroup + "/memory.events", events_txt)) {
+        return 0;
+    }
+
+    std::istringstream events { events_txt };
+    std::string key;
+    unsigned long value;
+
+    while (events >> key >> value) {
+        if (key == "oom_kill") {
+            return value;
+        }
+    }
+
+    return 0;
+}
+
+std::string getExceededLimit(const ProcessLimits& limits,
+                             int exitcode,
+                             unsigned long oom_kills_before) {
+    if (limits.cpu_seconds > 0 && exitcode == 128 + SIGXCPU) {
+        return CPU_TIME_LIMIT;
+    }
+
+    if (!limits.cgroup.empty() && exitcode == 128 + SIGKILL
+            && getCgroupOOMKills(limits.cgroup) > oom_kills_before) {
+        return MEMORY_LIMIT;
+    }
+
+    return "";
+}
+
+std::string getProcessStartTime(pid_t pid) {
+    std::string stat_txt;
+
+    if (!lth_file::read("/proc/" + std::to_string(pid) + "/stat", stat_txt)) {
+        return "";
+    }
+
+    // The command name is enclosed by parentheses and may contain
+    // spaces; the other fields are separated by spaces
+    auto name_end = stat_txt.rfind(')');
+    if (name_end == std::string::npos || name_end + 2 >= stat_txt.size()) {
+        return "";
+    }
+
+    std::vector<std::string> fields;
+    auto fields_txt = stat_txt.substr(name_end + 2);
+    boost::split(fields, fields_txt, boost::is_any_of(" "),
+                 boost::token_compress_on);
+
+    if (fields.size() <= PROC_STAT_STARTTIME_IDX) {
+        return "";
+    }
+
+    return fields[PROC_STAT_STARTTIME_IDX];
+}
+
+bool isProcessExecuting(pid_t pid, const std::string& start_time) {
+    if (pid <= 0 || !PIDFile::isProcessExecuting(pid)) {
+        return false;
+    }
+
+    if (start_time.empty()) {
+        // Cannot detect recycled PIDs
+        return true;
+    }
+
+    return getProcessStartTime(pid) == start_time;
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,99 @@
+#include <pxp-agent/util/rate_limiter.hpp>
+
+#include <algorithm>
+
+namespace PXPAgent {
+namespace Util {
+
+// Maximum number of key buckets; beyond it, the least recently used
+// one is evicted
+static const size_t MAX_KEY_BUCKETS { 4096 };
+
+RateLimiter::RateLimiter(double global_rate, double key_rate, double burst)
+        : global_rate_ { std::max(global_rate, 0.0) },
+          key_rate_ { std::max(key_rate, 0.0) },
+          burst_ { std::max(burst, 1.0) },
+          global_bucket_ { burst_, Clock::now() },
+          key_buckets_ {},
+          key_index_ {},
+          mutex_ {} {
+}
+
+double RateLimiter::acquire(const std::string& key, Clock::time_point now) {
+    return acquire(key, 1, now);
+}
+
+double RateLimiter::acquire(const std::string& key,
+                            unsigned int tokens,
+                            Clock::time_point now) {
+    if (!enabled()) {
+        return 0;
+    }
+
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mutex_ };
+    Bucket* key_bucket { nullptr };
+    double wait_s { 0 };
+
+    if (global_rate_ > 0) {
+        refill(global_bucket_, global_rate_, now);
+        wait_s = waitTime(global_bucket_, global_rate_, tokens);
+    }
+
+    if (key_rate_ > 0) {
+        key_bucket = &getKeyBucket(key, now);
+        refill(*key_bucket, key_rate_, now);
+        wait_s = std::max(wait_s, waitTime(*key_bucket, key_rate_, tokens));
+    }
+
+    if (wait_s > 0) {
+        return wait_s;
+    }
+
+    if (global_rate_ > 0) {
+        global_bucket_.tokens -= tokens;
+    }
+
+    if (key_bucket != nullptr) {
+        key_bucket->tokens -= tokens;
+    }
+
+    return 0;
+}
+
+void RateLimiter::refill(Bucket& bucket, double rate, Clock::time_point now) const {
+    if (now > bucket.last_refill) {
+        auto elapsed_s = std::chrono::duration<double>(now - bucket.last_refill).count();
+        bucket.tokens = std::min(burst_, bucket.tokens + elapsed_s * rate);
+        bucket.last_refill = now;
+    }
+}
+
+double RateLimiter::waitTime(const Bucket& bucket,
+                             double rate,
+                             unsigned int tokens) const {
+    return bucket.tokens >= tokens ? 0 : (tokens - bucket.tokens) / rate;
+}
+
+RateLimiter::Bucket& RateLimiter::getKeyBucket(const std::string& key,
+                                               Clock::time_point now) {
+    auto index_itr = key_index_.find(key);
+
+    if (index_itr != key_index_.end()) {
+        key_buckets_.splice(key_buckets_.begin(), key_buckets_, index_itr->second);
+        return index_itr->second->second;
+    }
+
+    // NB: the least recently used bucket is most likely full; if not,
+    // its key gets a new burst, but the global limit still applies
+    if (key_buckets_.size() >= MAX_KEY_BUCKETS) {
+        key_index_.erase(key_buckets_.back().first);
+        key_buckets_.pop_back();
+    }
+
+    key_buckets_.emplace_front(key, Bucket { burst_, now });
+    key_index_[key] = key_buckets_.begin();
+    return key_buckets_.front().second;
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,86 @@
+// Plugin module used by the plugin module tests; its 'string' action
+// reverses the 'argument' parameter. It has no dependency, so the
+// input is parsed naively. Built with REVERSE_PLUGIN_V2 defined, it
+// also provides the 'echo' action, to test reloading.
+
+#include <pxp-agent/plugin_abi.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static const char* METADATA =
+    "{\"description\" : \"reverse plugin\","
+    " \"actions\" : ["
+    "   {\"name\" : \"string\","
+    "    \"description\" : \"reverses a string\","
+    "    \"input\" : {\"type\" : \"object\","
+    "                 \"properties\" : {\"argument\" : {\"type\" : \"string\"}},"
+    "                 \"required\" : [\"argument\"]},"
+    "    \"output\" : {\"type\" : \"object\","
+    "                  \"properties\" : {\"output\" : {\"type\" : \"string\"}},"
+    "                  \"required\" : [\"output\"]}},"
+    "   {\"name\" : \"fail\","
+    "    \"description\" : \"fails\","
+    "    \"input\" : {\"type\" : \"object\"},"
+    "    \"output\" : {\"type\" : \"object\"}}"
+#ifdef REVERSE_PLUGIN_V2
+    "  ,{\"name\" : \"echo\","
+    "    \"description\" : \"returns its input\","
+    "    \"input\" : {\"type\" : \"object\"},"
+    "    \"output\" : {\"type\" : \"object\"}}"
+#endif
+    " ]}";
+
+static char* copyBuffer(const std::string& txt) {
+    auto buffer = static_cast<char*>(std::malloc(txt.size() + 1));
+    std::memcpy(buffer, txt.c_str(), txt.size() + 1);
+    return buffer;
+}
+
+extern "C" {
+
+int pxp_plugin_abi_version(void) {
+    return PXP_PLUGIN_ABI_VERSION;
+}
+
+const char* pxp_plugin_metadata(void) {
+    return METADATA;
+}
+
+int pxp_plugin_call_action(const char* action, const char* input,
+                           char** output, char** error) {
+    std::string action_name { action };
+
+    if (action_name == "fail") {
+        *error = copyBuffer("spam");
+        return 1;
+    }
+
+    std::string input_txt { input };
+
+    if (action_name == "echo") {
+        *output = copyBuffer(input_txt);
+        return 0;
+    }
+    std::string key { "\"argument\":\"" };
+    auto start = input_txt.find(key);
+
+    if (start == std::string::npos) {
+        *error = copyBuffer("no argument");
+        return 1;
+    }
+
+    start += key.size();
+    auto argument = input_txt.substr(start, input_txt.find('"', start) - start);
+    std::reverse(argument.begin(), argument.end());
+    *output = copyBuffer("{\"output\":\"" + argument + "\"}");
+    return 0;
+}
+
+void pxp_plugin_free(char* buffer) {
+    std::free(buffer);
+}
+
+}  // extern "C"
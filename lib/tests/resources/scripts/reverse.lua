@@ -0,0 +1,58 @@
+-- Lua module used by the Lua module tests
+
+metadata = {
+  description = "reverse script",
+  actions = {
+    { name = "string",
+      description = "reverses a string",
+      input = {
+        type = "object",
+        properties = { argument = { type = "string" } },
+        required = { "argument" },
+      },
+      output = {
+        type = "object",
+        properties = { output = { type = "string" } },
+        required = { "output" },
+      },
+    },
+    { name = "loop",
+      description = "never terminates",
+      input = { type = "object" },
+      output = { type = "object" },
+    },
+    { name = "allocate",
+      description = "allocates memory indefinitely",
+      input = { type = "object" },
+      output = { type = "object" },
+    },
+    { name = "escape",
+      description = "tries to execute a command",
+      input = { type = "object" },
+      output = { type = "object" },
+    },
+  },
+}
+
+actions = {}
+
+function actions.string(params, config)
+  return { output = params.argument:reverse() }
+end
+
+function actions.loop(params, config)
+  while true do
+    pcall(function() end)
+  end
+end
+
+function actions.allocate(params, config)
+  local chunks = {}
+  while true do
+    chunks[#chunks + 1] = string.rep("x", 1024 * 1024)
+  end
+end
+
+function actions.escape(params, config)
+  return { output = os.execute("true") }
+end
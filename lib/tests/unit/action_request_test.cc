@@ -38,8 +38,29 @@ TEST_CASE("ActionRequest::ActionRequest", "[request]") {
                           ActionRequest::Error);
     }
 
-    SECTION("throw a ActionRequest::Error if binary data") {
-        const PCPClient::ParsedChunks p_c { envelope, "bin data", debug, 0 };
+    SECTION("successfully instantiates with binary data") {
+        std::string payload { "bin\0data\n", 9 };
+        const PCPClient::ParsedChunks p_c { envelope, DATA_TXT + "\n" + payload,
+                                            debug, 0 };
+        ActionRequest request { RequestType::Blocking, p_c };
+
+        REQUIRE(request.module() == "module name");
+        REQUIRE(request.action() == "action name");
+        REQUIRE(request.binaryData() == payload);
+    }
+
+    SECTION("throw a ActionRequest::Error if binary data has no header") {
+        const PCPClient::ParsedChunks p_c { envelope, std::string { "bin data" },
+                                            debug, 0 };
+
+        REQUIRE_THROWS_AS(ActionRequest(RequestType::Blocking, p_c),
+                          ActionRequest::Error);
+    }
+
+    SECTION("throw a ActionRequest::Error if binary data has an invalid header") {
+        const PCPClient::ParsedChunks p_c { envelope,
+                                            std::string { "{\"module\" : 1}\nbin" },
+                                            debug, 0 };
 
         REQUIRE_THROWS_AS(ActionRequest(RequestType::Blocking, p_c),
                           ActionRequest::Error);
@@ -115,4 +136,51 @@ TEST_CASE("ActionRequest getters", "[request]") {
     }
 }
 
+static std::string batch_data_txt {
+    " { \"transaction_id\" : \"42\","
+    "   \"actions\" : [ { \"module\" : \"echo\","
+    "                   \"action\" : \"echo\","
+    "                   \"params\" : { \"argument\" : \"maradona\" } },"
+    "                 { \"module\" : \"ping\","
+    "                   \"action\" : \"ping\" } ]"
+    " }" };
+
+TEST_CASE("ActionRequest::batchEntries", "[request]") {
+    lth_jc::JsonContainer envelope { ENVELOPE_TXT };
+    std::vector<lth_jc::JsonContainer> debug {};
+
+    SECTION("returns no entries for non-batch requests") {
+        lth_jc::JsonContainer data { pxp_data_txt };
+        const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+        ActionRequest a_r { RequestType::Blocking, p_c };
+
+        REQUIRE(a_r.batchEntries().empty());
+    }
+
+    SECTION("throw a ActionRequest::Error if the batch has no actions") {
+        lth_jc::JsonContainer data { "{ \"transaction_id\" : \"42\" }" };
+        const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+
+        REQUIRE_THROWS_AS(ActionRequest(RequestType::Batch, p_c),
+                          ActionRequest::Error);
+    }
+
+    SECTION("returns a blocking request for each action of the batch") {
+        lth_jc::JsonContainer data { batch_data_txt };
+        const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+        ActionRequest a_r { RequestType::Batch, p_c };
+        auto entries = a_r.batchEntries();
+
+        REQUIRE(entries.size() == 2u);
+        REQUIRE(entries[0].type() == RequestType::Blocking);
+        REQUIRE(entries[0].id() == a_r.id());
+        REQUIRE(entries[0].transactionId() == "42");
+        REQUIRE(entries[0].module() == "echo");
+        REQUIRE(entries[0].action() == "echo");
+        REQUIRE(entries[0].params().get<std::string>("argument") == "maradona");
+        REQUIRE(entries[1].module() == "ping");
+        REQUIRE(entries[1].params().empty());
+    }
+}
+
 }  // namespace PXPAgent
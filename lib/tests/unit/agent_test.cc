@@ -26,7 +26,9 @@ TEST_CASE("Agent::Agent", "[agent]") {
                                                getKeyPath(),
                                                SPOOL,
                                                "",  // modules config dir
-                                               "test_agent" };
+                                               "test_agent",
+                                               0,  // response chunk size
+                                               0 };  // spool compression threshold
 
     SECTION("does not throw if it fails to find the external modules directory") {
         agent_configuration.modules_dir = MODULES + "/fake_dir";
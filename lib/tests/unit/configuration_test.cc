@@ -230,6 +230,24 @@ TEST_CASE("Configuration::validateAndNormalizeConfiguration", "[configuration]")
                           Configuration::Error);
     }
 
+    SECTION("it fails when a size is negative") {
+        Configuration::Instance().set<int>("max-request-size", -1);
+        REQUIRE_THROWS_AS(Configuration::Instance().validateAndNormalizeConfiguration(),
+                          Configuration::Error);
+    }
+
+    SECTION("it fails when file-transfer-dir is a relative path") {
+        Configuration::Instance().set<std::string>("file-transfer-dir", "transfers");
+        REQUIRE_THROWS_AS(Configuration::Instance().validateAndNormalizeConfiguration(),
+                          Configuration::Error);
+    }
+
+    SECTION("it fails when spool-format is invalid") {
+        Configuration::Instance().set<std::string>("spool-format", "database");
+        REQUIRE_THROWS_AS(Configuration::Instance().validateAndNormalizeConfiguration(),
+                          Configuration::Error);
+    }
+
     SECTION("it fails when foreground is unflagged and log is set to console") {
         Configuration::Instance().set<bool>("foreground", false);
         Configuration::Instance().set<bool>("console-logger", true);
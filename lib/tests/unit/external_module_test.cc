@@ -61,6 +61,28 @@ TEST_CASE("ExternalModule::ExternalModule", "[modules]") {
                            EXTENSION),
             Module::LoadingError);
     }
+
+#ifndef _WIN32
+    SECTION("throw a Module::LoadingError in case of invalid environment") {
+        lth_jc::JsonContainer config { "{ \"environment\" : { \"SPAM\" : 1 } }" };
+
+        REQUIRE_THROWS_AS(
+            ExternalModule(PXP_AGENT_ROOT_PATH
+                           "/lib/tests/resources/modules/reverse_valid"
+                           EXTENSION, config),
+            Module::LoadingError);
+    }
+#endif
+
+    SECTION("throw a Module::LoadingError in case of invalid limits") {
+        lth_jc::JsonContainer config { "{ \"limits\" : { \"max_stdout_kb\" : -1 } }" };
+
+        REQUIRE_THROWS_AS(
+            ExternalModule(PXP_AGENT_ROOT_PATH
+                           "/lib/tests/resources/modules/reverse_valid"
+                           EXTENSION, config),
+            Module::LoadingError);
+    }
 }
 
 TEST_CASE("ExternalModule::hasAction", "[modules]") {
@@ -132,4 +154,63 @@ TEST_CASE("ExternalModule::callAction - blocking", "[modules]") {
     }
 }
 
+#ifndef _WIN32
+TEST_CASE("ExternalModule::callAction - preload", "[modules]") {
+    lth_jc::JsonContainer config { "{ \"preload\" : true }" };
+    ExternalModule reverse_module { PXP_AGENT_ROOT_PATH
+                                    "/lib/tests/resources/modules/reverse_valid",
+                                    config };
+
+    SECTION("execute the actions through the preloader") {
+        ActionRequest request { RequestType::Blocking, CONTENT };
+        auto outcome = reverse_module.executeAction(request);
+
+        REQUIRE(outcome.std_out.find("anodaram") != std::string::npos);
+    }
+
+    SECTION("throw a Module::LoadingError in case of invalid preload entry") {
+        lth_jc::JsonContainer invalid_config { "{ \"preload\" : \"yes\" }" };
+
+        REQUIRE_THROWS_AS(
+            ExternalModule(PXP_AGENT_ROOT_PATH
+                           "/lib/tests/resources/modules/reverse_valid",
+                           invalid_config),
+            Module::LoadingError);
+    }
+}
+#endif
+
+TEST_CASE("ExternalModule::callAction - output limits", "[modules]") {
+    lth_jc::JsonContainer config { "{ \"limits\" : { \"max_stdout_kb\" : 1 } }" };
+    ExternalModule reverse_module { PXP_AGENT_ROOT_PATH
+                                    "/lib/tests/resources/modules/reverse_valid"
+                                    EXTENSION, config };
+
+    auto getRequestContent = [](const std::string& argument) {
+        std::string data_txt { (DATA_FORMAT % "\"5678\""
+                                            % "\"reverse_valid\""
+                                            % "\"string\""
+                                            % ("{\"argument\" : \"" + argument
+                                               + "\"}")).str() };
+        return PCPClient::ParsedChunks { lth_jc::JsonContainer(ENVELOPE_TXT),
+                                         lth_jc::JsonContainer(data_txt),
+                                         NO_DEBUG,
+                                         0 };
+    };
+
+    SECTION("successfully execute an action whose output is within the limit") {
+        ActionRequest request { RequestType::Blocking, getRequestContent("was") };
+
+        REQUIRE_NOTHROW(reverse_module.executeAction(request));
+    }
+
+    SECTION("throw a Module::ProcessingError if the output is oversized") {
+        ActionRequest request { RequestType::Blocking,
+                                getRequestContent(std::string(2048, 'a')) };
+
+        REQUIRE_THROWS_AS(reverse_module.executeAction(request),
+                          Module::ProcessingError);
+    }
+}
+
 }  // namespace PXPAgent
@@ -0,0 +1,243 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/job_journal.hpp>
+#include <pxp-agent/results_storage.hpp>
+
+#include <leatherman/file_util/file.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <catch.hpp>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_file = leatherman::file_util;
+
+static const std::string SPOOL_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                     + "/lib/tests/resources/test_spool/tmp_journal" };
+
+static std::string journalPath(const std::string& file_name) {
+    return SPOOL_DIR + "/" + JobJournal::DIRECTORY_NAME + "/" + file_name;
+}
+
+static const JobJournal::Record RECORD {
+    "{\"status\" : \"completed\", \"exitcode\" : 0}\n",
+    "{\"outcome\" : \"spam\"}\n",
+    "eggs\n" };
+
+static bool sameRecord(const JobJournal::Record& a, const JobJournal::Record& b) {
+    return a.status == b.status && a.out == b.out && a.err == b.err;
+}
+
+TEST_CASE("JobJournal::append, read", "[results]") {
+    fs::create_directories(SPOOL_DIR);
+
+    SECTION("stores and retrieves the record of a job") {
+        JobJournal journal { SPOOL_DIR };
+        journal.append("1234", RECORD);
+        JobJournal::Record record {};
+
+        REQUIRE(journal.read("1234", record));
+        REQUIRE(sameRecord(record, RECORD));
+    }
+
+    SECTION("returns false if the job is not stored") {
+        JobJournal journal { SPOOL_DIR };
+        JobJournal::Record record {};
+
+        REQUIRE_FALSE(journal.read("1234", record));
+    }
+
+    SECTION("retrieves the newest record of a job") {
+        JobJournal journal { SPOOL_DIR, true };
+        journal.append("1234", JobJournal::Record { "{}", "", "" });
+        journal.append("1234", RECORD);
+        JobJournal::Record record {};
+
+        REQUIRE(journal.read("1234", record));
+        REQUIRE(sameRecord(record, RECORD));
+    }
+
+    SECTION("starts a new segment once the maximum size is exceeded") {
+        JobJournal journal { SPOOL_DIR, false, 100 };
+
+        for (auto i = 0; i < 4; i++) {
+            journal.append(std::to_string(i), RECORD);
+        }
+
+        REQUIRE(fs::exists(journalPath("4.log")));
+
+        for (auto i = 0; i < 4; i++) {
+            JobJournal::Record record {};
+            REQUIRE(journal.read(std::to_string(i), record));
+            REQUIRE(sameRecord(record, RECORD));
+        }
+    }
+
+    SECTION("stores the records of concurrent appends") {
+        {
+            JobJournal journal { SPOOL_DIR, true, 1000 };
+            std::vector<PCPClient::Util::thread> threads {};
+
+            for (auto t = 0; t < 4; t++) {
+                threads.push_back(PCPClient::Util::thread { [&journal, t]() {
+                    for (auto i = 0; i < 20; i++) {
+                        journal.append(std::to_string(t * 100 + i), RECORD);
+                    }
+                } });
+            }
+
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+
+        JobJournal journal { SPOOL_DIR };
+
+        for (auto t = 0; t < 4; t++) {
+            for (auto i = 0; i < 20; i++) {
+                JobJournal::Record record {};
+                REQUIRE(journal.read(std::to_string(t * 100 + i), record));
+                REQUIRE(sameRecord(record, RECORD));
+            }
+        }
+    }
+
+    SECTION("stores the output files of a job") {
+        lth_file::atomic_write_to_file(RECORD.out, SPOOL_DIR + "/stdout");
+        JobJournal journal { SPOOL_DIR };
+        journal.appendFiles("1234", RECORD.status, SPOOL_DIR + "/stdout",
+                            SPOOL_DIR + "/stderr");
+        JobJournal::Record record {};
+
+        REQUIRE(journal.read("1234", record));
+        REQUIRE(record.status == RECORD.status);
+        REQUIRE(record.out == RECORD.out);
+        REQUIRE(record.err.empty());
+    }
+
+    SECTION("retrieves a range of the stdout of a job") {
+        JobJournal journal { SPOOL_DIR };
+        journal.append("1234", RECORD);
+        JobJournal::Record record {};
+        uint64_t out_size { 0 };
+
+        REQUIRE(journal.readRange("1234", 2, 7, record, out_size));
+        REQUIRE(record.status == RECORD.status);
+        REQUIRE(record.out == RECORD.out.substr(2, 7));
+        REQUIRE(record.err == RECORD.err);
+        REQUIRE(out_size == RECORD.out.size());
+
+        REQUIRE(journal.readRange("1234", 2, -1, record, out_size));
+        REQUIRE(record.out == RECORD.out.substr(2));
+
+        REQUIRE(journal.readRange("1234", 100, 7, record, out_size));
+        REQUIRE(record.out.empty());
+    }
+
+    SECTION("throws a JobJournal::Error in case of invalid transaction id") {
+        JobJournal journal { SPOOL_DIR };
+
+        REQUIRE_THROWS_AS(journal.append("12\n34", RECORD), JobJournal::Error);
+    }
+
+    fs::remove_all(SPOOL_DIR);
+}
+
+TEST_CASE("JobJournal::JobJournal", "[results]") {
+    fs::create_directories(SPOOL_DIR);
+
+    SECTION("loads the records stored by a previous instance") {
+        {
+            JobJournal journal { SPOOL_DIR };
+            journal.append("1234", RECORD);
+        }
+        JobJournal journal { SPOOL_DIR };
+        JobJournal::Record record {};
+
+        REQUIRE(journal.read("1234", record));
+        REQUIRE(sameRecord(record, RECORD));
+    }
+
+    SECTION("indexes the records missing from the index") {
+        {
+            JobJournal journal { SPOOL_DIR };
+            journal.append("1234", RECORD);
+        }
+        fs::remove(journalPath("index"));
+        JobJournal journal { SPOOL_DIR };
+        JobJournal::Record record {};
+
+        REQUIRE(journal.read("1234", record));
+    }
+
+    SECTION("discards an incomplete record at the end of the last segment") {
+        {
+            JobJournal journal { SPOOL_DIR };
+            journal.append("1234", RECORD);
+            std::ofstream segment { journalPath("1.log"),
+                                    std::ios::binary | std::ios::app };
+            segment << "42 0 0 123 5678\n{\"stat";
+        }
+        JobJournal journal { SPOOL_DIR };
+        journal.append("5678", RECORD);
+        JobJournal::Record record {};
+
+        REQUIRE(journal.read("1234", record));
+        REQUIRE(journal.read("5678", record));
+        REQUIRE(sameRecord(record, RECORD));
+    }
+
+#ifndef _WIN32
+    SECTION("throws a JobJournal::Error if the journal is already in use") {
+        JobJournal journal { SPOOL_DIR };
+
+        REQUIRE_THROWS_AS(JobJournal { SPOOL_DIR }, JobJournal::Error);
+    }
+#endif
+
+    fs::remove_all(SPOOL_DIR);
+}
+
+TEST_CASE("JobJournal::migrate", "[results]") {
+    auto writeJob = [](const std::string& transaction_id, const std::string& status) {
+        auto results_dir = SPOOL_DIR + "/" + transaction_id;
+        fs::create_directories(results_dir);
+        lth_file::atomic_write_to_file("{\"status\" : \"" + status + "\", "
+                                       "\"exitcode\" : 0}\n",
+                                       results_dir + "/" + ResultsStorage::STATUS_FILE);
+        lth_file::atomic_write_to_file("spam\n",
+                                       results_dir + "/" + ResultsStorage::STDOUT_FILE);
+    };
+    writeJob("1234", ResultsStorage::COMPLETED);
+    writeJob("5678", ResultsStorage::RUNNING);
+    JobJournal journal { SPOOL_DIR };
+
+    SECTION("moves the completed jobs to the journal") {
+        REQUIRE(journal.migrate() == 1);
+
+        JobJournal::Record record {};
+        REQUIRE(journal.read("1234", record));
+        REQUIRE(record.out == "spam\n");
+        REQUIRE_FALSE(fs::exists(SPOOL_DIR + "/1234"));
+    }
+
+    SECTION("leaves the running jobs in place") {
+        journal.migrate();
+
+        JobJournal::Record record {};
+        REQUIRE_FALSE(journal.read("5678", record));
+        REQUIRE(fs::exists(SPOOL_DIR + "/5678"));
+    }
+
+    fs::remove_all(SPOOL_DIR);
+}
+
+}  // namespace PXPAgent
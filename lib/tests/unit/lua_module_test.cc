@@ -0,0 +1,99 @@
+#include "root_path.hpp"
+#include "content_format.hpp"
+
+#include <pxp-agent/lua_module.hpp>
+
+#include <cpp-pcp-client/protocol/chunks.hpp>       // ParsedChunks
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace lth_jc = leatherman::json_container;
+
+static const std::string SCRIPT_PATH { std::string { PXP_AGENT_ROOT_PATH }
+                                       + "/lib/tests/resources/scripts/reverse.lua" };
+
+static const std::vector<lth_jc::JsonContainer> NO_DEBUG {};
+
+static PCPClient::ParsedChunks getRequestContent(const std::string& action,
+                                                 const std::string& params) {
+    std::string data_txt { (DATA_FORMAT % "\"8765\""
+                                        % "\"reverse\""
+                                        % ("\"" + action + "\"")
+                                        % params).str() };
+    return PCPClient::ParsedChunks { lth_jc::JsonContainer(ENVELOPE_TXT),
+                                     lth_jc::JsonContainer(data_txt),
+                                     NO_DEBUG,
+                                     0 };
+}
+
+TEST_CASE("LuaModule::LuaModule", "[modules]") {
+    SECTION("loads the script metadata") {
+        LuaModule mod { SCRIPT_PATH };
+
+        REQUIRE(mod.module_name == "reverse");
+        REQUIRE(mod.actions.size() == 4);
+    }
+
+    SECTION("throws a Module::LoadingError if the script is invalid") {
+        REQUIRE_THROWS_AS(LuaModule(PXP_AGENT_ROOT_PATH
+                                    "/lib/tests/resources/modules/reverse_valid"),
+                          Module::LoadingError);
+    }
+
+    SECTION("throws a Module::LoadingError in case of invalid limits") {
+        lth_jc::JsonContainer config { "{ \"limits\" : { \"memory_mb\" : 0 } }" };
+
+        REQUIRE_THROWS_AS(LuaModule(SCRIPT_PATH, config), Module::LoadingError);
+    }
+
+    SECTION("throws a Module::LoadingError in case of too large memory limit") {
+        lth_jc::JsonContainer config { "{ \"limits\" : { \"memory_mb\" : 4097 } }" };
+
+        REQUIRE_THROWS_AS(LuaModule(SCRIPT_PATH, config), Module::LoadingError);
+    }
+}
+
+TEST_CASE("LuaModule::callAction", "[modules]") {
+    lth_jc::JsonContainer config {
+        "{ \"limits\" : { \"cpu_seconds\" : 1, \"memory_mb\" : 16 } }" };
+    LuaModule mod { SCRIPT_PATH, config };
+
+    SECTION("executes the action") {
+        ActionRequest request { RequestType::Blocking,
+                                getRequestContent("string",
+                                                  "{\"argument\" : \"maradona\"}") };
+        auto outcome = mod.executeAction(request);
+
+        REQUIRE(outcome.results.get<std::string>("output") == "anodaram");
+    }
+
+    SECTION("does not provide access to the system") {
+        ActionRequest request { RequestType::Blocking,
+                                getRequestContent("escape", "{}") };
+
+        REQUIRE_THROWS_AS(mod.executeAction(request), Module::ProcessingError);
+    }
+
+    SECTION("enforces the CPU time limit") {
+        ActionRequest request { RequestType::Blocking,
+                                getRequestContent("loop", "{}") };
+
+        REQUIRE_THROWS_AS(mod.executeAction(request), Module::ResourceLimitError);
+    }
+
+    SECTION("enforces the memory limit") {
+        ActionRequest request { RequestType::Blocking,
+                                getRequestContent("allocate", "{}") };
+
+        REQUIRE_THROWS_AS(mod.executeAction(request), Module::ResourceLimitError);
+    }
+}
+
+}  // namespace PXPAgent
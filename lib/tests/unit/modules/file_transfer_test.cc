@@ -0,0 +1,151 @@
+#include "root_path.hpp"
+#include "../content_format.hpp"
+
+#include <pxp-agent/modules/file_transfer.hpp>
+#include <pxp-agent/util/checksum.hpp>
+
+#include <cpp-pcp-client/protocol/chunks.hpp>       // ParsedChunks
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/file_util/file.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <catch.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_jc = leatherman::json_container;
+namespace lth_file = leatherman::file_util;
+
+static const std::string TRANSFER_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                        + "/lib/tests/resources/test_spool/transfer" };
+static const std::string DESTINATION { TRANSFER_DIR + "/file.txt" };
+
+static const std::vector<lth_jc::JsonContainer> NO_DEBUG {};
+
+static ActionOutcome executeTransferAction(Modules::FileTransfer& module,
+                                           const std::string& action,
+                                           const lth_jc::JsonContainer& params) {
+    lth_jc::JsonContainer data {};
+    data.set<std::string>("transaction_id", "42");
+    data.set<std::string>("module", "file_transfer");
+    data.set<std::string>("action", action);
+    data.set<lth_jc::JsonContainer>("params", params);
+    PCPClient::ParsedChunks parsed_chunks { lth_jc::JsonContainer(ENVELOPE_TXT),
+                                            data,
+                                            NO_DEBUG,
+                                            0 };
+    ActionRequest request { RequestType::Blocking, parsed_chunks };
+    return module.executeAction(request);
+}
+
+static ActionOutcome writeChunk(Modules::FileTransfer& module,
+                                int64_t offset,
+                                const std::string& chunk,
+                                const std::string& destination = DESTINATION) {
+    lth_jc::JsonContainer params {};
+    params.set<std::string>("destination", destination);
+    params.set<int64_t>("offset", offset);
+    params.set<std::string>("data", chunk);
+    return executeTransferAction(module, "write_chunk", params);
+}
+
+static ActionOutcome commit(Modules::FileTransfer& module,
+                            const std::string& sha256) {
+    lth_jc::JsonContainer params {};
+    params.set<std::string>("destination", DESTINATION);
+    params.set<std::string>("sha256", sha256);
+    return executeTransferAction(module, "commit", params);
+}
+
+TEST_CASE("Modules::FileTransfer::executeAction", "[modules]") {
+    Modules::FileTransfer transfer_module { TRANSFER_DIR };
+    fs::create_directories(TRANSFER_DIR);
+
+    SECTION("writes the chunks and commits the file") {
+        writeChunk(transfer_module, 0, "maradona ");
+        auto outcome = writeChunk(transfer_module, 9, "kondogbia");
+
+        REQUIRE(outcome.results.get<int64_t>("size") == 18);
+        REQUIRE_FALSE(fs::exists(DESTINATION));
+
+        commit(transfer_module, Util::getSha256("maradona kondogbia"));
+
+        REQUIRE(lth_file::read(DESTINATION) == "maradona kondogbia");
+        REQUIRE_FALSE(fs::exists(DESTINATION + Modules::FileTransfer::PARTIAL_SUFFIX));
+    }
+
+    SECTION("reports the size of the partial file, to resume the upload") {
+        writeChunk(transfer_module, 0, "maradona ");
+        lth_jc::JsonContainer params {};
+        params.set<std::string>("destination", DESTINATION);
+        auto outcome = executeTransferAction(transfer_module, "status", params);
+
+        REQUIRE(outcome.results.get<bool>("partial"));
+        REQUIRE(outcome.results.get<int64_t>("size") == 9);
+    }
+
+    SECTION("accepts re-sent chunks") {
+        writeChunk(transfer_module, 0, "maradona ");
+        writeChunk(transfer_module, 0, "maradona ");
+        writeChunk(transfer_module, 9, "kondogbia");
+
+        REQUIRE_NOTHROW(commit(transfer_module,
+                               Util::getSha256("maradona kondogbia")));
+    }
+
+    SECTION("throws a Module::ProcessingError in case of gaps") {
+        writeChunk(transfer_module, 0, "maradona ");
+
+        REQUIRE_THROWS_AS(writeChunk(transfer_module, 42, "kondogbia"),
+                          Module::ProcessingError);
+    }
+
+    SECTION("throws a Module::ProcessingError in case of checksum mismatch") {
+        writeChunk(transfer_module, 0, "maradona ");
+
+        REQUIRE_THROWS_AS(commit(transfer_module, Util::getSha256("spam")),
+                          Module::ProcessingError);
+        REQUIRE_FALSE(fs::exists(DESTINATION));
+    }
+
+    SECTION("throws a Module::ProcessingError if the destination is outside "
+            "of the root directory") {
+        REQUIRE_THROWS_AS(writeChunk(transfer_module, 0, "spam",
+                                     PXP_AGENT_ROOT_PATH "/file.txt"),
+                          Module::ProcessingError);
+        REQUIRE_THROWS_AS(writeChunk(transfer_module, 0, "spam",
+                                     TRANSFER_DIR + "/../file.txt"),
+                          Module::ProcessingError);
+        REQUIRE_THROWS_AS(writeChunk(transfer_module, 0, "spam", TRANSFER_DIR),
+                          Module::ProcessingError);
+    }
+
+#ifndef _WIN32
+    SECTION("throws a Module::ProcessingError if a parent of the destination "
+            "is a symbolic link") {
+        fs::create_symlink(PXP_AGENT_ROOT_PATH, TRANSFER_DIR + "/link");
+
+        REQUIRE_THROWS_AS(writeChunk(transfer_module, 0, "spam",
+                                     TRANSFER_DIR + "/link/file.txt"),
+                          Module::ProcessingError);
+    }
+#endif
+
+    SECTION("throws a Module::ProcessingError if no root directory is set") {
+        Modules::FileTransfer disabled_module { "" };
+
+        REQUIRE_THROWS_AS(writeChunk(disabled_module, 0, "spam"),
+                          Module::ProcessingError);
+    }
+
+    fs::remove_all(TRANSFER_DIR);
+}
+
+}  // namespace PXPAgent
@@ -3,6 +3,7 @@
 
 #include <pxp-agent/modules/status.hpp>
 #include <pxp-agent/configuration.hpp>              // DEFAULT_SPOOL_DIR
+#include <pxp-agent/job_journal.hpp>
 
 #include <cpp-pcp-client/protocol/chunks.hpp>       // ParsedChunks
 
@@ -33,6 +34,15 @@ boost::format STATUS_FORMAT {
     "}"
 };
 
+boost::format STATUS_RANGE_FORMAT {
+    "{  \"transaction_id\" : \"2345236346\","
+    "    \"module\" : \"status\","
+    "    \"action\" : \"query\","
+    "    \"params\" : {\"transaction_id\" : \"%1%\", "
+    "                  \"offset\" : %2%, \"length\" : %3%}"
+    "}"
+};
+
 static const std::vector<lth_jc::JsonContainer> NO_DEBUG {};
 
 TEST_CASE("Modules::Status::executeAction", "[modules]") {
@@ -139,6 +149,28 @@ TEST_CASE("Modules::Status::executeAction", "[modules]") {
                     outcome.results.get<std::string>("stdout"), out));
             }
 
+            SECTION("it returns the requested range of the action output") {
+                std::string range_txt {
+                    (STATUS_RANGE_FORMAT % symlink_name % 3 % 6).str() };
+                PCPClient::ParsedChunks range_chunks {
+                        lth_jc::JsonContainer(ENVELOPE_TXT),
+                        lth_jc::JsonContainer(range_txt),
+                        NO_DEBUG,
+                        0 };
+                ActionRequest range_request { RequestType::Blocking, range_chunks };
+                auto outcome = status_module.executeAction(range_request);
+                auto out = outcome.results.get<std::string>("stdout");
+                auto out_size = outcome.results.get<int>("stdout_size");
+
+                if (success) {
+                    REQUIRE(out == "OUTPUT");
+                    REQUIRE(out_size >= 10);
+                } else {
+                    REQUIRE(out.empty());
+                    REQUIRE(out_size == 0);
+                }
+            }
+
             SECTION("it returns the action error string") {
                 auto outcome = status_module.executeAction(request);
                 boost::regex err { (success ? "" : "\\*\\*\\*ERROR\\r?\\n") };
@@ -164,4 +196,48 @@ TEST_CASE("Modules::Status::executeAction", "[modules]") {
     }
 }
 
+TEST_CASE("Modules::Status::executeAction with the job journal", "[modules]") {
+    std::string spool_dir { std::string { PXP_AGENT_ROOT_PATH }
+                            + "/lib/tests/resources/test_spool/tmp_status_journal" };
+    boost::filesystem::create_directories(spool_dir);
+    auto journal = std::make_shared<JobJournal>(spool_dir);
+    journal->append("1234", JobJournal::Record {
+        "{\"status\" : \"completed\", \"exitcode\" : 0}\n", "***OUTPUT\n", "" });
+    Modules::Status status_module { journal };
+
+    auto query = [&](const std::string& request_txt) {
+        PCPClient::ParsedChunks chunks {
+                lth_jc::JsonContainer(ENVELOPE_TXT),
+                lth_jc::JsonContainer(request_txt),
+                NO_DEBUG,
+                0 };
+        ActionRequest request { RequestType::Blocking, chunks };
+        return status_module.executeAction(request).results;
+    };
+
+    SECTION("it retrieves the results of a job from the journal") {
+        auto results = query((STATUS_FORMAT % "1234").str());
+
+        REQUIRE(results.get<std::string>("status") == "success");
+        REQUIRE(results.get<int>("exitcode") == 0);
+        REQUIRE(results.get<std::string>("stdout") == "***OUTPUT\n");
+    }
+
+    SECTION("it returns the requested range of the action output") {
+        auto results = query((STATUS_RANGE_FORMAT % "1234" % 3 % 6).str());
+
+        REQUIRE(results.get<std::string>("stdout") == "OUTPUT");
+        REQUIRE(results.get<int>("stdout_size") == 10);
+    }
+
+    SECTION("it returns status 'unknown' if the job is not stored") {
+        auto results = query((STATUS_FORMAT % "5678").str());
+
+        REQUIRE(results.get<std::string>("status") == "unknown");
+    }
+
+    journal.reset();
+    boost::filesystem::remove_all(spool_dir);
+}
+
 }  // namespace PXPAgent
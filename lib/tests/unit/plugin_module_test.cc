@@ -0,0 +1,101 @@
+#include "root_path.hpp"
+#include "content_format.hpp"
+
+#include <pxp-agent/plugin_module.hpp>
+
+#include <cpp-pcp-client/protocol/chunks.hpp>       // ParsedChunks
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_jc = leatherman::json_container;
+
+static const std::string PLUGIN_PATH { std::string { PXP_AGENT_BINARY_ROOT_PATH }
+                                       + "/test-resources/plugins/reverse_plugin"
+                                       + PluginModule::PLUGIN_SUFFIX };
+
+static const std::string PLUGIN_V2_PATH { std::string { PXP_AGENT_BINARY_ROOT_PATH }
+                                          + "/test-resources/plugins/reverse_plugin_v2"
+                                          + PluginModule::PLUGIN_SUFFIX };
+
+static const std::string RELOAD_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                      + "/lib/tests/resources/test_spool/plugins" };
+
+static const std::vector<lth_jc::JsonContainer> NO_DEBUG {};
+
+static PCPClient::ParsedChunks getRequestContent(const std::string& action,
+                                                 const std::string& params) {
+    std::string data_txt { (DATA_FORMAT % "\"4321\""
+                                        % "\"reverse_plugin\""
+                                        % ("\"" + action + "\"")
+                                        % params).str() };
+    return PCPClient::ParsedChunks { lth_jc::JsonContainer(ENVELOPE_TXT),
+                                     lth_jc::JsonContainer(data_txt),
+                                     NO_DEBUG,
+                                     0 };
+}
+
+TEST_CASE("PluginModule::PluginModule", "[modules]") {
+    SECTION("loads the plugin metadata") {
+        PluginModule mod { PLUGIN_PATH };
+
+        REQUIRE(mod.module_name == "reverse_plugin");
+        REQUIRE(mod.actions.size() == 2);
+        REQUIRE(mod.hasAction("string"));
+    }
+
+    SECTION("loads the new version of a plugin that is in use") {
+        fs::create_directories(RELOAD_DIR);
+        auto path = RELOAD_DIR + "/reverse_plugin" + PluginModule::PLUGIN_SUFFIX;
+        fs::copy_file(PLUGIN_PATH, path, fs::copy_option::overwrite_if_exists);
+        PluginModule old_mod { path };
+
+        // NB: the new version replaces the old one by renaming
+        fs::copy_file(PLUGIN_V2_PATH, path + ".new",
+                      fs::copy_option::overwrite_if_exists);
+        fs::rename(path + ".new", path);
+        PluginModule new_mod { path };
+        fs::remove_all(RELOAD_DIR);
+
+        REQUIRE(old_mod.actions.size() == 2);
+        REQUIRE(new_mod.actions.size() == 3);
+        REQUIRE(new_mod.hasAction("echo"));
+    }
+
+    SECTION("throws a Module::LoadingError if the library can't be loaded") {
+        REQUIRE_THROWS_AS(PluginModule(PXP_AGENT_ROOT_PATH
+                                       "/lib/tests/resources/modules/reverse_valid"),
+                          Module::LoadingError);
+    }
+}
+
+TEST_CASE("PluginModule::callAction", "[modules]") {
+    PluginModule mod { PLUGIN_PATH };
+
+    SECTION("executes the action in-process") {
+        ActionRequest request { RequestType::Blocking,
+                                getRequestContent("string",
+                                                  "{\"argument\" : \"maradona\"}") };
+        auto outcome = mod.executeAction(request);
+
+        REQUIRE(outcome.results.get<std::string>("output") == "anodaram");
+    }
+
+    SECTION("throws a Module::ProcessingError if the action fails") {
+        ActionRequest request { RequestType::Blocking,
+                                getRequestContent("fail", "{}") };
+
+        REQUIRE_THROWS_AS(mod.executeAction(request), Module::ProcessingError);
+    }
+}
+
+}  // namespace PXPAgent
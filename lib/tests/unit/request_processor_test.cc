@@ -37,7 +37,9 @@ static const Configuration::Agent agent_configuration { MODULES,
                                                         KEY,
                                                         SPOOL,
                                                         "",  // modules config dir
-                                                        "test_agent" };
+                                                        "test_agent",
+                                                        0,  // response chunk size
+                                                        0 };  // spool compression threshold
 
 TEST_CASE("RequestProcessor::RequestProcessor", "[agent]") {
     auto c_ptr = std::make_shared<PXPConnector>(agent_configuration);
@@ -53,6 +55,14 @@ TEST_CASE("RequestProcessor::RequestProcessor", "[agent]") {
         REQUIRE_NOTHROW(RequestProcessor(c_ptr, a_c));
     };
 
+    SECTION("opens the job journal if the spool format is 'journal'") {
+        Configuration::Agent a_c  = agent_configuration;
+        a_c.spool_format = "journal";
+
+        REQUIRE_NOTHROW(RequestProcessor(c_ptr, a_c));
+        REQUIRE(boost::filesystem::exists(SPOOL + JobJournal::DIRECTORY_NAME));
+    };
+
     boost::filesystem::remove_all(SPOOL);
 }
 
@@ -83,6 +93,10 @@ class TestConnector : public PXPConnector {
         const char* what() const noexcept { return "PXP error"; } };
     struct blocking_response : public std::exception {
         const char* what() const noexcept { return "blocking response"; } };
+    struct batch_response : public std::exception {
+        const char* what() const noexcept { return "batch response"; } };
+    struct chunked_response : public std::exception {
+        const char* what() const noexcept { return "chunked response"; } };
 
     std::atomic<bool> sent_provisional_response;
     std::atomic<bool> sent_non_blocking_response;
@@ -104,11 +118,31 @@ class TestConnector : public PXPConnector {
         throw pxpError_msg {};
     }
 
+    void sendPXPError(const std::string&,
+                      const std::string&,
+                      const std::string&,
+                      const std::string&,
+                      int) {
+        throw pxpError_msg {};
+    }
+
     void sendBlockingResponse(const ActionRequest&,
                               const lth_jc::JsonContainer&) {
         throw blocking_response {};
     }
 
+    void sendBatchResponse(const ActionRequest&,
+                           const std::vector<lth_jc::JsonContainer>&) {
+        throw batch_response {};
+    }
+
+    void sendChunkedResponse(const ActionRequest&,
+                             const std::string&,
+                             size_t,
+                             const std::string&) {
+        throw chunked_response {};
+    }
+
     // Don't throw for non-blocking transactions - will spawn
     // another thread
 
@@ -133,7 +167,9 @@ TEST_CASE("RequestProcessor::processRequest", "[agent]") {
                                              getKeyPath(),
                                              SPOOL,
                                              "",  // modules config dir
-                                             "test_agent" };
+                                             "test_agent",
+                                             0,  // response chunk size
+                                             0 };  // spool compression threshold
 
     auto c_ptr = std::make_shared<TestConnector>();
     RequestProcessor r_p { c_ptr, MODULES, SPOOL };
@@ -183,6 +219,22 @@ TEST_CASE("RequestProcessor::processRequest", "[agent]") {
                               TestConnector::blocking_response);
         }
 
+        SECTION("send a chunked response when the results exceed the chunk size") {
+            auto chunking_configuration = agent_configuration;
+            chunking_configuration.response_chunk_size = 4;
+            RequestProcessor chunking_r_p { c_ptr, chunking_configuration };
+
+            data.set<std::string>("module", "reverse_valid");
+            data.set<std::string>("action", "string");
+            lth_jc::JsonContainer params {};
+            params.set<std::string>("argument", "maradona");
+            data.set<lth_jc::JsonContainer>("params", params);
+            const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+
+            REQUIRE_THROWS_AS(chunking_r_p.processRequest(RequestType::Blocking, p_c),
+                              TestConnector::chunked_response);
+        }
+
         SECTION("send a PXP error in case of action failure") {
             data.set<std::string>("module", "failures_test");
             data.set<std::string>("action", "broken_action");
@@ -196,6 +248,29 @@ TEST_CASE("RequestProcessor::processRequest", "[agent]") {
         }
     }
 
+    SECTION("correctly process batch requests") {
+        SECTION("send a single batch response, also in case of action failure") {
+            lth_jc::JsonContainer valid_action {};
+            valid_action.set<std::string>("module", "reverse_valid");
+            valid_action.set<std::string>("action", "string");
+            lth_jc::JsonContainer params {};
+            params.set<std::string>("argument", "maradona");
+            valid_action.set<lth_jc::JsonContainer>("params", params);
+
+            lth_jc::JsonContainer unknown_action {};
+            unknown_action.set<std::string>("module", "foo");
+            unknown_action.set<std::string>("action", "bar");
+
+            data.set<std::vector<lth_jc::JsonContainer>>(
+                "actions", { valid_action, unknown_action });
+            data.set<bool>("parallel", true);
+            const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+
+            REQUIRE_THROWS_AS(r_p.processRequest(RequestType::Batch, p_c),
+                              TestConnector::batch_response);
+        }
+    }
+
     SECTION("correctly process non-blocking requests") {
         SECTION("send a blocking response when the requested action succeds") {
             REQUIRE(!c_ptr->sent_provisional_response);
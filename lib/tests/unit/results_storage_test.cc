@@ -0,0 +1,263 @@
+#include "root_path.hpp"
+#include "content_format.hpp"
+
+#include <pxp-agent/results_storage.hpp>
+
+#include <cpp-pcp-client/protocol/chunks.hpp>       // ParsedChunks
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/file_util/file.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_jc = leatherman::json_container;
+namespace lth_file = leatherman::file_util;
+
+static const std::string RESULTS_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                       + "/lib/tests/resources/test_spool/1234" };
+
+static const std::vector<lth_jc::JsonContainer> NO_DEBUG {};
+
+static const PCPClient::ParsedChunks REQUEST_CONTENT {
+    lth_jc::JsonContainer(ENVELOPE_TXT),
+    lth_jc::JsonContainer((DATA_FORMAT % "\"1234\""
+                                       % "\"reverse\""
+                                       % "\"string\""
+                                       % "{\"argument\" : \"maradona\"}").str()),
+    NO_DEBUG,
+    0 };
+
+static std::string getStatusEntry(const std::string& key) {
+    lth_jc::JsonContainer status {
+        lth_file::read(RESULTS_DIR + "/" + ResultsStorage::STATUS_FILE) };
+    return status.get<std::string>(key);
+}
+
+TEST_CASE("ResultsStorage::ResultsStorage", "[results]") {
+    ActionRequest request { RequestType::NonBlocking, REQUEST_CONTENT };
+
+    SECTION("writes only the status file and flags the job as running") {
+        ResultsStorage storage { request, RESULTS_DIR };
+
+        REQUIRE_FALSE(fs::exists(RESULTS_DIR + "/" + ResultsStorage::STDOUT_FILE));
+        REQUIRE_FALSE(fs::exists(RESULTS_DIR + "/" + ResultsStorage::STDERR_FILE));
+        REQUIRE(getStatusEntry("status") == ResultsStorage::RUNNING);
+        REQUIRE(storage.isRunning());
+    }
+
+    SECTION("can load the status of an existing job") {
+        ResultsStorage storage { request, RESULTS_DIR };
+        ResultsStorage loaded_storage { RESULTS_DIR };
+
+        REQUIRE(loaded_storage.isRunning());
+    }
+
+    SECTION("throws a ResultsStorage::Error if the job does not exist") {
+        REQUIRE_THROWS_AS(ResultsStorage(RESULTS_DIR + "_foo"),
+                          ResultsStorage::Error);
+    }
+
+    fs::remove_all(RESULTS_DIR);
+}
+
+TEST_CASE("ResultsStorage::write", "[results]") {
+    ActionRequest request { RequestType::NonBlocking, REQUEST_CONTENT };
+    ResultsStorage storage { request, RESULTS_DIR };
+    lth_jc::JsonContainer results { "{\"outcome\" : \"ognuno\"}" };
+    ActionOutcome outcome { 0, results };
+
+    SECTION("completes the job") {
+        storage.write(outcome, "", "1 s");
+
+        REQUIRE(getStatusEntry("status") == ResultsStorage::COMPLETED);
+        REQUIRE(getStatusEntry("duration") == "1 s");
+    }
+
+    SECTION("records the resource usage of the job process") {
+        lth_jc::JsonContainer usage {};
+        usage.set<double>("user_cpu_s", 0.5);
+        usage.set<int>("max_rss_kb", 4242);
+        ResultsStorage::writeResourceUsage(RESULTS_DIR, usage);
+        storage.write(outcome, "", "1 s");
+
+        lth_jc::JsonContainer status {
+            lth_file::read(RESULTS_DIR + "/" + ResultsStorage::STATUS_FILE) };
+        REQUIRE(status.includes("resources"));
+        auto resources = status.get<lth_jc::JsonContainer>("resources");
+        REQUIRE(resources.get<int>("max_rss_kb") == 4242);
+    }
+
+    SECTION("stores the output of internal modules") {
+        storage.write(outcome, "", "1 s");
+
+        REQUIRE(ResultsStorage::readOutput(RESULTS_DIR, ResultsStorage::STDOUT_FILE)
+                == results.toString() + "\n");
+    }
+
+#ifndef _WIN32
+    SECTION("syncs the result files if requested") {
+        ResultsStorage::setSyncWrites(true);
+        storage.write(outcome, "spam", "1 s");
+        ResultsStorage::setSyncWrites(false);
+
+        REQUIRE(getStatusEntry("status") == ResultsStorage::COMPLETED);
+        REQUIRE(lth_file::read(RESULTS_DIR + "/" + ResultsStorage::STDERR_FILE)
+                == "spam");
+    }
+#endif
+
+    fs::remove_all(RESULTS_DIR);
+}
+
+TEST_CASE("ResultsStorage::compressOutput, readOutput", "[results]") {
+    ActionRequest request { RequestType::NonBlocking, REQUEST_CONTENT };
+    ResultsStorage storage { request, RESULTS_DIR };
+    std::string out_txt(4096, 'x');
+    lth_file::atomic_write_to_file(out_txt,
+                                   RESULTS_DIR + "/" + ResultsStorage::STDOUT_FILE);
+    lth_file::atomic_write_to_file("spam\n",
+                                   RESULTS_DIR + "/" + ResultsStorage::STDERR_FILE);
+
+    SECTION("compresses the output files larger than the threshold") {
+        storage.compressOutput(1024);
+
+        REQUIRE(ResultsStorage::isOutputCompressed(RESULTS_DIR,
+                                                   ResultsStorage::STDOUT_FILE));
+        REQUIRE_FALSE(fs::exists(RESULTS_DIR + "/" + ResultsStorage::STDOUT_FILE));
+        REQUIRE_FALSE(ResultsStorage::isOutputCompressed(RESULTS_DIR,
+                                                         ResultsStorage::STDERR_FILE));
+    }
+
+    SECTION("transparently reads the compressed output") {
+        storage.compressOutput(1024);
+
+        REQUIRE(ResultsStorage::readOutput(RESULTS_DIR, ResultsStorage::STDOUT_FILE)
+                == out_txt);
+        REQUIRE(ResultsStorage::readOutput(RESULTS_DIR, ResultsStorage::STDERR_FILE)
+                == "spam\n");
+    }
+
+    SECTION("reads a range of the compressed and uncompressed output") {
+        storage.compressOutput(1024);
+        uint64_t size { 0 };
+
+        REQUIRE(ResultsStorage::readOutputRange(RESULTS_DIR, ResultsStorage::STDOUT_FILE,
+                                                1000, 10, size)
+                == out_txt.substr(1000, 10));
+        REQUIRE(size == out_txt.size());
+        REQUIRE(ResultsStorage::readOutputRange(RESULTS_DIR, ResultsStorage::STDERR_FILE,
+                                                2, -1, size)
+                == "am\n");
+        REQUIRE(size == 5);
+    }
+
+    fs::remove_all(RESULTS_DIR);
+}
+
+TEST_CASE("ResultsStorage::writeRecovered, markFailed", "[results]") {
+    ActionRequest request { RequestType::NonBlocking, REQUEST_CONTENT };
+    ResultsStorage storage { request, RESULTS_DIR };
+
+    SECTION("can complete a job") {
+        storage.writeRecovered(0, "42 s");
+
+        REQUIRE(getStatusEntry("status") == ResultsStorage::COMPLETED);
+        REQUIRE(getStatusEntry("duration") == "42 s");
+        REQUIRE_FALSE(storage.isRunning());
+    }
+
+    SECTION("can flag a job as failed and store the reason") {
+        storage.markFailed("spam");
+
+        REQUIRE(getStatusEntry("status") == ResultsStorage::FAILED);
+        REQUIRE(lth_file::read(RESULTS_DIR + "/" + ResultsStorage::STDERR_FILE)
+                == "spam\n");
+    }
+
+    fs::remove_all(RESULTS_DIR);
+}
+
+TEST_CASE("ResultsStorage::writeProcessInfo, readProcessInfo", "[results]") {
+    fs::create_directories(RESULTS_DIR);
+
+    SECTION("can store and retrieve the process info") {
+        int pid;
+        std::string start_time;
+        ResultsStorage::writeProcessInfo(RESULTS_DIR, 4242, "123456");
+
+        REQUIRE(ResultsStorage::readProcessInfo(RESULTS_DIR, pid, start_time));
+        REQUIRE(pid == 4242);
+        REQUIRE(start_time == "123456");
+    }
+
+    SECTION("returns false if the process info was not stored") {
+        int pid;
+        std::string start_time;
+
+        REQUIRE_FALSE(ResultsStorage::readProcessInfo(RESULTS_DIR, pid, start_time));
+    }
+
+    fs::remove_all(RESULTS_DIR);
+}
+
+TEST_CASE("ResultsStorage::readExitcode", "[results]") {
+    fs::create_directories(RESULTS_DIR);
+    int exitcode;
+
+    SECTION("can read the stored exit code") {
+        lth_file::atomic_write_to_file("4\n",
+            RESULTS_DIR + "/" + ResultsStorage::EXITCODE_FILE);
+
+        REQUIRE(ResultsStorage::readExitcode(RESULTS_DIR, exitcode));
+        REQUIRE(exitcode == 4);
+    }
+
+    SECTION("returns false in case of invalid exit code") {
+        lth_file::atomic_write_to_file("spam",
+            RESULTS_DIR + "/" + ResultsStorage::EXITCODE_FILE);
+
+        REQUIRE_FALSE(ResultsStorage::readExitcode(RESULTS_DIR, exitcode));
+    }
+
+    SECTION("returns false if the exit code was not stored") {
+        REQUIRE_FALSE(ResultsStorage::readExitcode(RESULTS_DIR, exitcode));
+    }
+
+    fs::remove_all(RESULTS_DIR);
+}
+
+TEST_CASE("ResultsStorage::readProgress", "[results]") {
+    fs::create_directories(RESULTS_DIR);
+    lth_jc::JsonContainer progress {};
+
+    SECTION("can read the progress stored by the module") {
+        lth_file::atomic_write_to_file("{\"phase\" : \"applying\"}\n",
+            RESULTS_DIR + "/" + ResultsStorage::PROGRESS_FILE);
+
+        REQUIRE(ResultsStorage::readProgress(RESULTS_DIR, progress));
+        REQUIRE(progress.get<std::string>("phase") == "applying");
+    }
+
+    SECTION("returns false in case of invalid progress") {
+        lth_file::atomic_write_to_file("{\"phase\" : ",
+            RESULTS_DIR + "/" + ResultsStorage::PROGRESS_FILE);
+
+        REQUIRE_FALSE(ResultsStorage::readProgress(RESULTS_DIR, progress));
+    }
+
+    SECTION("returns false if no progress was stored") {
+        REQUIRE_FALSE(ResultsStorage::readProgress(RESULTS_DIR, progress));
+    }
+
+    fs::remove_all(RESULTS_DIR);
+}
+
+}  // namespace PXPAgent
@@ -4,9 +4,9 @@
 
 #include <catch.hpp>
 
+#include <atomic>
 #include <memory>
-#include <unistd.h>
-#include <exception>  // set_terminate
+#include <stdexcept>
 #include <vector>
 
 namespace PXPAgent {
@@ -17,10 +17,8 @@ TEST_CASE("ThreadContainer::ThreadContainer", "[utils]") {
     }
 }
 
-void testTask(std::shared_ptr<std::atomic<bool>> a,
-              const uint32_t task_duration_us) {
+void testTask(const uint32_t task_duration_us) {
     PCPClient::Util::this_thread::sleep_for(PCPClient::Util::chrono::microseconds(task_duration_us));
-    *a = true;
 }
 
 void addTasksTo(ThreadContainer& container,
@@ -29,22 +27,21 @@ void addTasksTo(ThreadContainer& container,
                 const uint32_t task_duration_us) {
     uint32_t idx;
     for (idx = 0; idx < num_tasks; idx++) {
-        std::shared_ptr<std::atomic<bool>> a { new  std::atomic<bool> { false } };
-        auto t = PCPClient::Util::thread(testTask, a, task_duration_us);
-        container.add(std::move(t), a);
-    }
-
-    if (task_duration_us == 0) {
-        // Ensure that the spawned thred doesn't outlive the caller
-        // when it's suppose to finish immediately (that could happen
-        // due to thread processing ovehead for the OS), otherwise a
-        // terminate call will abort the tests... See below
-        PCPClient::Util::this_thread::sleep_for(PCPClient::Util::chrono::microseconds(10000));
+        container.add([task_duration_us]() { testTask(task_duration_us); });
     }
 
     PCPClient::Util::this_thread::sleep_for(PCPClient::Util::chrono::microseconds(caller_duration_us));
 }
 
+// Wait until all threads are reaped or the timeout expires
+void waitForThreads(ThreadContainer& container, const uint32_t timeout_us) {
+    uint32_t waited_us { 0 };
+    while (container.getNumRunningThreads() > 0 && waited_us < timeout_us) {
+        PCPClient::Util::this_thread::sleep_for(PCPClient::Util::chrono::microseconds(1000));
+        waited_us += 1000;
+    }
+}
+
 TEST_CASE("ThreadContainer::add, ~ThreadContainer", "[async]") {
     SECTION("can add and erase a thread that completes immediately") {
         // NB: using a lambda in order to have a block that will
@@ -72,74 +69,78 @@ TEST_CASE("ThreadContainer::add, ~ThreadContainer", "[async]") {
         REQUIRE_NOTHROW(f());
     }
 
+    SECTION("can be destroyed while threads are still executing") {
+        auto f = []{
+                    ThreadContainer container { "TESTING_2_4" };
+                    addTasksTo(container, 4, 0, 100000);
+                 };
+        REQUIRE_NOTHROW(f());
+
+        // Let the detached threads complete
+        PCPClient::Util::this_thread::sleep_for(PCPClient::Util::chrono::microseconds(200000));
+    }
+
     SECTION("threds are properly added") {
-        ThreadContainer container { "TESTING_2_4" };
+        ThreadContainer container { "TESTING_2_5" };
         addTasksTo(container, 42, 0, 0);
         REQUIRE(container.getNumAddedThreads() == 42);
     }
-}
 
-auto monitoring_interval_us = THREADS_MONITORING_INTERVAL_MS * 1000;
+    SECTION("executes the tasks") {
+        auto counter = std::make_shared<std::atomic<uint32_t>>(0);
+        ThreadContainer container { "TESTING_2_6" };
 
-TEST_CASE("ThreadContainer::monitoringTask", "[async]") {
-    // NB: tesitng start, stop, and restart of the monitoring thread
-    // in a single section to reduce the test duration
-    SECTION("the monitoring thread is properly started, stopped, and restarted") {
-        uint32_t task_duration_us { 100000 };  // 100 ms
-        ThreadContainer container { "TESTING_3_1" };
+        for (int idx = 0; idx < 10; idx++) {
+            container.add([counter]() { (*counter)++; });
+        }
 
-        addTasksTo(container, 10 * THREADS_THRESHOLD, 0, task_duration_us);
-        INFO("should be started");
-        REQUIRE(container.isMonitoring());
-        REQUIRE(container.getNumAddedThreads() == 10 * THREADS_THRESHOLD);
-
-        // Wait for two monitoring intervals plus the task duration;
-        // all threads should be done by then
-        PCPClient::Util::this_thread::sleep_for(PCPClient::Util::chrono::microseconds(2 * monitoring_interval_us + task_duration_us));
-        INFO("should be stopped");
-        REQUIRE_FALSE(container.isMonitoring());
-
-        // Add a few more threads to restart the monitoring thread
-        addTasksTo(container, THREADS_THRESHOLD + 4, 0, task_duration_us);
-        INFO("should be restarted");
-        REQUIRE(container.isMonitoring());
-        REQUIRE(container.getNumAddedThreads() == (10 + 1) * THREADS_THRESHOLD + 4);
-
-        // Threads can't outlive the caller otherwise std::terminate()
-        // will be invoked; sleep for an interval greater than the
-        // duration
-        PCPClient::Util::this_thread::sleep_for(PCPClient::Util::chrono::microseconds(2 * task_duration_us));
+        waitForThreads(container, 1000000);
+        REQUIRE(counter->load() == 10u);
     }
 
-    SECTION("the monitoring thread can delete threads") {
-        ThreadContainer container { "TESTING_3_2" };
+    SECTION("filters exceptions thrown by the tasks") {
+        ThreadContainer container { "TESTING_2_7" };
+        container.add([]() { throw std::runtime_error { "spam" }; });
+        waitForThreads(container, 1000000);
+
+        REQUIRE(container.getNumErasedThreads() == 1);
+    }
+}
+
+TEST_CASE("ThreadContainer - completion tracking", "[async]") {
+    SECTION("completed threads are erased") {
+        ThreadContainer container { "TESTING_3_1" };
         REQUIRE(container.getNumErasedThreads() == 0);
 
-        addTasksTo(container, THREADS_THRESHOLD + 4, 0, 0);
-        REQUIRE(container.getNumAddedThreads() == THREADS_THRESHOLD + 4);
+        addTasksTo(container, 4, 0, 0);
+        waitForThreads(container, 1000000);
+
+        REQUIRE(container.getNumRunningThreads() == 0);
+        REQUIRE(container.getNumErasedThreads() == 4);
+    }
 
-        // Pause, to let the monitoring thread erase
-        PCPClient::Util::this_thread::sleep_for(PCPClient::Util::chrono::microseconds(2 * monitoring_interval_us));
-        REQUIRE_FALSE(container.isMonitoring());
+    SECTION("the number of erased threads is accurate at any load") {
+        uint32_t task_duration_us { 100000 };
+        ThreadContainer container { "TESTING_3_2" };
 
-        // NB: we cannot be certain about the number of erased threads
-        // because the monitoring thread depends upnon the threshold
-        REQUIRE(container.getNumErasedThreads() > 0);
+        addTasksTo(container, 100, 0, task_duration_us);
+        REQUIRE(container.getNumAddedThreads() == 100);
 
-        // NB: no need pause before returning; the threads already
-        // completed their execution
+        waitForThreads(container, 10 * task_duration_us);
+        REQUIRE(container.getNumErasedThreads() == 100);
     }
 
-    SECTION("can add threds while the monitoring thread is running") {
+    SECTION("threads still executing are not erased") {
         uint32_t task_duration_us { 100000 };
         ThreadContainer container { "TESTING_3_3" };
 
-        addTasksTo(container, THREADS_THRESHOLD + 4, 0, task_duration_us);
-        REQUIRE(container.isMonitoring());
+        addTasksTo(container, 4, 0, task_duration_us);
+        addTasksTo(container, 10, 0, 0);
+        REQUIRE(container.getNumAddedThreads() == 14);
+        REQUIRE(container.getNumRunningThreads() >= 4);
 
-        REQUIRE_NOTHROW(addTasksTo(container, 10, 0, 0));
-        REQUIRE(container.getNumAddedThreads() == THREADS_THRESHOLD + 4 + 10);
-        PCPClient::Util::this_thread::sleep_for(PCPClient::Util::chrono::microseconds(2 * task_duration_us));
+        waitForThreads(container, 10 * task_duration_us);
+        REQUIRE(container.getNumErasedThreads() == 14);
     }
 }
 
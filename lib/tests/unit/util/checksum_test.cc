@@ -0,0 +1,45 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/util/checksum.hpp>
+
+#include <leatherman/file_util/file.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+
+TEST_CASE("Util::getSha256", "[util]") {
+    SECTION("returns the digest of an empty string") {
+        REQUIRE(getSha256("") == "e3b0c44298fc1c149afbf4c8996fb924"
+                                 "27ae41e4649b934ca495991b7852b855");
+    }
+
+    SECTION("returns the digest of the specified data") {
+        REQUIRE(getSha256("abc") == "ba7816bf8f01cfea414140de5dae2223"
+                                    "b00361a396177a9cb410ff61f20015ad");
+    }
+}
+
+TEST_CASE("Util::getFileSha256", "[util]") {
+    std::string file_path { std::string { PXP_AGENT_ROOT_PATH }
+                            + "/lib/tests/resources/test_spool/checksum" };
+
+    SECTION("returns the digest of the file content") {
+        leatherman::file_util::atomic_write_to_file("abc", file_path);
+
+        REQUIRE(getFileSha256(file_path) == getSha256("abc"));
+        boost::filesystem::remove(file_path);
+    }
+
+    SECTION("throws a std::runtime_error if the file does not exist") {
+        REQUIRE_THROWS_AS(getFileSha256(file_path), std::runtime_error);
+    }
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
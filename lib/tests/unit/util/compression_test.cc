@@ -0,0 +1,91 @@
+#include <pxp-agent/util/compression.hpp>
+
+#include <catch.hpp>
+
+#include <sstream>
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+
+TEST_CASE("Util::gzipCompress, Util::gzipDecompress", "[util]") {
+    SECTION("can compress and decompress an empty string") {
+        REQUIRE(gzipDecompress(gzipCompress("")).empty());
+    }
+
+    SECTION("compresses data in the gzip format") {
+        auto compressed = gzipCompress("spam");
+
+        REQUIRE(compressed.substr(0, 2) == "\x1f\x8b");
+    }
+
+    SECTION("can compress and decompress repetitive data") {
+        std::string data {};
+
+        for (auto i = 0; i < 100000; i++) {
+            data += "line " + std::to_string(i % 10) + "\n";
+        }
+
+        auto compressed = gzipCompress(data);
+
+        REQUIRE(compressed.size() < data.size() / 10);
+        REQUIRE(gzipDecompress(compressed) == data);
+    }
+
+    SECTION("throws a compression_error in case of invalid data") {
+        REQUIRE_THROWS_AS(gzipDecompress("spam"), compression_error);
+    }
+
+    SECTION("throws a compression_error in case of truncated data") {
+        auto compressed = gzipCompress(std::string(1000, 'x'));
+
+        REQUIRE_THROWS_AS(gzipDecompress(compressed.substr(0, compressed.size() / 2)),
+                          compression_error);
+    }
+}
+
+TEST_CASE("Util::gzipDecompressRange, Util::gzipDecompressedSize", "[util]") {
+    std::string data {};
+
+    for (auto i = 0; i < 100000; i++) {
+        data += "line " + std::to_string(i) + "\n";
+    }
+
+    std::istringstream compressed { gzipCompress(data) };
+
+    SECTION("returns the requested range of the decompressed data") {
+        REQUIRE(gzipDecompressRange(compressed, 500000, 1000)
+                == data.substr(500000, 1000));
+    }
+
+    SECTION("returns the data up to its end if the length is negative") {
+        REQUIRE(gzipDecompressRange(compressed, 500000, -1) == data.substr(500000));
+    }
+
+    SECTION("returns an empty string if the offset is beyond the end") {
+        REQUIRE(gzipDecompressRange(compressed, data.size() + 1, -1).empty());
+    }
+
+    SECTION("returns the decompressed size") {
+        REQUIRE(gzipDecompressedSize(compressed) == data.size());
+    }
+
+    SECTION("throws a compression_error in case of truncated data") {
+        std::istringstream truncated { compressed.str().substr(0, 1000) };
+
+        REQUIRE_THROWS_AS(gzipDecompressRange(truncated, 500000, 1000),
+                          compression_error);
+    }
+}
+
+TEST_CASE("Util::encodeBase64", "[util]") {
+    SECTION("encodes the specified data") {
+        REQUIRE(encodeBase64("").empty());
+        REQUIRE(encodeBase64("f") == "Zg==");
+        REQUIRE(encodeBase64("foob") == "Zm9vYg==");
+        REQUIRE(encodeBase64("foobar") == "Zm9vYmFy");
+    }
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,273 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/util/logging.hpp>
+
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/json_container/json_container.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.test"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+namespace Util {
+
+namespace lth_jc = leatherman::json_container;
+namespace lth_log = leatherman::logging;
+
+TEST_CASE("Util::logPayload", "[util]") {
+    SECTION("does not modify small payloads") {
+        REQUIRE(logPayload("spam", 4) == "spam");
+        REQUIRE(logPayload("", 4) == "");
+    }
+
+    SECTION("truncates large payloads and reports the omitted size") {
+        REQUIRE(logPayload("spam eggs", 4) == "spam... [5 bytes omitted]");
+    }
+
+    SECTION("does not split UTF-8 characters") {
+        // NB: "\xc3\xa8" is a two bytes character
+        REQUIRE(logPayload("ab\xc3\xa8" "cd", 3) == "ab... [4 bytes omitted]");
+    }
+
+    SECTION("truncates to the default maximum size") {
+        std::string payload(2 * MAX_LOGGED_PAYLOAD_SIZE, 'x');
+
+        REQUIRE(logPayload(payload).size() < payload.size());
+        REQUIRE(logPayload(payload).find(std::string(MAX_LOGGED_PAYLOAD_SIZE, 'x'))
+                == 0);
+    }
+}
+
+TEST_CASE("Util::rotateFiles", "[util]") {
+    std::string file_path { std::string { PXP_AGENT_ROOT_PATH }
+                            + "/lib/tests/resources/test_spool/rotated.log" };
+    auto rotated = [&file_path](int n) {
+        return file_path + "." + std::to_string(n);
+    };
+    auto cleanup = [&]() {
+        for (auto n = 0; n <= 3; n++) {
+            boost::filesystem::remove(n ? rotated(n) : file_path);
+        }
+    };
+
+    SECTION("keeps the specified number of rotated files") {
+        for (auto i = 1; i <= 3; i++) {
+            leatherman::file_util::atomic_write_to_file(std::to_string(i),
+                                                        file_path);
+            rotateFiles(file_path, 2);
+        }
+
+        REQUIRE_FALSE(boost::filesystem::exists(file_path));
+        REQUIRE(leatherman::file_util::read(rotated(1)) == "3");
+        REQUIRE(leatherman::file_util::read(rotated(2)) == "2");
+        REQUIRE_FALSE(boost::filesystem::exists(rotated(3)));
+        cleanup();
+    }
+
+    SECTION("removes the file if no rotated file is kept") {
+        leatherman::file_util::atomic_write_to_file("1", file_path);
+        rotateFiles(file_path, 0);
+
+        REQUIRE_FALSE(boost::filesystem::exists(file_path));
+        REQUIRE_FALSE(boost::filesystem::exists(rotated(1)));
+        cleanup();
+    }
+}
+
+TEST_CASE("Util::setupJsonLogging", "[util]") {
+    std::ostringstream stream {};
+    auto level = lth_log::get_level();
+    lth_log::set_level(lth_log::log_level::info);
+    setupJsonLogging(stream);
+
+    SECTION("logs event records with the log context of the thread") {
+        {
+            LogContextScope log_context { "123", "42", "pcp://controller/test",
+                                          "reverse", "string" };
+            lth_jc::JsonContainer entries {};
+            entries.set<int>("duration_ms", 7);
+            logEvent("puppetlabs.test", "executed action", entries);
+        }
+        lth_jc::JsonContainer record { stream.str() };
+
+        REQUIRE(record.includes("timestamp"));
+        REQUIRE(record.get<std::string>("level") == "info");
+        REQUIRE(record.get<std::string>("namespace") == "puppetlabs.test");
+        REQUIRE(record.get<std::string>("message") == "executed action");
+        REQUIRE(record.get<std::string>("request_id") == "123");
+        REQUIRE(record.get<std::string>("transaction_id") == "42");
+        REQUIRE(record.get<std::string>("sender") == "pcp://controller/test");
+        REQUIRE(record.get<std::string>("module") == "reverse");
+        REQUIRE(record.get<std::string>("action") == "string");
+        REQUIRE(record.get<int>("duration_ms") == 7);
+    }
+
+    SECTION("restores the previous log context") {
+        {
+            LogContextScope log_context { "123", "42", "pcp://controller/test",
+                                          "reverse", "string" };
+        }
+        logEvent("puppetlabs.test", "spam");
+        lth_jc::JsonContainer record { stream.str() };
+
+        REQUIRE_FALSE(record.includes("request_id"));
+        REQUIRE_FALSE(record.includes("module"));
+    }
+
+    SECTION("logs the duration and the failure of event scopes") {
+        try {
+            LogEventScope log_event { "puppetlabs.test", "spam" };
+            throw std::runtime_error { "eggs" };
+        } catch (const std::runtime_error&) {
+        }
+        lth_jc::JsonContainer record { stream.str() };
+
+        REQUIRE(record.get<std::string>("message") == "spam");
+        REQUIRE(record.includes("duration_ms"));
+        REQUIRE(record.get<bool>("failed"));
+    }
+
+    SECTION("writes log messages as JSON records") {
+        LOG_WARNING("spam %1%", "eggs");
+        lth_jc::JsonContainer record { stream.str() };
+
+        REQUIRE(record.get<std::string>("level") == "warning");
+        REQUIRE(record.get<std::string>("message") == "spam eggs");
+    }
+
+    resetJsonLogging();
+    lth_log::set_level(level);
+
+    SECTION("does not log event records once reset") {
+        logEvent("puppetlabs.test", "spam");
+
+        REQUIRE(stream.str().empty());
+    }
+}
+
+TEST_CASE("Util::AsyncLogStream", "[util]") {
+    std::ostringstream destination {};
+
+    SECTION("writes entries synchronously if not started") {
+        AsyncLogStream stream { destination };
+        stream << "spam " << 42 << std::endl;
+
+        REQUIRE(destination.str() == "spam 42\n");
+    }
+
+    SECTION("writes entries only once they are flushed") {
+        AsyncLogStream stream { destination };
+        stream << "spam";
+
+        REQUIRE(destination.str().empty());
+
+        stream << std::flush;
+
+        REQUIRE(destination.str() == "spam");
+    }
+
+    SECTION("writes all the queued entries, in order, when stopped") {
+        std::string expected {};
+        {
+            AsyncLogStream stream { destination };
+            stream.start();
+
+            for (auto i = 0; i < 1000; i++) {
+                stream << "entry " << i << std::endl;
+                expected += "entry " + std::to_string(i) + "\n";
+            }
+        }
+
+        REQUIRE(destination.str() == expected);
+    }
+
+    SECTION("drops entries that don't fit the queue and reports them") {
+        AsyncLogStream stream { destination, nullptr, 8 };
+        stream.start();
+        stream << "too long for the queue" << std::endl;
+        stream << "spam" << std::endl;
+        stream.stop();
+
+        REQUIRE(destination.str().find("too long") == std::string::npos);
+        REQUIRE(destination.str().find("spam\n") != std::string::npos);
+        REQUIRE(destination.str().find("1 log messages were dropped")
+                != std::string::npos);
+    }
+
+    SECTION("writes the entries of concurrent threads without interleaving them") {
+        {
+            AsyncLogStream stream { destination };
+            stream.start();
+            std::vector<PCPClient::Util::thread> threads {};
+
+            for (auto t = 0; t < 4; t++) {
+                threads.push_back(PCPClient::Util::thread { [&stream, t]() {
+                    for (auto i = 0; i < 250; i++) {
+                        stream << "thread " << t << " entry " << i << std::endl;
+                    }
+                } });
+            }
+
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+
+        std::istringstream lines { destination.str() };
+        std::string line {};
+        std::vector<int> num_entries(4, 0);
+
+        while (std::getline(lines, line)) {
+            auto t = line[7] - '0';
+            REQUIRE(line == "thread " + std::to_string(t) + " entry "
+                            + std::to_string(num_entries[t]++));
+        }
+
+        REQUIRE(num_entries == std::vector<int>(4, 250));
+    }
+
+    SECTION("rotates the destination once the maximum size is written") {
+        auto num_rotations = 0;
+        {
+            AsyncLogStream stream { destination };
+            stream.setRotation([&num_rotations]() { num_rotations++; },
+                               20, std::chrono::seconds(0), 15);
+            stream.start();
+            stream << "spam eggs" << std::endl;
+        }
+
+        REQUIRE(num_rotations == 1);
+    }
+
+    SECTION("reopens the destination") {
+        std::vector<std::string> calls {};
+        AsyncLogStream stream { destination, [&calls]() { calls.push_back("reopen"); } };
+
+        SECTION("synchronously if not started") {
+            stream.reopen();
+
+            REQUIRE(calls.size() == 1);
+        }
+
+        SECTION("from the writer thread if started") {
+            stream.start();
+            stream.reopen();
+            stream.stop();
+
+            REQUIRE(calls.size() == 1);
+        }
+    }
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,68 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/util/posix/directory_watcher.hpp>
+
+#include <leatherman/file_util/file.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <signal.h>      // raise(), SIGHUP
+
+namespace PXPAgent {
+namespace Util {
+
+namespace fs = boost::filesystem;
+
+static const std::string WATCHED_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                       + "/lib/tests/resources/test_spool/watched" };
+
+// Wait up to 5 s for the watcher to call the function
+static bool waitForCall(std::atomic<int>& num_calls) {
+    for (auto i = 0; i < 50 && num_calls == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    return num_calls > 0;
+}
+
+TEST_CASE("Util::DirectoryWatcher", "[util]") {
+    fs::create_directories(WATCHED_DIR);
+    std::atomic<int> num_calls { 0 };
+
+    SECTION("calls the function on SIGHUP") {
+        DirectoryWatcher watcher { { WATCHED_DIR }, [&num_calls]() { num_calls++; } };
+        raise(SIGHUP);
+
+        REQUIRE(waitForCall(num_calls));
+    }
+
+#ifdef __linux__
+    SECTION("calls the function once for a batch of changes") {
+        DirectoryWatcher watcher { { WATCHED_DIR }, [&num_calls]() { num_calls++; } };
+        leatherman::file_util::atomic_write_to_file("spam", WATCHED_DIR + "/foo");
+        leatherman::file_util::atomic_write_to_file("eggs", WATCHED_DIR + "/bar");
+
+        REQUIRE(waitForCall(num_calls));
+        REQUIRE(num_calls == 1);
+    }
+#endif
+
+    SECTION("does not call the function if nothing changes") {
+        DirectoryWatcher watcher { { WATCHED_DIR }, [&num_calls]() { num_calls++; } };
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        REQUIRE(num_calls == 0);
+    }
+
+    fs::remove_all(WATCHED_DIR);
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,89 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/util/posix/group_commit.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <leatherman/file_util/file.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace PXPAgent {
+namespace Util {
+
+namespace fs = boost::filesystem;
+namespace lth_file = leatherman::file_util;
+
+static const std::string COMMIT_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                      + "/lib/tests/resources/test_spool/tmp_commit" };
+
+static std::string commitPath(const std::string& file_name) {
+    return COMMIT_DIR + "/" + file_name;
+}
+
+TEST_CASE("Util::GroupCommitWriter::write", "[util]") {
+    fs::create_directories(COMMIT_DIR);
+
+    SECTION("replaces the content of the files") {
+        GroupCommitWriter writer {};
+        writer.write(commitPath("spam"), "eggs");
+        writer.write(commitPath("spam"), "foo");
+
+        REQUIRE(lth_file::read(commitPath("spam")) == "foo");
+        REQUIRE_FALSE(fs::exists(commitPath("spam.tmp")));
+    }
+
+    SECTION("writes multiple files") {
+        GroupCommitWriter writer { true };
+        writer.write({ std::make_pair(commitPath("spam"), "eggs"),
+                       std::make_pair(commitPath("foo"), "bar") });
+
+        REQUIRE(lth_file::read(commitPath("spam")) == "eggs");
+        REQUIRE(lth_file::read(commitPath("foo")) == "bar");
+    }
+
+    SECTION("commits the files of concurrent writers") {
+        GroupCommitWriter writer { true };
+        std::vector<PCPClient::Util::thread> threads {};
+
+        for (auto t = 0; t < 8; t++) {
+            threads.push_back(PCPClient::Util::thread { [&writer, t]() {
+                for (auto i = 0; i < 10; i++) {
+                    writer.write(commitPath("file_" + std::to_string(t)),
+                                 std::to_string(i));
+                }
+            } });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        for (auto t = 0; t < 8; t++) {
+            REQUIRE(lth_file::read(commitPath("file_" + std::to_string(t))) == "9");
+        }
+    }
+
+    SECTION("throws a commit_error if a file can't be written") {
+        GroupCommitWriter writer {};
+
+        REQUIRE_THROWS_AS(writer.write(commitPath("missing/spam"), "eggs"),
+                          commit_error);
+
+        writer.setSync(true);
+
+        REQUIRE_THROWS_AS(writer.write(commitPath("missing/spam"), "eggs"),
+                          commit_error);
+    }
+
+    fs::remove_all(COMMIT_DIR);
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
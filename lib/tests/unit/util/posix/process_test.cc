@@ -0,0 +1,350 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/util/posix/process.hpp>
+
+#include <leatherman/file_util/file.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <signal.h>      // SIGXCPU, SIGKILL
+#include <unistd.h>      // getpid()
+
+namespace PXPAgent {
+namespace Util {
+
+namespace fs = boost::filesystem;
+namespace lth_file = leatherman::file_util;
+
+static const std::string PROCESS_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                       + "/lib/tests/resources/test_spool/process" };
+static const std::string OUT_PATH { PROCESS_DIR + "/stdout" };
+static const std::string ERR_PATH { PROCESS_DIR + "/stderr" };
+static const std::string EXITCODE_PATH { PROCESS_DIR + "/exitcode" };
+
+TEST_CASE("Util::spawnWrapped, Util::waitForProcess", "[util]") {
+    fs::create_directories(PROCESS_DIR);
+
+    SECTION("stores the output of the process and its exit code") {
+        auto pid = spawnWrapped("/bin/sh", { "-c", "cat; echo spam >&2; exit 3" },
+                                "eggs", OUT_PATH, ERR_PATH, EXITCODE_PATH);
+
+        REQUIRE(waitForProcess(pid) == 3);
+        REQUIRE(lth_file::read(OUT_PATH) == "eggs");
+        REQUIRE(lth_file::read(ERR_PATH) == "spam\n");
+        REQUIRE(lth_file::read(EXITCODE_PATH) == "3\n");
+    }
+
+    SECTION("reports a failure if the executable does not exist") {
+        auto pid = spawnWrapped(PROCESS_DIR + "/foo", {}, "",
+                                OUT_PATH, ERR_PATH, EXITCODE_PATH);
+
+        REQUIRE(waitForProcess(pid) == 127);
+    }
+
+    SECTION("stores no more than the specified output sizes") {
+        auto pid = spawnWrapped("/bin/sh",
+                                { "-c", "i=0; while [ $i -lt 2000 ]; do "
+                                        "echo spam; echo eggs >&2; i=$((i+1)); "
+                                        "done; exit 3" },
+                                "", OUT_PATH, ERR_PATH, EXITCODE_PATH,
+                                ProcessLimits {}, nullptr, 9, 4);
+
+        REQUIRE(waitForProcess(pid) == 3);
+        REQUIRE(lth_file::read(OUT_PATH) == "spam\nspam");
+        REQUIRE(lth_file::read(ERR_PATH) == "eggs");
+    }
+
+    SECTION("throws a process_error if it can't open the output files") {
+        REQUIRE_THROWS_AS(spawnWrapped("/bin/sh", {}, "",
+                                       PROCESS_DIR + "/foo/bar", ERR_PATH,
+                                       EXITCODE_PATH),
+                          process_error);
+    }
+
+    fs::remove_all(PROCESS_DIR);
+}
+
+TEST_CASE("Util::execute", "[util]") {
+    SECTION("returns the output of the process and its exit code") {
+        auto result = execute("/bin/sh", { "-c", "cat; echo spam >&2; exit 3" },
+                              "eggs");
+
+        REQUIRE(result.exitcode == 3);
+        REQUIRE(result.output == "eggs");
+        REQUIRE(result.error == "spam\n");
+        REQUIRE(result.limit_exceeded.empty());
+    }
+
+    SECTION("does not block if the process does not consume its input") {
+        auto result = execute("/bin/sh", { "-c", "exit 0" },
+                              std::string(1024 * 1024, 'x'));
+
+        REQUIRE(result.exitcode == 0);
+    }
+
+    SECTION("reports a failure if the executable does not exist") {
+        REQUIRE(execute(PROCESS_DIR + "/foo", {}, "").exitcode == 127);
+    }
+
+    SECTION("collects no more than the specified output sizes") {
+        auto result = execute("/bin/sh",
+                              { "-c", "printf 0123456789; printf abcdef >&2" },
+                              "", ProcessLimits {}, 4, 2);
+
+        REQUIRE(result.exitcode == 0);
+        REQUIRE(result.output == "0123");
+        REQUIRE(result.error == "ab");
+    }
+
+    SECTION("reports the resource usage of the process tree") {
+        auto result = execute("/bin/sh",
+                              { "-c", "sh -c 'i=0; while [ $i -lt 20000 ]; "
+                                      "do i=$((i+1)); done'; sleep 0.1" },
+                              "");
+
+        REQUIRE(result.exitcode == 0);
+        REQUIRE(result.usage.wall_time_s >= 0.1);
+        auto cpu_s = result.usage.user_cpu_s + result.usage.system_cpu_s;
+        REQUIRE(cpu_s > 0);
+        REQUIRE(result.usage.max_rss_kb > 0);
+    }
+}
+
+TEST_CASE("Util::execute with environment", "[util]") {
+    SECTION("sets the specified variables") {
+        auto environment = Environment::build({ { "PXP_SPAM", "eggs" } }, true);
+        auto result = execute("/bin/sh", { "-c", "echo $PXP_SPAM; echo $PATH" },
+                              "", ProcessLimits {}, 0, 0, &environment);
+
+        REQUIRE(result.exitcode == 0);
+        REQUIRE(result.output.find("eggs\n") == 0);
+        REQUIRE(result.output.size() > std::string { "eggs\n\n" }.size());
+    }
+
+    SECTION("does not inherit the agent environment if requested") {
+        auto environment = Environment::build({ { "PXP_SPAM", "eggs" } }, false);
+        auto result = execute("/bin/sh", { "-c", "echo $PXP_SPAM:$HOME" },
+                              "", ProcessLimits {}, 0, 0, &environment);
+
+        REQUIRE(environment.entries().size() == 1);
+        REQUIRE(result.output == "eggs:\n");
+    }
+}
+
+TEST_CASE("Util::execute with limits", "[util]") {
+    ProcessLimits limits {};
+
+    SECTION("applies the open_files limit") {
+        limits.open_files = 42;
+        auto result = execute("/bin/sh", { "-c", "ulimit -n" }, "", limits);
+
+        REQUIRE(result.exitcode == 0);
+        REQUIRE(result.output == "42\n");
+    }
+
+    SECTION("applies the nice level") {
+        limits.nice = 5;
+        auto result = execute("/bin/sh", { "-c", "exit 0" }, "", limits);
+
+        REQUIRE(result.exitcode == 0);
+    }
+
+    SECTION("reports an exceeded cpu_seconds limit") {
+        limits.cpu_seconds = 1;
+        auto result = execute("/bin/sh", { "-c", "while :; do :; done" }, "",
+                              limits);
+
+        REQUIRE(result.exitcode == 128 + SIGXCPU);
+        REQUIRE(result.limit_exceeded == CPU_TIME_LIMIT);
+    }
+
+    SECTION("does not execute the process if it can't join the cgroup") {
+        limits.cgroup = PROCESS_DIR + "/foo";
+        auto result = execute("/bin/sh", { "-c", "echo spam" }, "", limits);
+
+        REQUIRE(result.exitcode == 126);
+        REQUIRE(result.output.empty());
+        REQUIRE_FALSE(result.error.empty());
+    }
+}
+
+TEST_CASE("Util::startForkServer", "[util]") {
+    fs::create_directories(PROCESS_DIR);
+    startForkServer();
+
+    SECTION("executes processes and reports their outcome") {
+        auto result = execute("/bin/sh", { "-c", "cat; echo spam >&2; exit 3" },
+                              "eggs");
+
+        REQUIRE(result.exitcode == 3);
+        REQUIRE(result.output == "eggs");
+        REQUIRE(result.error == "spam\n");
+    }
+
+    SECTION("the processes are not children of the agent") {
+        auto result = execute("/bin/sh", { "-c", "echo $PPID" }, "");
+
+        REQUIRE(result.exitcode == 0);
+        REQUIRE(result.output != std::to_string(getpid()) + "\n");
+    }
+
+    SECTION("applies the limits") {
+        ProcessLimits limits {};
+        limits.open_files = 42;
+        auto result = execute("/bin/sh", { "-c", "ulimit -n" }, "", limits);
+
+        REQUIRE(result.output == "42\n");
+    }
+
+    SECTION("sets the specified environment") {
+        auto environment = Environment::build({ { "PXP_SPAM", "eggs" } }, false);
+        auto result = execute("/bin/sh", { "-c", "echo $PXP_SPAM" },
+                              "", ProcessLimits {}, 0, 0, &environment);
+
+        REQUIRE(result.output == "eggs\n");
+    }
+
+    SECTION("spawns wrapped processes that can be waited for") {
+        auto pid = spawnWrapped("/bin/sh", { "-c", "exit 4" }, "",
+                                OUT_PATH, ERR_PATH, EXITCODE_PATH);
+
+        REQUIRE(waitForProcess(pid) == 4);
+        REQUIRE(lth_file::read(EXITCODE_PATH) == "4\n");
+    }
+
+    SECTION("processes can be waited for after the server is stopped") {
+        auto pid = spawnWrapped("/bin/sh", { "-c", "sleep 0.2; exit 5" }, "",
+                                OUT_PATH, ERR_PATH, EXITCODE_PATH);
+        stopForkServer();
+
+        REQUIRE(waitForProcess(pid) == 5);
+        REQUIRE(execute("/bin/sh", { "-c", "exit 6" }, "").exitcode == 6);
+    }
+
+    SECTION("preloaders do not leak file descriptors") {
+        std::string module_path { PXP_AGENT_ROOT_PATH
+                                  "/lib/tests/resources/modules/reverse_valid" };
+        auto countFds = []() {
+            return std::distance(fs::directory_iterator { "/dev/fd" },
+                                 fs::directory_iterator {});
+        };
+        { Preloader preloader { module_path, { "preload" } }; }
+        auto num_fds = countFds();
+
+        for (auto i = 0; i < 3; i++) {
+            Preloader preloader { module_path, { "preload" } };
+        }
+
+        REQUIRE(countFds() == num_fds);
+    }
+
+    stopForkServer();
+    fs::remove_all(PROCESS_DIR);
+}
+
+// Spawn latency benchmark; hidden, run it with the [benchmark] tag
+TEST_CASE("Util::Preloader", "[util]") {
+    fs::create_directories(PROCESS_DIR);
+    std::string module_path { PXP_AGENT_ROOT_PATH
+                              "/lib/tests/resources/modules/reverse_valid" };
+    Preloader preloader { module_path, { "preload" } };
+
+    SECTION("executes the actions in children of the preloader") {
+        auto result = execute(preloader, "string",
+                              "{\"params\" : {\"argument\" : \"maradona\"}}");
+
+        REQUIRE(result.exitcode == 0);
+        REQUIRE(result.output == "{\"output\":\"anodaram\"}\n");
+        REQUIRE(result.error.empty());
+    }
+
+    SECTION("reports the failure of an action") {
+        auto result = execute(preloader, "string", "not json");
+
+        REQUIRE(result.exitcode == 1);
+        REQUIRE_FALSE(result.error.empty());
+    }
+
+    SECTION("stores the exit code of wrapped processes") {
+        auto pid = spawnWrapped(preloader, "string",
+                                "{\"params\" : {\"argument\" : \"eggs\"}}",
+                                OUT_PATH, ERR_PATH, EXITCODE_PATH);
+
+        REQUIRE(waitForProcess(pid) == 0);
+        REQUIRE(lth_file::read(OUT_PATH) == "{\"output\":\"sgge\"}\n");
+        REQUIRE(lth_file::read(EXITCODE_PATH) == "0\n");
+    }
+
+    SECTION("throws a process_error if the preloader does not get ready") {
+        REQUIRE_THROWS_AS(Preloader("/bin/sh", { "-c", "sleep 5" }, ProcessLimits {},
+                                    nullptr, 1),
+                          process_error);
+    }
+
+    fs::remove_all(PROCESS_DIR);
+}
+
+TEST_CASE("Util::execute spawn latency", "[.][benchmark]") {
+    static const int NUM_SPAWNS { 200 };
+
+    auto getAverageLatency = []() {
+        auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < NUM_SPAWNS; i++) {
+            REQUIRE(execute("/bin/sh", { "-c", "exit 0" }, "").exitcode == 0);
+        }
+
+        return std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count() / NUM_SPAWNS;
+    };
+
+    auto small_latency_us = getAverageLatency();
+
+    // The spawn cost must not depend on the memory used by the agent
+    std::vector<char> ballast(1024 * 1024 * 1024, 'x');
+    auto large_latency_us = getAverageLatency();
+
+    WARN("average spawn latency: " << small_latency_us << " us; with 1 GiB "
+         "of resident memory: " << large_latency_us << " us");
+    REQUIRE(ballast.back() == 'x');
+}
+
+TEST_CASE("Util::getExceededLimit", "[util]") {
+    ProcessLimits limits {};
+
+    SECTION("ignores SIGXCPU if no cpu_seconds limit is set") {
+        REQUIRE(getExceededLimit(limits, 128 + SIGXCPU, 0).empty());
+    }
+
+    SECTION("does not report a memory violation without a cgroup") {
+        REQUIRE(getExceededLimit(limits, 128 + SIGKILL, 0).empty());
+    }
+}
+
+TEST_CASE("Util::isProcessExecuting", "[util]") {
+    SECTION("returns true for the current process") {
+        REQUIRE(isProcessExecuting(getpid(), getProcessStartTime(getpid())));
+    }
+
+    SECTION("returns false if the start time does not match") {
+        if (getProcessStartTime(getpid()).empty()) {
+            WARN("process start time not available; skipping");
+        } else {
+            REQUIRE_FALSE(isProcessExecuting(getpid(), "spam"));
+        }
+    }
+
+    SECTION("returns false for an invalid PID") {
+        REQUIRE_FALSE(isProcessExecuting(-1, ""));
+    }
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
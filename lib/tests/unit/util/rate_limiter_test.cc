@@ -0,0 +1,88 @@
+#include <pxp-agent/util/rate_limiter.hpp>
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+
+TEST_CASE("Util::RateLimiter::acquire", "[util]") {
+    SECTION("accepts any request if disabled") {
+        RateLimiter limiter { 0, 0, 1 };
+        auto now = RateLimiter::Clock::now();
+
+        REQUIRE_FALSE(limiter.enabled());
+        for (auto i = 0; i < 100; i++) {
+            REQUIRE(limiter.acquire("spam", now) == 0);
+        }
+    }
+
+    SECTION("accepts a burst of requests of a key and then limits its rate") {
+        RateLimiter limiter { 0, 2, 3 };
+        auto now = RateLimiter::Clock::now();
+
+        for (auto i = 0; i < 3; i++) {
+            REQUIRE(limiter.acquire("spam", now) == 0);
+        }
+
+        auto wait_s = limiter.acquire("spam", now);
+
+        REQUIRE(wait_s == Approx(0.5));
+        REQUIRE(limiter.acquire("spam", now + std::chrono::milliseconds(400)) > 0);
+        REQUIRE(limiter.acquire("spam", now + std::chrono::milliseconds(500)) == 0);
+    }
+
+    SECTION("limits the rate of each key independently") {
+        RateLimiter limiter { 0, 1, 1 };
+        auto now = RateLimiter::Clock::now();
+
+        REQUIRE(limiter.acquire("spam", now) == 0);
+        REQUIRE(limiter.acquire("spam", now) > 0);
+        REQUIRE(limiter.acquire("eggs", now) == 0);
+    }
+
+    SECTION("keeps limiting the recently used keys under a flood of keys") {
+        RateLimiter limiter { 0, 1, 1 };
+        auto now = RateLimiter::Clock::now();
+
+        REQUIRE(limiter.acquire("spam", now) == 0);
+
+        for (auto i = 0; i < 10000; i++) {
+            REQUIRE(limiter.acquire(std::to_string(i), now) == 0);
+            REQUIRE(limiter.acquire("spam", now) > 0);
+        }
+    }
+
+    SECTION("takes the specified number of tokens, all or none") {
+        RateLimiter limiter { 0, 1, 10 };
+        auto now = RateLimiter::Clock::now();
+
+        REQUIRE(limiter.acquire("spam", 8, now) == 0);
+        REQUIRE(limiter.acquire("spam", 3, now) == Approx(1));
+        REQUIRE(limiter.acquire("spam", 2, now) == 0);
+        REQUIRE(limiter.acquire("spam", now) > 0);
+    }
+
+    SECTION("limits the global rate") {
+        RateLimiter limiter { 1, 0, 2 };
+        auto now = RateLimiter::Clock::now();
+
+        REQUIRE(limiter.acquire("spam", now) == 0);
+        REQUIRE(limiter.acquire("eggs", now) == 0);
+        REQUIRE(limiter.acquire("beans", now) == Approx(1));
+    }
+
+    SECTION("doesn't take a key token if the global limit is exceeded") {
+        RateLimiter limiter { 1, 1, 1 };
+        auto now = RateLimiter::Clock::now();
+
+        REQUIRE(limiter.acquire("spam", now) == 0);
+        REQUIRE(limiter.acquire("eggs", now) > 0);
+        REQUIRE(limiter.acquire("eggs", now + std::chrono::seconds(1)) == 0);
+    }
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -1,5 +1,9 @@
 #!/usr/bin/env rspec
 
+require 'ostruct'
+require 'tempfile'
+require 'tmpdir'
+
 load File.join(File.dirname(__FILE__), "../", "../", "../", "pxp-module-puppet")
 
 describe "pxp-module-puppet" do
@@ -69,6 +73,76 @@ describe "pxp-module-puppet" do
       expect(make_command_string(default_config, default_params)).to be ==
         "puppet agent  > nul 2>&1"
     end
+
+    it "doesn't discard the output if requested" do
+      params = default_params
+      params["flags"] = ["--noop"]
+      expect(make_command_string(default_config, params, false)).to be ==
+        "puppet agent --noop 2>&1"
+    end
+  end
+
+  describe "read_report_summary" do
+    let(:report_file) {
+      Tempfile.new("last_run_report")
+    }
+
+    after(:each) do
+      report_file.close!
+    end
+
+    it "reads the summary entries that precede the report body" do
+      report_file.write(<<-REPORT)
+--- !ruby/object:Puppet::Transaction::Report
+host: spam.example.com
+time: 2015-09-07 11:09:49.973632164 +00:00
+transaction_uuid: ac59acbe-6a0f-49c9-8ece-f781a689fda9
+kind: apply
+status: changed
+environment: 'production'
+logs:
+  - level: notice
+    status: failed
+      REPORT
+      report_file.flush
+      expect(read_report_summary(report_file.path)).to be ==
+          {"kind"             => "apply",
+           "time"             => Time.parse("2015-09-07 11:09:49.973632164 +00:00"),
+           "transaction_uuid" => "ac59acbe-6a0f-49c9-8ece-f781a689fda9",
+           "environment"      => "production",
+           "status"           => "changed"}
+    end
+
+    it "returns nil if an entry doesn't precede the report body" do
+      report_file.write("kind: apply\nlogs: []\nstatus: changed\n")
+      report_file.flush
+      expect(read_report_summary(report_file.path)).to be_nil
+    end
+
+    it "returns nil if the report can't be read" do
+      expect(read_report_summary("/does/not/exist")).to be_nil
+    end
+  end
+
+  describe "update_progress" do
+    let(:progress) {
+      {"phase" => "starting", "events" => 0}
+    }
+
+    it "tracks the run phases" do
+      expect(update_progress(progress, "Info: Applying configuration version '42'\n")).to be == :phase
+      expect(progress["phase"]).to be == "applying catalog"
+    end
+
+    it "counts the resource events" do
+      expect(update_progress(progress, "Notice: /Stage[main]/Main/Notify[x]/message: defined\n")).to be == :event
+      expect(progress["events"]).to be == 1
+    end
+
+    it "ignores other output" do
+      expect(update_progress(progress, "Notice: spam\n")).to be_nil
+      expect(progress).to be == {"phase" => "starting", "events" => 0}
+    end
   end
 
   describe "get_result_from_report" do
@@ -132,6 +206,44 @@ describe "pxp-module-puppet" do
     end
   end
 
+  describe "get_result_from_report with a report file" do
+    let(:state_dir) {
+      Dir.mktmpdir
+    }
+
+    after(:each) do
+      FileUtils.remove_entry(state_dir)
+    end
+
+    it "returns the same result whether it reads the summary or the whole report" do
+      report = File.join(state_dir, "last_run_report.yaml")
+      File.write(report, <<-REPORT)
+---
+host: spam.example.com
+time: 2016-04-28 16:18:53.236123000 -07:00
+transaction_uuid: ac59acbe-6a0f-49c9-8ece-f781a689fda9
+kind: apply
+status: changed
+environment: production
+logs:
+  - level: notice
+      REPORT
+      allow_any_instance_of(Object).to receive(:check_config_print).and_return(state_dir)
+      # NB: Puppet loads the report as a Puppet::Transaction::Report,
+      # whose entries are accessed as attributes
+      allow(YAML).to receive(:load_file).with(report).and_return(
+        OpenStruct.new(YAML.parse(File.read(report)).to_ruby))
+
+      summary_result = get_result_from_report(0, default_config)
+      allow_any_instance_of(Object).to receive(:read_report_summary).and_return(nil)
+      report_result = get_result_from_report(0, default_config)
+
+      expect(summary_result).to be == report_result
+      expect(summary_result.to_json).to be == report_result.to_json
+      expect(summary_result["time"].to_json).to be == "\"2016-04-28 16:18:53 -0700\""
+    end
+  end
+
   describe "start_run" do
     let(:runoutcome) {
       double(:runoutcome)
@@ -152,6 +264,14 @@ describe "pxp-module-puppet" do
       start_run(default_config, default_params)
     end
 
+    it "reports the progress if a progress file is specified" do
+      expect_any_instance_of(Object).to receive(:run_with_progress).with(
+        "puppet agent  2>&1", "/tmp/progress").and_return(runoutcome)
+      allow(runoutcome).to receive(:exitstatus).and_return(0)
+      allow_any_instance_of(Object).to receive(:get_result_from_report).with(0, default_config)
+      start_run(default_config, default_params, "/tmp/progress")
+    end
+
     it "populates output when it couldn't start" do
       allow(Puppet::Util::Execution).to receive(:execute).and_return(nil)
       allow_any_instance_of(Object).to receive(:get_result_from_report).with(-1, default_config,
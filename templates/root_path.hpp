@@ -2,5 +2,6 @@
 #define TEMPLATES_PXP_AGENT_ROOT_PATH_HPP_
 
 #define PXP_AGENT_ROOT_PATH "@ROOT_PATH@"
+#define PXP_AGENT_BINARY_ROOT_PATH "@CMAKE_BINARY_DIR@"
 
 #endif  // TEMPLATES_PXP_AGENT_ROOT_PATH_HPP_